@@ -50,6 +50,14 @@ echo -e "================================"
 SOURCES=(
     "${SRC_DIR}/main.cpp"
     "${SRC_DIR}/hft_server.cpp"
+    "${SRC_DIR}/logger.cpp"
+    "${SRC_DIR}/uring.cpp"
+    "${SRC_DIR}/order_book.cpp"
+    "${SRC_DIR}/instrument_registry.cpp"
+    "${SRC_DIR}/journal.cpp"
+    "${SRC_DIR}/recovery.cpp"
+    "${SRC_DIR}/shm_transport.cpp"
+    "${SRC_DIR}/multicast_feed.cpp"
 )
 
 # Object files
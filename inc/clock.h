@@ -0,0 +1,230 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define HFT_CLOCK_TSC 1
+#endif
+
+namespace hft {
+
+/**
+ * @brief Nanosecond clock read from the TSC, for every timestamp on the message path
+ *
+ * With an invariant TSC a reading is one rdtsc, a multiply and a seqlock
+ * check, against well over 20ns for clock_gettime through the vDSO. The
+ * tick rate is calibrated against CLOCK_MONOTONIC_RAW at first use and
+ * refined at each resync. A resync happens every RESYNC_INTERVAL_NS, run by
+ * whichever reader finds it due, and also re-anchors now_ns() to
+ * CLOCK_REALTIME so drift never builds up. Without an invariant TSC, or off
+ * x86, both calls fall back to clock_gettime.
+ *
+ * now_ns() follows the wall clock, so it is comparable across hosts and may
+ * step slightly at a resync. monotonic_ns() is rebased without a step and
+ * never goes backwards on one thread.
+ */
+class Clock {
+public:
+    static constexpr uint64_t RESYNC_INTERVAL_NS = 1000000000ULL;
+    static constexpr uint64_t CALIBRATION_NS = 2000000ULL;
+
+    /**
+     * @brief Nanoseconds since the Unix epoch
+     */
+    static uint64_t now_ns() {
+#ifdef HFT_CLOCK_TSC
+        State& s = state();
+        if (s.tsc) {
+            return s.read(__rdtsc(), true);
+        }
+#endif
+        return read_clock(CLOCK_REALTIME);
+    }
+
+    /**
+     * @brief Nanoseconds on a clock that never steps, for measuring intervals
+     */
+    static uint64_t monotonic_ns() {
+#ifdef HFT_CLOCK_TSC
+        State& s = state();
+        if (s.tsc) {
+            return s.read(__rdtsc(), false);
+        }
+#endif
+        return read_clock(CLOCK_MONOTONIC);
+    }
+
+    /**
+     * @brief Timestamps come from the TSC rather than clock_gettime
+     */
+    static bool uses_tsc() {
+#ifdef HFT_CLOCK_TSC
+        return state().tsc;
+#else
+        return false;
+#endif
+    }
+
+private:
+    static uint64_t read_clock(clockid_t id) {
+        timespec ts;
+        clock_gettime(id, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+    }
+
+#ifdef HFT_CLOCK_TSC
+    __extension__ typedef unsigned __int128 uint128;
+
+    // Ticks are scaled by mult / 2^32
+    static uint64_t scale(uint64_t ticks, uint64_t mult) {
+        return static_cast<uint64_t>((static_cast<uint128>(ticks) * mult) >> 32);
+    }
+
+    /**
+     * @brief TSC read together with the clocks it is matched against
+     */
+    struct Sample {
+        uint64_t tsc;
+        uint64_t raw_ns;
+        uint64_t wall_ns;
+        uint64_t mono_ns;
+    };
+
+    static Sample sample() {
+        // Keep the tightest of a few brackets; rdtscp waits for the clock reads before it
+        Sample best{};
+        uint64_t best_width = UINT64_MAX;
+        for (int i = 0; i < 5; ++i) {
+            unsigned aux;
+            uint64_t before = __rdtscp(&aux);
+            Sample s;
+            s.raw_ns = read_clock(CLOCK_MONOTONIC_RAW);
+            s.wall_ns = read_clock(CLOCK_REALTIME);
+            s.mono_ns = read_clock(CLOCK_MONOTONIC);
+            uint64_t after = __rdtscp(&aux);
+            if (after - before < best_width) {
+                best_width = after - before;
+                s.tsc = before + (after - before) / 2;
+                best = s;
+            }
+        }
+        return best;
+    }
+
+    static bool invariant_tsc() {
+        unsigned eax, ebx, ecx, edx;
+        if (!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007) {
+            return false;
+        }
+        __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+        return (edx & (1u << 8)) != 0;
+    }
+
+    struct State {
+        bool tsc{false};
+        Sample calibration{};               // Start of the baseline the rate is measured over
+        uint64_t resync_ticks{0};
+        std::atomic<bool> resyncing{false};
+
+        // Conversion in effect; odd sequence while a resync rewrites it
+        std::atomic<uint64_t> sequence{0};
+        std::atomic<uint64_t> tsc_base{0};
+        std::atomic<uint64_t> mono_base{0};
+        std::atomic<uint64_t> wall_base{0};
+        std::atomic<uint64_t> mult{0};
+
+        State() {
+            tsc = invariant_tsc();
+            if (!tsc) {
+                return;
+            }
+            calibration = sample();
+            Sample end;
+            do {
+                end = sample();
+            } while (end.raw_ns - calibration.raw_ns < CALIBRATION_NS);
+
+            uint64_t rate = rate_since(end);
+            if (rate == 0) {
+                tsc = false;
+                return;
+            }
+            resync_ticks = static_cast<uint64_t>((static_cast<uint128>(RESYNC_INTERVAL_NS) << 32) / rate);
+            tsc_base.store(end.tsc, std::memory_order_relaxed);
+            mono_base.store(end.mono_ns, std::memory_order_relaxed);
+            wall_base.store(end.wall_ns, std::memory_order_relaxed);
+            mult.store(rate, std::memory_order_relaxed);
+        }
+
+        uint64_t rate_since(const Sample& now) const {
+            uint64_t ticks = now.tsc - calibration.tsc;
+            return ticks ? static_cast<uint64_t>((static_cast<uint128>(now.raw_ns - calibration.raw_ns) << 32) / ticks)
+                         : 0;
+        }
+
+        uint64_t read(uint64_t now, bool wall) {
+            uint64_t seq;
+            uint64_t base_tsc;
+            uint64_t base_ns;
+            uint64_t rate;
+            do {
+                seq = sequence.load(std::memory_order_acquire);
+                base_tsc = tsc_base.load(std::memory_order_relaxed);
+                base_ns = wall ? wall_base.load(std::memory_order_relaxed) : mono_base.load(std::memory_order_relaxed);
+                rate = mult.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+            } while ((seq & 1) || seq != sequence.load(std::memory_order_relaxed));
+
+            // A resync on another thread can move the base past a tick read just before it
+            if (now < base_tsc) {
+                return base_ns - scale(base_tsc - now, rate);
+            }
+            uint64_t elapsed = now - base_tsc;
+            if (elapsed > resync_ticks) {
+                resync();
+            }
+            return base_ns + scale(elapsed, rate);
+        }
+
+        void resync() {
+            bool expected = false;
+            if (!resyncing.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                return;
+            }
+
+            Sample now = sample();
+            uint64_t old_tsc = tsc_base.load(std::memory_order_relaxed);
+            uint64_t old_rate = mult.load(std::memory_order_relaxed);
+            uint64_t mono = mono_base.load(std::memory_order_relaxed) + scale(now.tsc - old_tsc, old_rate);
+            uint64_t rate = rate_since(now);
+
+            uint64_t seq = sequence.load(std::memory_order_relaxed);
+            sequence.store(seq + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            tsc_base.store(now.tsc, std::memory_order_relaxed);
+            mono_base.store(mono, std::memory_order_relaxed);
+            wall_base.store(now.wall_ns, std::memory_order_relaxed);
+            if (rate != 0) {
+                mult.store(rate, std::memory_order_relaxed);
+            }
+            sequence.store(seq + 2, std::memory_order_release);
+
+            resyncing.store(false, std::memory_order_release);
+        }
+    };
+
+    static State& state() {
+        static State instance;
+        return instance;
+    }
+#endif
+};
+
+} // namespace hft
+
+#endif // CLOCK_H
@@ -1,8 +1,18 @@
 #ifndef HFT_SERVER_H
 #define HFT_SERVER_H
 
+#include "latency_histogram.h"
 #include "message.h"
+#include "multicast_feed.h"
+#include "order_book.h"
+#include "outbound_queue.h"
+#include "receive_buffer.h"
+#include "recovery.h"
+#include "shm_transport.h"
+#include "uring.h"
+#include "wire_format.h"
 
+#include <array>
 #include <memory>
 #include <thread>
 #include <atomic>
@@ -24,13 +34,37 @@ namespace hft {
 
 /**
  * @brief Connection information structure
+ *
+ * Shared ownership lets a worker finish flushing a connection that another
+ * worker closed in the meantime.
  */
-struct Connection {
+struct Connection : std::enable_shared_from_this<Connection> {
     int fd;                         // File descriptor
     sockaddr_in addr;               // Client address
     std::chrono::steady_clock::time_point last_heartbeat;
-    uint64_t client_id;
+    uint64_t client_id;             // Unique across server restarts; journal session id
     bool is_authenticated;
+    ReceiveBuffer recv_buffer;      // Partial frames carried between reads
+    std::atomic<bool> handling{false};  // A worker is inside handle_client_events()
+    
+    // Outbound state; any worker may queue a fill for any connection
+    std::mutex send_mutex;
+    OutboundQueue outbound;         // Guarded by send_mutex, like the flags below
+    bool flush_scheduled{false};    // Listed for a flush at the end of some worker's loop
+    bool want_write{false};         // Socket was full or a send is in flight; its completion resumes the flush
+    bool sending{false};            // An io_uring SENDMSG reads the queue; nothing else may write the socket
+    bool closed{false};             // Fd closed; nothing may touch it any more
+    bool discarding{false};         // Shut down as a slow consumer; output is dropped until close
+    bool seqpacket{false};          // AF_UNIX SOCK_SEQPACKET: records hold whole frames
+    
+    // io_uring backend: the worker whose ring receives for the connection, and the in-flight send's header
+    int uring_worker{-1};
+    iovec send_iov[OutboundQueue::MAX_IOVECS];
+    msghdr send_msg{};
+    
+    // Shared-memory sessions have no fd; output goes to the slot's server-to-client ring
+    int shm_slot{-1};
+    ShmRing shm_outbound;
     
     Connection() : fd(-1), client_id(0), is_authenticated(false) {
         memset(&addr, 0, sizeof(addr));
@@ -39,6 +73,10 @@ struct Connection {
 
 /**
  * @brief Service interface for message processing
+ *
+ * Order types are always delivered as OrderMessage, MARKET_DATA and the
+ * subscription types as MarketDataMessage and the feed recovery types as
+ * RetransmitMessage, so services may downcast on message_type.
  */
 class IMessageService {
 public:
@@ -50,30 +88,158 @@ public:
 
 /**
  * @brief Order management service
+ *
+ * Matches orders in a MatchingEngine and reports fills to both sides. New,
+ * cancel and replace requests are acknowledged after matching with the same
+ * message type; the ack carries the server order id and the open quantity,
+ * with status PROCESSED while resting and COMPLETED once filled or
+ * cancelled. Cancel and replace must quote the server order id from an
+ * earlier ack. Unacceptable requests get ORDER_REJECT.
+ *
+ * With the Journal open, requests are journaled under the engine lock
+ * together with the fills and ack they caused, so the journal holds them
+ * in matching order.
  */
-class OrderService : public IMessageService {
+class OrderService final : public IMessageService, private TradeSink {
 public:
+    OrderService() = default;
+    explicit OrderService(const MatchingEngine::Config& config);
+    
     void process_message(const Message& msg, Connection& conn) override;
     void on_connection_established(Connection& conn) override;
     void on_connection_closed(Connection& conn) override;
     
+    /**
+     * @brief Cancel recovered orders and continue order and fill ids after them
+     *
+     * Call before the server starts, with the journal open. A stop is a
+     * disconnect for every session still open, so their resting orders are
+     * cancelled and a DISCONNECT is journaled for each session, as
+     * on_connection_closed() would have done.
+     * @return Number of orders cancelled
+     */
+    size_t restore(const std::vector<RecoveredOrder>& orders, uint64_t last_fill_id);
+    
 private:
     void handle_new_order(const OrderMessage& order, Connection& conn);
-    void handle_cancel_order(const Message& msg, Connection& conn);
-    void handle_replace_order(const Message& msg, Connection& conn);
+    void handle_cancel_order(const OrderMessage& cancel, Connection& conn);
+    void handle_replace_order(const OrderMessage& replace, Connection& conn);
+    OrderMessage make_ack(const OrderMessage& request, const MatchResult& result, Connection& conn);
+    void on_trade(const Trade& trade) override;
+    void send_fill(Connection& conn, uint64_t order_id, const Trade& trade);
+    
+    MatchingEngine engine_;
+    std::mutex engine_mutex_;
+    uint64_t next_fill_id_{1};
 };
 
 /**
  * @brief Market data service
+ *
+ * Clients subscribe to an instrument, named by symbol or id, with
+ * MARKET_DATA_SUBSCRIBE and leave with MARKET_DATA_UNSUBSCRIBE; both are
+ * acknowledged with the same type, status PROCESSED, or FAILED for an
+ * unknown instrument. Every MARKET_DATA update received is stamped with
+ * the instrument's next sequence number, kept as its latest value, encoded
+ * once and queued by reference on each of its subscribers.
+ *
+ * A subscription starts with a snapshot, the latest value re-sent with its
+ * sequence number, followed by incrementals. A subscriber whose socket is
+ * full has its pending update for a symbol replaced by newer ones, so it
+ * sees a gap in the sequence and the latest state rather than a backlog.
+ *
+ * With multicast enabled every update is also published once to the feed
+ * group. Receivers fill gaps with MARKET_DATA_RETRANSMIT and catch up with
+ * MARKET_DATA_SNAPSHOT over a TCP session, which is answered with the
+ * frames followed by the reply.
  */
-class MarketDataService : public IMessageService {
+class MarketDataService final : public IMessageService {
 public:
+    MarketDataService();
+    ~MarketDataService() override;
+    
     void process_message(const Message& msg, Connection& conn) override;
     void on_connection_established(Connection& conn) override;
     void on_connection_closed(Connection& conn) override;
     
+    /**
+     * @brief Latest update received for an instrument
+     * @return false if none has been received
+     */
+    bool latest(InstrumentId instrument, MarketDataMessage& data);
+    
+    /**
+     * @brief Seed latest values and sequence numbers from recovery, before the server starts
+     * @return Number of instruments restored
+     */
+    size_t restore(const std::vector<MarketDataMessage>& latest);
+    
+    /**
+     * @brief Publish updates to a multicast group as well; call before the server starts
+     * @return false if the publisher socket cannot be set up
+     */
+    bool enable_multicast(const MulticastConfig& config);
+    
+    const MulticastPublisher& multicast() const { return multicast_; }
+    
+    static constexpr uint32_t MAX_RETRANSMIT = 1024;   // Frames per MARKET_DATA_RETRANSMIT reply
+    
 private:
-    void broadcast_market_data(const MarketDataMessage& data);
+    /**
+     * @brief Subscribers of one instrument
+     *
+     * Channels are published once and never freed before the service, so
+     * they are looked up without a lock; each has its own lock so
+     * instruments publish independently.
+     */
+    struct Channel {
+        struct Subscriber {
+            Connection* conn;
+            uint64_t position;          // Of the last update queued on conn, for conflation
+        };
+        
+        std::mutex mutex;
+        std::vector<Subscriber> subscribers;
+        MarketDataMessage last;         // Latest value cache
+        SharedFrame* snapshot{nullptr}; // last, encoded; one reference held here
+        uint32_t sequence{0};
+        
+        void remove(Connection* conn);
+    };
+    
+    Channel* find_channel(InstrumentId instrument, bool create);
+    void subscribe(const MarketDataMessage& request, Connection& conn);
+    void unsubscribe(const MarketDataMessage& request, Connection& conn);
+    void send_ack(const MarketDataMessage& request, bool accepted, Connection& conn);
+    void broadcast_market_data(const MarketDataMessage& data, Connection& conn);
+    void recover(const RetransmitMessage& request, Connection& conn);
+    
+    std::unique_ptr<std::atomic<Channel*>[]> channels_;                     // Indexed by instrument id
+    std::unordered_map<Connection*, std::vector<Channel*>> subscriptions_;  // For cleanup on close
+    std::mutex channels_mutex_;     // Guards subscriptions_ and channel creation; taken before any channel's mutex
+    MulticastPublisher multicast_;  // Its lock is taken after a channel's
+};
+
+/**
+ * @brief Network I/O engine used by the worker threads
+ */
+enum class IoBackend : uint8_t {
+    EPOLL = 0,          // Edge-triggered epoll with recv()/send() per event
+    IO_URING = 1        // Multishot accept/recv on one ring per worker
+};
+
+/**
+ * @brief Unix-domain listener for tools on the same host
+ *
+ * Served by the same workers and framing as TCP. With SOCK_SEQPACKET
+ * every record holds whole frames in both directions: the server sends
+ * one frame per record, so a client can read with a MAX_FRAME_SIZE
+ * buffer and never reassemble, and a record from a client that ends
+ * mid-frame closes the connection.
+ */
+struct UnixSocketConfig {
+    std::string path;                   // Empty for none; a stale socket file is replaced
+    bool seqpacket = false;             // SOCK_SEQPACKET instead of SOCK_STREAM
 };
 
 /**
@@ -89,8 +255,59 @@ public:
     
     /**
      * @brief Initialize the server
+     * @param sharded Give every worker its own SO_REUSEPORT listener, epoll
+     *        instance and connection table instead of sharing one
+     * @param backend I/O engine; IO_URING fails here if the kernel lacks support
+     * @param local Also listen on a Unix-domain socket; in sharded mode the
+     *        workers take turns accepting on it
+     */
+    bool initialize(const std::string& ip, uint16_t port, size_t thread_count = 4,
+                    bool sharded = false, IoBackend backend = IoBackend::EPOLL,
+                    const UnixSocketConfig& local = {});
+    
+    /**
+     * @brief Worker polling behaviour for dedicated, isolated cores
+     */
+    struct PollingConfig {
+        bool spin = false;              // Poll with a zero timeout instead of sleeping in the kernel
+        int busy_poll_us = 0;           // SO_BUSY_POLL on client sockets, 0 to leave off
+        std::vector<int> cpus;          // Worker i runs on cpus[i % size]; empty for no pinning
+    };
+    
+    /**
+     * @brief Configure worker polling; takes effect at start()
+     */
+    void set_polling(const PollingConfig& config);
+    
+    /**
+     * @brief Per-connection outbound queue limits
+     */
+    struct OutboundConfig {
+        size_t queue_bytes = OutboundQueue::DEFAULT_CAPACITY;  // Rounded up to a power of two
+        SlowConsumerPolicy policy = SlowConsumerPolicy::DISCONNECT;
+    };
+    
+    /**
+     * @brief Configure outbound queues; applies to connections accepted afterwards
+     */
+    void set_outbound(const OutboundConfig& config);
+    
+    /**
+     * @brief Shared-memory transport for clients on the same host
+     */
+    struct SharedMemoryConfig {
+        std::string name;                                       // Segment /dev/shm/<name>
+        size_t sessions = ShmSegment::DEFAULT_SLOTS;            // Concurrent client sessions
+        size_t ring_bytes = ShmSegment::DEFAULT_RING_BYTES;     // Per direction, rounded up to a power of two
+    };
+    
+    /**
+     * @brief Serve sessions over shared memory as well as TCP
+     *
+     * Creates the segment now so errors surface at startup; one extra
+     * thread polls every session from start() on. Call after initialize().
      */
-    bool initialize(const std::string& ip, uint16_t port, size_t thread_count = 4);
+    bool enable_shared_memory(const SharedMemoryConfig& config);
     
     /**
      * @brief Start the server
@@ -102,6 +319,34 @@ public:
      */
     void stop();
     
+    /**
+     * @brief Message classes with their own latency histogram
+     */
+    enum StatsType : size_t {
+        STATS_ORDER_NEW = 0,
+        STATS_ORDER_CANCEL,
+        STATS_ORDER_REPLACE,
+        STATS_MARKET_DATA,
+        STATS_OTHER,
+        STATS_TYPE_COUNT
+    };
+    
+    static size_t stats_type(MessageType type);
+    static const char* stats_type_name(size_t type);
+    
+    /**
+     * @brief Processing latency distribution of one message class
+     */
+    struct LatencySummary {
+        uint64_t count;
+        double mean_us;
+        double p50_us;
+        double p99_us;
+        double p999_us;
+        double p9999_us;
+        double max_us;
+    };
+    
     /**
      * @brief Get server statistics
      */
@@ -110,63 +355,213 @@ public:
         uint64_t total_connections;
         double avg_latency_us;
         uint64_t peak_connections;
+        uint64_t frames_dropped;                                 // Slow-consumer drops
+        uint64_t frames_conflated;
+        uint64_t slow_consumer_disconnects;
+        LatencySummary latency;                                  // All message types
+        std::array<LatencySummary, STATS_TYPE_COUNT> latency_by_type;
     };
     
+    /**
+     * @brief Aggregate the per-worker counters and histograms
+     *
+     * Workers never synchronize with this call; the snapshot may miss
+     * samples recorded while it runs.
+     */
     ServerStats get_stats() const;
     
     /**
      * @brief Register a message service
+     *
+     * Publishes a new dispatch table; workers keep using the previous one
+     * until they load the new pointer. Intended for startup, not the hot path.
      */
     void register_service(MessageType type, std::shared_ptr<IMessageService> service);
     
+    /**
+     * @brief Encode and queue a message to a client
+     *
+     * On a worker thread the frame is written with everything else queued
+     * for the connection at the end of the current event-loop iteration;
+     * other threads write through.
+     */
+    void send_response(Connection& conn, const Message& response);
+    void send_response(Connection& conn, const OrderMessage& response);
+    void send_response(Connection& conn, const FillMessage& response);
+    void send_response(Connection& conn, const MarketDataMessage& response);
+    void send_response(Connection& conn, const RetransmitMessage& response);
+    
+    /**
+     * @brief Queue a frame encoded once for many connections
+     *
+     * The connection's queue references the frame instead of copying it.
+     * Consumes one reference of frame whether or not it is queued.
+     *
+     * @param position Queue position of the previous frame of the same
+     *        stream on conn, or nullptr. While the socket is full that
+     *        frame is replaced if it is still unsent, so a lagging
+     *        connection holds one pending update per stream instead of a
+     *        backlog. Updated to the position of the frame queued.
+     */
+    void send_shared(Connection& conn, SharedFrame* frame, uint64_t* position = nullptr);
+    
 private:
+    /**
+     * @brief Listener, epoll instance and connection table served by workers
+     *
+     * In shared mode a single reactor is polled by every worker; in sharded
+     * mode each worker owns one, so a connection never leaves its thread.
+     */
+    struct Reactor {
+        int listen_fd{-1};
+        int epoll_fd{-1};
+        std::unordered_map<int, std::shared_ptr<Connection>> connections;
+        std::mutex connections_mutex;
+    };
+    
+    /**
+     * @brief Statistics written only by the owning worker
+     *
+     * Cache-line aligned so workers never share a line; get_stats() reads
+     * them without locking.
+     */
+    struct alignas(64) WorkerStats {
+        std::atomic<uint64_t> messages_processed{0};
+        alignas(64) std::atomic<uint64_t> connections_accepted{0};
+        alignas(64) std::array<LatencyHistogram, STATS_TYPE_COUNT> latency;
+    };
+    
+    /**
+     * @brief Ring, send slots and closing connections of one io_uring worker
+     */
+    struct UringWorker;
+    
+    /**
+     * @brief Connection and inbound ring of one shared-memory slot
+     */
+    struct ShmSession {
+        std::shared_ptr<Connection> conn;
+        ShmRing inbound;
+    };
+    
     HFTServer() = default;
     ~HFTServer();
     
+    bool setup_reactor(Reactor& reactor, bool reuse_port);
+    bool setup_local_listener();
+    void pin_worker(size_t thread_id);
     void worker_thread(size_t thread_id);
-    void accept_connections();
-    void handle_client_events(int client_fd);
-    void process_client_message(const Message& msg, Connection& conn);
-    void process_client_message(const OrderMessage& msg, Connection& conn);
-    void process_client_message(const MarketDataMessage& msg, Connection& conn);
-    void send_response(Connection& conn, const Message& response);
-    void close_connection(Connection& conn);
-    void setup_socket_options(int sock_fd);
+    void uring_worker_thread(size_t thread_id);
+    void resume_handoffs(UringWorker& worker);
+    void handle_uring_completion(Reactor& reactor, UringWorker& worker, const io_uring_cqe& cqe,
+                                 WorkerStats& stats);
+    void shm_thread(size_t thread_id);
+    bool poll_shm_session(size_t index, ShmSession& session, WorkerStats& stats);
+    void open_shm_session(size_t index, ShmSession& session, WorkerStats& stats);
+    void close_shm_session(size_t index, ShmSession& session, ShmSlotState next);
+    void accept_connections(Reactor& reactor, int listen_fd, WorkerStats& stats);
+    Connection* add_connection(Reactor& reactor, int client_fd, const sockaddr_in& client_addr,
+                               WorkerStats& stats);
+    void count_connection(WorkerStats& stats);
+    void handle_client_events(Reactor& reactor, int client_fd, uint32_t events, WorkerStats& stats);
+    void arm_connection(Reactor& reactor, Connection& conn);
+    bool process_frames(Reactor& reactor, Connection& conn, WorkerStats& stats);
+    void dispatch_frame(const uint8_t* frame, size_t length, Connection& conn, WorkerStats& stats);
+    void process_client_message(const Message& msg, Connection& conn, WorkerStats& stats);
+    void process_client_message(const OrderMessage& msg, Connection& conn, WorkerStats& stats);
+    void process_client_message(const MarketDataMessage& msg, Connection& conn, WorkerStats& stats);
+    void invoke_service(const Message& msg, Connection& conn);
+    static void record_latency(WorkerStats& stats, MessageType type, uint64_t start_ns);
+    void send_frame(Connection& conn, const uint8_t* frame, size_t length, SharedFrame* shared = nullptr,
+                    uint64_t* position = nullptr);
+    bool queue_frame(Connection& conn, const uint8_t* frame, size_t length, SharedFrame* shared,
+                     uint64_t* position);
+    void flush_pending();
+    void flush_connection(Connection& conn);
+    void flush_locked(Connection& conn, bool immediate = false);
+    void flush_shm_locked(Connection& conn);
+    static ssize_t send_records(int fd, const iovec* iov, int count, size_t& offered);
+    void notify_services(Connection& conn, bool established);
+    void close_connection(Reactor& reactor, Connection& conn);
+    void setup_socket_options(int sock_fd, bool tcp = true);
     void set_non_blocking(int sock_fd);
     
     // Server configuration
     std::string server_ip_;
     uint16_t server_port_;
     size_t thread_count_;
+    bool sharded_{false};
+    IoBackend backend_{IoBackend::EPOLL};
+    PollingConfig polling_;
+    OutboundConfig outbound_;
+    UnixSocketConfig local_;
     
     // Server state
     std::atomic<bool> running_{false};
-    int server_socket_{-1};
-    int epoll_fd_{-1};
     
     // Threading
     std::vector<std::thread> worker_threads_;
     
-    // Connections
-    std::unordered_map<int, std::unique_ptr<Connection>> connections_;
-    mutable std::mutex connections_mutex_;
+    // Reactors (one shared, or one per worker when sharded)
+    std::vector<std::unique_ptr<Reactor>> reactors_;
+    std::atomic<uint64_t> active_connections_{0};
+    std::atomic<uint64_t> next_client_id_{0};   // Seeded from the clock at initialize()
+    
+    // Unix-domain listener, registered with every reactor; its address tags its epoll events
+    int local_listen_fd_{-1};
+    
+    // Shared-memory session slots, polled by one extra thread
+    ShmSegment shm_;
+    
+    // io_uring workers, indexed like their threads; a thread without a ring hands blocked connections to one
+    std::vector<std::unique_ptr<UringWorker>> uring_workers_;
+    
+    // Ring of the calling io_uring worker, used to submit sends and wait for full sockets to drain
+    static thread_local UringWorker* current_uring_;
+    
+    // Connections the calling worker queued output for during this iteration
+    static thread_local std::vector<std::shared_ptr<Connection>>* pending_flush_;
     
     // Services
-    std::unordered_map<MessageType, std::shared_ptr<IMessageService>> services_;
-    mutable std::mutex services_mutex_;
+    enum class ServiceKind : uint8_t {
+        NONE = 0,
+        GENERIC = 1,        // Dispatched through the virtual interface
+        ORDER = 2,          // Built-in OrderService, called directly
+        MARKET_DATA = 3     // Built-in MarketDataService, called directly
+    };
+    
+    struct ServiceEntry {
+        IMessageService* service{nullptr};
+        ServiceKind kind{ServiceKind::NONE};
+    };
     
-    // Statistics
-    mutable std::mutex stats_mutex_;
-    ServerStats stats_{};
+    /**
+     * @brief Immutable dispatch table indexed by the MessageType byte
+     *
+     * Tables are copy-on-write and never freed before the server, so a
+     * worker can read a stale one without a lock or reference count.
+     */
+    struct ServiceTable {
+        std::array<ServiceEntry, 256> entries{};
+    };
+    
+    std::atomic<const ServiceTable*> service_table_{nullptr};
+    std::vector<std::unique_ptr<ServiceTable>> service_tables_;      // Current and retired tables
+    std::vector<std::shared_ptr<IMessageService>> service_owners_;  // Keeps services alive
+    mutable std::mutex services_mutex_;                             // Serializes registration only
+    
+    // Statistics (one slot per worker, plus the global connection peak)
+    std::vector<std::unique_ptr<WorkerStats>> worker_stats_;
+    std::atomic<uint64_t> peak_connections_{0};
+    std::atomic<uint64_t> frames_dropped_{0};
+    std::atomic<uint64_t> frames_conflated_{0};
+    std::atomic<uint64_t> slow_consumer_disconnects_{0};
     
     // Performance optimization
     static constexpr size_t MAX_EVENTS = 1024;
     static constexpr size_t BUFFER_SIZE = 4096;
+    static constexpr int MAX_RECORDS = 256;        // Frames per sendmmsg on SOCK_SEQPACKET
     static constexpr int BACKLOG = 1024;
-    
-    // Pre-allocated buffers for zero-copy operations
-    std::vector<uint8_t> send_buffer_;
-    std::vector<uint8_t> recv_buffer_;
 };
 
 } // namespace hft
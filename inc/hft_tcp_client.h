@@ -1,15 +1,20 @@
 #ifndef HFT_TCP_CLIENT_H
 #define HFT_TCP_CLIENT_H
 
+#include "latency_correlator.h"
+#include "latency_histogram.h"
 #include "message.h"
+#include "multicast_feed.h"
+#include "receive_buffer.h"
+#include "send_ring.h"
+#include "shm_transport.h"
+#include "wire_format.h"
 
 #include <memory>
 #include <thread>
 #include <atomic>
 #include <vector>
-#include <queue>
 #include <mutex>
-#include <condition_variable>
 #include <chrono>
 #include <functional>
 #include <sys/epoll.h>
@@ -38,12 +43,22 @@ enum class ConnectionState : uint8_t {
     ERROR = 4
 };
 
+/**
+ * @brief Which threads drive the client
+ */
+enum class ClientThreading : uint8_t {
+    THREADS = 0,        // Separate receive, send, heartbeat and epoll threads
+    EVENT_LOOP = 1,     // One thread runs poll() until stop()
+    APPLICATION = 2     // No thread: the application calls poll() itself
+};
+
 /**
  * @brief Message handler callback type
  */
 using MessageHandler = std::function<void(const Message&)>;
 using OrderMessageHandler = std::function<void(const OrderMessage&)>;
 using MarketDataHandler = std::function<void(const MarketDataMessage&)>;
+using FillHandler = std::function<void(const FillMessage&)>;
 
 /**
  * @brief Client statistics structure
@@ -56,10 +71,20 @@ struct ClientStats {
     uint64_t connection_attempts{0};
     uint64_t reconnection_attempts{0};
     uint64_t errors{0};
-    uint64_t min_latency_ns{UINT64_MAX};
+    uint64_t multicast_packets{0};
+    uint64_t multicast_gaps{0};             // Detected, whether filled or not
+    uint64_t multicast_retransmitted{0};    // Frames recovered over TCP
+    uint64_t multicast_snapshots{0};
+    uint64_t multicast_lost{0};             // Frames skipped because recovery failed
+    uint64_t round_trips{0};                // Order responses matched to their request
+    uint64_t unmatched_responses{0};        // Order responses whose request was unknown or evicted
+    uint64_t min_latency_ns{UINT64_MAX};    // Round trip, send to response
     uint64_t max_latency_ns{0};
     uint64_t total_latency_ns{0};
     double avg_latency_us{0.0};
+    double p50_latency_us{0.0};
+    double p99_latency_us{0.0};
+    double p99_9_latency_us{0.0};
     std::chrono::steady_clock::time_point start_time;
     std::chrono::steady_clock::time_point last_message_time;
 };
@@ -107,8 +132,11 @@ public:
     
     /**
      * @brief Send a message to the server
+     *
+     * Sends are encoded straight into the send ring; from one thread only
+     * unless the ring was configured for several producers.
      * @param msg Message to send
-     * @return true if message queued for sending
+     * @return true if message queued for sending, false when disconnected or the ring is full
      */
     bool send_message(const Message& msg);
     
@@ -126,6 +154,14 @@ public:
      */
     bool send_market_data(const MarketDataMessage& market_data);
     
+    /**
+     * @brief Subscribe to or unsubscribe from a symbol's market data
+     * @param symbol Trading symbol (at most 16 characters)
+     * @return true if the request was queued for sending
+     */
+    bool subscribe_market_data(const std::string& symbol);
+    bool unsubscribe_market_data(const std::string& symbol);
+    
     /**
      * @brief Send a heartbeat message
      * @return true if heartbeat queued for sending
@@ -138,6 +174,7 @@ public:
     void set_message_handler(MessageHandler handler);
     void set_order_handler(OrderMessageHandler handler);
     void set_market_data_handler(MarketDataHandler handler);
+    void set_fill_handler(FillHandler handler);
     
     /**
      * @brief Start the client (starts background threads)
@@ -149,6 +186,25 @@ public:
      */
     void stop();
     
+    /**
+     * @brief Run the client on one event loop instead of four threads
+     *
+     * The loop reads, writes the send ring, sends heartbeats and reconnects
+     * from a single poll() over the socket, so handlers run on that thread
+     * only and nothing sleeps on a timer. TCP only: with shared memory the
+     * client keeps its threads. Call before start().
+     */
+    void set_threading(ClientThreading threading);
+    
+    /**
+     * @brief One turn of the event loop, waiting at most timeout_ms for something to do
+     *
+     * For ClientThreading::APPLICATION, after start(); always from the same
+     * thread. Handlers run inside the call.
+     * @return Reads and frames written, 0 if the turn found nothing to do
+     */
+    int poll(int timeout_ms = 0);
+    
     /**
      * @brief Get client statistics
      */
@@ -174,6 +230,53 @@ public:
      */
     void set_heartbeat_interval(uint32_t interval_ms);
     
+    /**
+     * @brief Busy-poll the socket instead of sleeping between reads
+     *
+     * Trades a fully used core per receive thread for lower wake-up latency.
+     */
+    void set_spin_mode(bool enable);
+    
+    /**
+     * @brief Size the send ring and choose who may send
+     *
+     * ProducerMode::SINGLE, the default, is for one sending thread; MULTI
+     * lets any thread send at the cost of a compare-and-swap per message.
+     * Heartbeats never go through the ring. Call before start().
+     */
+    void set_send_queue(size_t capacity, ProducerMode mode = ProducerMode::SINGLE);
+    
+    /**
+     * @brief Write sends to the socket on the calling thread
+     *
+     * Saves the hand-off to the send thread. A send still goes through the
+     * ring while frames are queued, or while the send thread is writing, and
+     * whatever the socket does not take is queued behind it, so the order on
+     * the wire is the order of the calls. TCP with ProducerMode::SINGLE only;
+     * otherwise every send is queued.
+     */
+    void set_inline_send(bool enable);
+    
+    /**
+     * @brief Connect through the server's shared-memory segment instead of TCP
+     *
+     * For a client on the same host as a server started with --shm <name>;
+     * call before connect(). An empty name selects TCP.
+     */
+    void set_shared_memory(const std::string& name);
+    
+    /**
+     * @brief Also receive the server's multicast market data feed
+     *
+     * From start() on a thread joins the group and hands updates to the
+     * market data handler in feed order, so the handler may be called from
+     * two threads. It keeps a second TCP session to the server for recovery:
+     * gaps are filled by retransmission, and a join, a publisher restart or
+     * a gap older than the server's history resynchronizes from a snapshot.
+     * Call before start().
+     */
+    void enable_multicast(const MulticastConfig& config);
+    
     /**
      * @brief Create test order message
      */
@@ -197,17 +300,50 @@ private:
     void send_thread_func();
     void heartbeat_thread_func();
     void epoll_thread_func();
+    void multicast_thread_func();
+    void event_loop_func();
     
     // Connection management
     bool establish_connection();
+    bool begin_connect();
+    bool finish_connect();
     void handle_disconnection();
     void attempt_reconnection();
+    bool connect_shared_memory(uint32_t timeout_ms);
+    void lock_shared_memory();
+    void release_shared_memory();
+    void receive_shared_memory();
+    bool send_shared_memory(const void* data, size_t size);
+    
+    // Multicast feed recovery
+    bool fill_gap(uint64_t& expected, uint64_t until);
+    bool resync_feed(uint64_t& expected);
+    void deliver_feed_frames(const uint8_t* frames, size_t length, uint64_t sequence, uint64_t& expected);
+    bool request_recovery(RetransmitMessage& request, std::vector<uint8_t>& frames);
+    bool connect_recovery();
+    void close_recovery();
     
     // Message processing
-    void process_received_data(const char* data, size_t size);
+    template <typename T>
+    bool enqueue_message(const T& msg);
+    bool transmit_frame(const uint8_t* data, size_t length, bool unless_queued = false);
+    bool send_inline(const uint8_t* data, size_t length);
+    bool queue_bytes(const uint8_t* data, size_t length, wire::Frame** queued = nullptr);
+    void wake_sender();
+    
+    // Event loop
+    int read_socket();
+    int flush_output();
+    void send_loop_heartbeat();
+    void reconnect_step(std::chrono::steady_clock::time_point now, short revents);
+    ssize_t write_some(const iovec* iov, int count);
+    bool send_subscription(MessageType type, const std::string& symbol);
+    void process_received_data();
+    void process_frame(const uint8_t* frame, size_t length);
     void process_message(const Message& msg);
     void process_order_message(const OrderMessage& order);
     void process_market_data_message(const MarketDataMessage& market_data);
+    void process_fill_message(const FillMessage& fill);
     
     // Socket operations
     void setup_socket_options(int sock_fd);
@@ -215,7 +351,9 @@ private:
     bool send_data(const void* data, size_t size);
     
     // Statistics
-    void update_latency_stats(uint64_t latency_ns);
+    void correlate_order_response(const OrderMessage& order, const LatencyStamp& received);
+    void correlate_fill(const FillMessage& fill, const LatencyStamp& received);
+    void update_latency_stats(const LatencyStamp& sent, const LatencyStamp& received, uint64_t server_ns);
     void calculate_average_latency();
     
     // Configuration
@@ -228,27 +366,63 @@ private:
     int socket_fd_{-1};
     int epoll_fd_{-1};
     
+    // Shared-memory transport, used instead of socket_fd_ when shm_name_ is set
+    std::string shm_name_;
+    ShmSegment shm_;
+    std::atomic<int> shm_slot_{-1};     // Cleared by whichever thread releases the session
+    std::atomic<bool> shm_reading_{false};  // Receive thread is inside the mapping
+    ShmRing shm_inbound_;               // Client to server; written by the send thread only
+    ShmRing shm_outbound_;              // Server to client; read by the receive thread only
+    std::chrono::steady_clock::time_point shm_liveness_check_;
+    
+    // Multicast feed, with its own TCP session for gap fill; used by the multicast thread only
+    MulticastConfig multicast_;
+    bool multicast_enabled_{false};
+    int recovery_fd_{-1};
+    uint64_t next_recovery_id_{1};
+    
     // Threading
     std::atomic<bool> running_{false};
     std::thread receive_thread_;
     std::thread send_thread_;
     std::thread heartbeat_thread_;
     std::thread epoll_thread_;
-    
-    // Message queues
-    std::queue<Message> send_queue_;
-    mutable std::mutex send_queue_mutex_;
-    std::condition_variable send_queue_cv_;
+    std::thread multicast_thread_;
+    
+    // Send ring, drained by the send thread; producers wake it through send_event_
+    std::unique_ptr<SendRing<wire::Frame>> send_ring_;
+    ShmEvent send_event_;
+    std::atomic<bool> heartbeat_due_{false};
+    std::atomic<bool> inline_send_{false};
+    std::atomic<bool> socket_busy_{false};  // Held by whichever thread is writing to socket_fd_
+    wire::Frame* remainder_{nullptr};       // Queued rest of a frame an inline send cut short; under socket_busy_
+    bool remainder_stale_{false};           // Its connection dropped before it went out; under socket_busy_
+    
+    // Event loop state; touched by the loop thread only unless noted
+    ClientThreading threading_{ClientThreading::THREADS};
+    bool event_loop_{false};                // This run is driven by poll()
+    std::thread event_loop_thread_;
+    int wake_fd_{-1};                       // eventfd producers write while the loop sleeps
+    std::atomic<bool> loop_sleeping_{false};
+    bool loop_connecting_{false};
+    std::chrono::steady_clock::time_point reconnect_at_;    // Next attempt, or the current one's deadline
+    std::chrono::steady_clock::time_point next_heartbeat_;
+    size_t front_offset_{0};                // Bytes of the ring's front frame already written
+    wire::Frame heartbeat_out_;
+    size_t heartbeat_offset_{0};
+    std::atomic<bool> heartbeat_pending_{false};    // Part of heartbeat_out_ still to write; under socket_busy_
     
     // Message handlers
     MessageHandler message_handler_;
     OrderMessageHandler order_handler_;
     MarketDataHandler market_data_handler_;
+    FillHandler fill_handler_;
     
     // Auto-reconnection
     std::atomic<bool> auto_reconnect_{true};
     std::atomic<uint32_t> reconnect_interval_ms_{1000};
     std::atomic<uint32_t> heartbeat_interval_ms_{1000};
+    std::atomic<bool> spin_{false};
     
     // Statistics
     mutable std::mutex stats_mutex_;
@@ -256,8 +430,8 @@ private:
     
     // Buffers
     static constexpr size_t BUFFER_SIZE = 65536;
-    std::vector<char> recv_buffer_;
-    std::vector<char> send_buffer_;
+    ReceiveBuffer recv_buffer_{BUFFER_SIZE};
+    ReceiveBuffer recovery_buffer_{BUFFER_SIZE};
     
     // Random number generation for test data
     std::random_device rd_;
@@ -269,9 +443,14 @@ private:
     // Test symbols
     std::vector<std::string> test_symbols_;
     
-    // Latency measurements
-    std::vector<uint64_t> latency_measurements_;
-    mutable std::mutex latency_mutex_;
+    // Request/response correlation; the histograms are written under stats_mutex_
+    LatencyCorrelator requests_{65536};     // By message_id, recorded as orders are queued
+    LatencyCorrelator open_orders_{16384};  // By order_id, acked orders awaiting a first fill
+    LatencyCorrelator early_fills_{16384};  // By order_id, first fills that beat their ack
+    LatencyHistogram round_trip_histogram_;
+    LatencyHistogram outbound_histogram_;   // Send to the server's response timestamp
+    LatencyHistogram inbound_histogram_;    // Server's response timestamp to receipt
+    LatencyHistogram fill_histogram_;       // Send to first fill
     
     // Performance monitoring
     std::chrono::steady_clock::time_point last_stats_time_;
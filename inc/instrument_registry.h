@@ -0,0 +1,132 @@
+#ifndef INSTRUMENT_REGISTRY_H
+#define INSTRUMENT_REGISTRY_H
+
+#include "message.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace hft {
+
+/**
+ * @brief Maps NUL-padded symbols to dense instrument ids (Singleton)
+ *
+ * Loaded from a file at startup, symbols get ids 0..n-1 in file order and
+ * are found through a hash-and-displace perfect hash: one bucket seed, one
+ * slot and one 16-byte compare per lookup, with no probing. The table is
+ * then fixed and unknown symbols resolve to INVALID_INSTRUMENT.
+ *
+ * Without a file, symbols are interned on first use into an insert-only
+ * open-addressed table instead; lookups stay lock-free and only an insert
+ * takes a lock. Interning stops at intern_limit() symbols, so clients
+ * cannot make the server create books without bound.
+ *
+ * Either way ids are dense, so per-instrument state can live in flat
+ * arrays indexed by id.
+ */
+class InstrumentRegistry {
+public:
+    using Symbol = std::array<char, 16>;
+
+    static constexpr size_t MAX_INSTRUMENTS = INVALID_INSTRUMENT;
+    static constexpr size_t DEFAULT_INTERN_LIMIT = 1024;
+
+    static InstrumentRegistry& get_instance();
+
+    InstrumentRegistry(const InstrumentRegistry&) = delete;
+    InstrumentRegistry& operator=(const InstrumentRegistry&) = delete;
+
+    /**
+     * @brief Load one symbol per line; blank lines and text after '#' are ignored
+     *
+     * Call before the server starts.
+     * @return false on I/O error, an over-long or duplicate symbol, or too many symbols
+     */
+    bool load(const std::string& path);
+
+    /**
+     * @brief Fix the table to symbols, which get ids in order
+     * @return false on a duplicate or too many symbols
+     */
+    bool assign(const std::vector<Symbol>& symbols);
+
+    /**
+     * @brief Id of symbol, or INVALID_INSTRUMENT if unknown
+     */
+    InstrumentId find(const Symbol& symbol) const;
+
+    /**
+     * @brief Like find(), but adds an unknown symbol unless the table is fixed or at the limit
+     */
+    InstrumentId intern(const Symbol& symbol);
+
+    /**
+     * @brief Cap on symbols interned without a file (at most MAX_INSTRUMENTS)
+     *
+     * Call before the server starts.
+     */
+    void set_intern_limit(size_t limit) { intern_limit_ = std::min(limit, MAX_INSTRUMENTS); }
+    size_t intern_limit() const { return intern_limit_; }
+
+    /**
+     * @brief Complete msg's instrument: the symbol of a known id, else the id of its symbol
+     *
+     * Leaves instrument_id INVALID_INSTRUMENT for an unknown or empty symbol.
+     */
+    template <typename T>
+    void resolve(T& msg) {
+        if (contains(msg.instrument_id)) {
+            msg.symbol = symbol(msg.instrument_id);
+        } else {
+            msg.instrument_id = msg.symbol[0] != '\0' ? intern(msg.symbol) : INVALID_INSTRUMENT;
+        }
+    }
+
+    const Symbol& symbol(InstrumentId id) const { return symbols_[id]; }
+
+    bool contains(InstrumentId id) const { return id < size(); }
+    size_t size() const { return count_.load(std::memory_order_acquire); }
+    bool fixed() const { return fixed_; }
+
+private:
+    struct Slot {
+        Symbol symbol;
+        InstrumentId id{INVALID_INSTRUMENT};
+    };
+
+    InstrumentRegistry();
+
+    static uint64_t hash(const Symbol& symbol);
+    static uint64_t place(uint64_t hash, uint32_t seed);
+    bool build(const std::vector<Symbol>& symbols, size_t slot_count);
+    InstrumentId find_interned(const Symbol& symbol, uint64_t hash) const;
+
+    // Id -> symbol for every instrument
+    std::unique_ptr<Symbol[]> symbols_;
+    std::atomic<size_t> count_{0};
+    bool fixed_{false};
+    size_t intern_limit_{DEFAULT_INTERN_LIMIT};
+
+    // Perfect hash of a loaded table
+    std::vector<uint32_t> seeds_;       // Displacement seed per bucket
+    std::vector<Slot> slots_;
+    uint64_t bucket_mask_{0};
+    uint64_t slot_mask_{0};
+
+    // Symbols interned at run time; slots are published with a release store
+    static constexpr size_t INTERN_SLOTS = 2 * (MAX_INSTRUMENTS + 1);
+    std::unique_ptr<std::atomic<InstrumentId>[]> interned_;
+    std::mutex intern_mutex_;           // Serializes inserts only
+};
+
+} // namespace hft
+
+#endif // INSTRUMENT_REGISTRY_H
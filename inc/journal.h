@@ -0,0 +1,288 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "message.h"
+#include "wire_format.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace hft {
+
+/**
+ * @brief What a journal record holds
+ */
+enum class JournalEntry : uint8_t {
+    INBOUND = 1,        // Client order or market data update, in the order it was applied
+    OUTBOUND = 2,       // Ack or fill sent to a client
+    DISCONNECT = 3      // Session closed and its resting orders cancelled; no frame
+};
+
+/**
+ * @brief When the writer forces journal pages to disk
+ *
+ * Without a sync, records reach the page cache and survive a crash of the
+ * process but not of the machine.
+ */
+enum class JournalSync : uint8_t {
+    NONE = 0,
+    MSYNC = 1,          // msync() the range written since the last sync
+    FDATASYNC = 2       // fdatasync() the segment file
+};
+
+#pragma pack(push, 1)
+
+/**
+ * @brief Start of every segment file
+ */
+struct JournalSegmentHeader {
+    char magic[8];                  // "HFTJRNL1"
+    uint32_t version;
+    uint32_t header_size;           // Records start here
+    uint64_t index;                 // Segment number, from 1
+    uint64_t first_sequence;        // Sequence of the first record
+    uint8_t reserved[32];
+};
+
+/**
+ * @brief Header of one journal record, followed by an encoded wire frame
+ *
+ * Records start on 8-byte boundaries. A length of zero, or the end of the
+ * file, ends a segment.
+ */
+struct JournalRecordHeader {
+    uint64_t sequence;              // Global, gap-free and increasing across segments
+    uint64_t timestamp;             // When the record was appended, ns since epoch
+    uint64_t session;               // Connection::client_id
+    uint16_t length;                // This header plus the frame
+    JournalEntry entry;
+    uint8_t reserved[5];
+};
+
+#pragma pack(pop)
+
+/**
+ * @brief Journal location, segment size and durability
+ */
+struct JournalConfig {
+    std::string directory;
+    size_t segment_bytes{64 << 20};         // Preallocated size of each segment file
+    JournalSync sync{JournalSync::NONE};
+    uint32_t sync_batch{256};               // Sync after this many records...
+    uint32_t sync_interval_us{1000};        // ...or once the oldest unsynced record is this old
+};
+
+/**
+ * @brief Read-only mapping of one journal segment
+ */
+class JournalReader {
+public:
+    JournalReader() = default;
+    ~JournalReader() { close(); }
+
+    JournalReader(const JournalReader&) = delete;
+    JournalReader& operator=(const JournalReader&) = delete;
+
+    JournalReader(JournalReader&& other) noexcept { swap(other); }
+
+    JournalReader& operator=(JournalReader&& other) noexcept {
+        JournalReader(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    /**
+     * @brief Segment files in directory, oldest first
+     */
+    static std::vector<std::string> segments(const std::string& directory);
+
+    /**
+     * @return false if path is not a readable segment
+     */
+    bool open(const std::string& path);
+    void close();
+
+    const JournalSegmentHeader& header() const { return header_; }
+
+    /**
+     * @brief Call fn(record, frame) for each complete record, oldest first
+     *
+     * Stops at the end of the written part of the segment, or at a torn
+     * record left by a crash.
+     * @return Number of records visited
+     */
+    template <typename Fn>
+    size_t for_each(Fn&& fn) const {
+        size_t count = 0;
+        size_t offset = header_.header_size;
+        while (offset + sizeof(JournalRecordHeader) <= size_) {
+            const auto& record = *reinterpret_cast<const JournalRecordHeader*>(data_ + offset);
+            if (record.length < sizeof(JournalRecordHeader) || offset + record.length > size_) {
+                break;
+            }
+            fn(record, data_ + offset + sizeof(JournalRecordHeader));
+            offset += (record.length + 7) & ~size_t(7);
+            ++count;
+        }
+        return count;
+    }
+
+private:
+    void swap(JournalReader& other) noexcept {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        std::swap(header_, other.header_);
+    }
+
+    const uint8_t* data_{nullptr};
+    size_t size_{0};
+    JournalSegmentHeader header_{};
+};
+
+/**
+ * @brief Append-only write-ahead journal (Singleton)
+ *
+ * Producers encode straight into a slot of a bounded multi-producer ring;
+ * claiming the slot assigns the record's sequence number, so records are
+ * written in the order they were claimed. Callers that append under the
+ * lock that orders their updates, as OrderService does under the engine
+ * lock, get a journal in exactly that order.
+ *
+ * A background thread copies records into preallocated, memory-mapped
+ * segment files named journal-NNNNNN.seg and syncs them in batches, so
+ * appending never makes a system call. When the ring is full producers
+ * wait for the writer rather than lose records.
+ */
+class Journal {
+public:
+    static Journal& get_instance();
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    /**
+     * @brief Start a new segment after any already in the directory and start the writer
+     *
+     * Sequence numbers continue from the last record found there. Call
+     * before the server starts.
+     * @return false if the directory or segment cannot be created
+     */
+    bool open(const JournalConfig& config);
+
+    /**
+     * @brief Write and sync everything appended so far, then stop the writer
+     */
+    void close();
+
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Append msg, encoded as a wire frame
+     * @return The record's sequence number
+     */
+    template <typename T>
+    uint64_t append(JournalEntry entry, uint64_t session, const T& msg) {
+        uint64_t position = claim();
+        Slot& slot = slots_[position & (RING_CAPACITY - 1)];
+        size_t length = wire::encode(msg, slot.frame);
+        return publish(slot, position, entry, session, length);
+    }
+
+    /**
+     * @brief Append a record without a frame
+     * @return The record's sequence number
+     */
+    uint64_t append(JournalEntry entry, uint64_t session) {
+        uint64_t position = claim();
+        return publish(slots_[position & (RING_CAPACITY - 1)], position, entry, session, 0);
+    }
+
+    /**
+     * @brief Block until every record appended so far is in the segment
+     */
+    void flush();
+
+    /** Last sequence number handed out */
+    uint64_t last_sequence() const {
+        return first_sequence_ + tail_.load(std::memory_order_acquire) - 1;
+    }
+
+    /** Last sequence number synced to disk, or written when not syncing */
+    uint64_t synced_sequence() const { return synced_sequence_.load(std::memory_order_acquire); }
+
+    /** Appends that found the ring full and waited for the writer */
+    uint64_t stalls() const { return stalls_.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr size_t RING_CAPACITY = 1 << 16;   // Power of two
+
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> turn;             // position when free, position + 1 when published
+        JournalRecordHeader header;
+        uint8_t frame[wire::MAX_FRAME_SIZE];
+    };
+
+    Journal() = default;
+    ~Journal();
+
+    uint64_t claim() {
+        uint64_t position = tail_.fetch_add(1, std::memory_order_relaxed);
+        Slot& slot = slots_[position & (RING_CAPACITY - 1)];
+        if (slot.turn.load(std::memory_order_acquire) != position) {
+            wait_for_slot(slot, position);
+        }
+        return position;
+    }
+
+    uint64_t publish(Slot& slot, uint64_t position, JournalEntry entry, uint64_t session, size_t length) {
+        slot.header.sequence = first_sequence_ + position;
+        slot.header.timestamp = Message::get_current_timestamp();
+        slot.header.session = session;
+        slot.header.length = static_cast<uint16_t>(sizeof(JournalRecordHeader) + length);
+        slot.header.entry = entry;
+        slot.turn.store(position + 1, std::memory_order_release);
+        return slot.header.sequence;
+    }
+
+    void wait_for_slot(Slot& slot, uint64_t position);
+    void writer_thread();
+    bool drain();
+    void write_record(const Slot& slot);
+    void maybe_sync(bool force);
+    bool open_segment();
+    void close_segment();
+
+    JournalConfig config_;
+    std::atomic<bool> enabled_{false};
+    std::atomic<bool> running_{false};
+    std::atomic<uint64_t> stalls_{0};
+
+    // Ring shared by all producers and the writer
+    std::unique_ptr<Slot[]> slots_;
+    uint64_t first_sequence_{1};                    // Sequence of ring position 0
+    alignas(64) std::atomic<uint64_t> tail_{0};     // Next position to claim
+    alignas(64) std::atomic<uint64_t> written_{0};  // Positions below this are in the segment
+    std::atomic<uint64_t> synced_sequence_{0};
+
+    // Writer thread state
+    uint64_t head_{0};                  // Next position to write
+    uint64_t segment_index_{0};
+    int fd_{-1};
+    uint8_t* map_{nullptr};
+    size_t offset_{0};                  // Next free byte in the segment
+    size_t synced_offset_{0};
+    uint64_t unsynced_records_{0};
+    std::chrono::steady_clock::time_point first_unsynced_;
+
+    std::thread writer_;
+};
+
+} // namespace hft
+
+#endif // JOURNAL_H
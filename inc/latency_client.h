@@ -1,7 +1,11 @@
 #ifndef LATENCY_CLIENT_H
 #define LATENCY_CLIENT_H
 
+#include "latency_correlator.h"
+#include "latency_histogram.h"
 #include "message.h"
+#include "receive_buffer.h"
+#include "wire_format.h"
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -38,6 +42,11 @@ public:
      */
     void disconnect();
     
+    /**
+     * @brief Busy-poll for responses instead of sleeping between reads
+     */
+    void set_spin_mode(bool enable) { spin_ = enable; }
+    
     /**
      * @brief Run latency test
      * @param num_messages Number of messages to send
@@ -66,6 +75,8 @@ public:
     struct TestStats {
         uint64_t total_messages_sent;
         uint64_t total_messages_received;
+        uint64_t round_trips;               // Responses matched to their request
+        uint64_t unmatched_responses;
         uint64_t total_latency_ns;
         uint64_t min_latency_ns;
         uint64_t max_latency_ns;
@@ -74,8 +85,10 @@ public:
         double p95_latency_us;
         double p99_latency_us;
         double p99_9_latency_us;
+        double avg_outbound_us;             // Send to server timestamp; needs synchronized clocks
+        double avg_inbound_us;              // Server timestamp to receipt
         uint64_t errors;
-        double throughput_mps;
+        double throughput_mps;              // Responses per second since the test started
     };
     
     TestStats get_stats() const;
@@ -83,11 +96,11 @@ public:
     void reset_stats();
 
 private:
-    void send_message(const Message& msg);
+    void send_message(const OrderMessage& msg);
     void receive_responses();
-    void update_latency_stats(uint64_t latency_ns);
+    void update_latency_stats(const LatencyStamp& sent, const LatencyStamp& received, uint64_t server_ns);
     void calculate_percentiles() const;
-    Message create_test_message();
+    OrderMessage create_test_message();
     void setup_socket_options(int sock_fd);
     void set_non_blocking(int sock_fd);
     
@@ -100,14 +113,20 @@ private:
     // Test data
     std::atomic<uint64_t> messages_sent_{0};
     std::atomic<uint64_t> messages_received_{0};
+    std::atomic<uint64_t> round_trips_{0};
+    std::atomic<uint64_t> unmatched_{0};
     std::atomic<uint64_t> total_latency_ns_{0};
     std::atomic<uint64_t> min_latency_ns_{UINT64_MAX};
     std::atomic<uint64_t> max_latency_ns_{0};
     std::atomic<uint64_t> errors_{0};
+    std::atomic<uint64_t> test_start_ns_{0};        // Clock::monotonic_ns() at reset_stats()
+    std::atomic<uint64_t> last_response_ns_{0};
     
-    // Latency measurements
-    std::vector<uint64_t> latency_measurements_;
-    mutable std::mutex latency_mutex_;
+    // Send times by message_id; the histograms are written by the receiver thread only
+    LatencyCorrelator requests_;
+    LatencyHistogram round_trip_histogram_;
+    LatencyHistogram outbound_histogram_;
+    LatencyHistogram inbound_histogram_;
     
     // Percentile calculations
     mutable double p50_latency_us{0.0};
@@ -118,6 +137,7 @@ private:
     // Threading
     std::thread receiver_thread_;
     std::atomic<bool> stop_receiver_{false};
+    std::atomic<bool> spin_{false};
     
     // Random number generation
     std::random_device rd_;
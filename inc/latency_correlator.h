@@ -0,0 +1,153 @@
+#ifndef LATENCY_CORRELATOR_H
+#define LATENCY_CORRELATOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+
+namespace hft {
+
+/**
+ * @brief One instant read from both clocks
+ */
+struct LatencyStamp {
+    uint64_t monotonic_ns{0};   // For round trips
+    uint64_t wall_ns{0};        // For legs measured against a server timestamp
+};
+
+/**
+ * @brief Send times of outstanding requests, looked up by id when the response arrives
+ *
+ * A preallocated open-addressed table: an id hashes to a home slot and may
+ * sit in any of the PROBE_LIMIT slots after it. Ids that never see a
+ * response are not leaked; once a window is full the home slot is reused,
+ * so the table behaves as a ring of the most recent requests. Any thread may
+ * record or look up: a slot's key is swapped to BUSY while its times are
+ * written, and a lookup re-checks the key, so it never returns a torn entry.
+ */
+class LatencyCorrelator {
+public:
+    static constexpr size_t PROBE_LIMIT = 8;
+
+    /**
+     * @param capacity Rounded up to a power of two; bounds the requests in flight
+     */
+    explicit LatencyCorrelator(size_t capacity = 65536)
+        : capacity_(round_up(capacity)), shift_(64 - __builtin_ctzll(capacity_)),
+          slots_(new Slot[capacity_]) {}
+
+    LatencyCorrelator(const LatencyCorrelator&) = delete;
+    LatencyCorrelator& operator=(const LatencyCorrelator&) = delete;
+
+    /**
+     * @brief Remember the stamp of id (ids 0 and UINT64_MAX are never tracked)
+     */
+    void record(uint64_t id, const LatencyStamp& stamp) {
+        if (id == EMPTY || id == BUSY) {
+            return;
+        }
+        size_t home = home_slot(id);
+        Slot* slot = nullptr;
+        for (size_t i = 0; i < PROBE_LIMIT && !slot; ++i) {
+            Slot& candidate = slots_[(home + i) & (capacity_ - 1)];
+            uint64_t key = EMPTY;
+            if (candidate.key.compare_exchange_strong(key, BUSY, std::memory_order_acquire)) {
+                slot = &candidate;
+            }
+        }
+        if (!slot) {
+            // Window full: reuse the home slot, dropping a request presumed unanswered
+            slot = &slots_[home];
+            uint64_t key = slot->key.load(std::memory_order_relaxed);
+            do {
+                if (key == BUSY) {
+                    return;
+                }
+            } while (!slot->key.compare_exchange_weak(key, BUSY, std::memory_order_acquire));
+            if (key != EMPTY) {
+                evicted_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        slot->monotonic_ns.store(stamp.monotonic_ns, std::memory_order_relaxed);
+        slot->wall_ns.store(stamp.wall_ns, std::memory_order_relaxed);
+        slot->key.store(id, std::memory_order_release);
+    }
+
+    /**
+     * @brief Stamp of id, removing it; false if unknown or evicted
+     */
+    bool take(uint64_t id, LatencyStamp& stamp) {
+        Slot* slot = read(id, stamp);
+        if (!slot) {
+            return false;
+        }
+        // Fails only if a recorder reclaimed the slot while it was being read
+        uint64_t key = id;
+        return slot->key.compare_exchange_strong(key, EMPTY, std::memory_order_release, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Stamp of id, leaving it in place for later lookups
+     */
+    bool find(uint64_t id, LatencyStamp& stamp) const {
+        Slot* slot = read(id, stamp);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot && slot->key.load(std::memory_order_relaxed) == id;
+    }
+
+    /**
+     * @brief Ids dropped unanswered to make room for newer ones
+     */
+    uint64_t evicted() const { return evicted_.load(std::memory_order_relaxed); }
+
+    size_t capacity() const { return capacity_; }
+
+private:
+    static constexpr uint64_t EMPTY = 0;
+    static constexpr uint64_t BUSY = UINT64_MAX;
+
+    struct Slot {
+        std::atomic<uint64_t> key{EMPTY};
+        std::atomic<uint64_t> monotonic_ns{0};
+        std::atomic<uint64_t> wall_ns{0};
+    };
+
+    static size_t round_up(size_t capacity) {
+        size_t size = PROBE_LIMIT;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    size_t home_slot(uint64_t id) const {
+        // Fibonacci hashing spreads sequential and generation-tagged ids alike
+        return static_cast<size_t>((id * 0x9E3779B97F4A7C15ULL) >> shift_);
+    }
+
+    Slot* read(uint64_t id, LatencyStamp& stamp) const {
+        if (id == EMPTY || id == BUSY) {
+            return nullptr;
+        }
+        size_t home = home_slot(id);
+        for (size_t i = 0; i < PROBE_LIMIT; ++i) {
+            Slot& slot = slots_[(home + i) & (capacity_ - 1)];
+            if (slot.key.load(std::memory_order_acquire) == id) {
+                stamp.monotonic_ns = slot.monotonic_ns.load(std::memory_order_relaxed);
+                stamp.wall_ns = slot.wall_ns.load(std::memory_order_relaxed);
+                return &slot;
+            }
+        }
+        return nullptr;
+    }
+
+    size_t capacity_;
+    unsigned shift_;
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<uint64_t> evicted_{0};
+};
+
+} // namespace hft
+
+#endif // LATENCY_CORRELATOR_H
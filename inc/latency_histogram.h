@@ -0,0 +1,166 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+namespace hft {
+
+/**
+ * @brief HDR-style log-linear latency histogram in nanoseconds
+ *
+ * Values are bucketed by power of two, with 32 linear sub-buckets per
+ * power, which bounds the relative error at about 3% from 32ns up to the
+ * 2^36ns (~68s) ceiling; smaller values are exact. Each histogram has a
+ * single writer: record() uses plain relaxed load/store pairs instead of
+ * locked read-modify-writes, and readers may merge at any time and see
+ * slightly stale but never torn counts.
+ */
+class LatencyHistogram {
+public:
+    static constexpr unsigned SUB_BUCKET_BITS = 5;
+    static constexpr uint64_t SUB_BUCKET_COUNT = 1ULL << SUB_BUCKET_BITS;
+    static constexpr unsigned MAX_VALUE_BITS = 36;
+    static constexpr uint64_t MAX_VALUE = (1ULL << MAX_VALUE_BITS) - 1;
+    static constexpr size_t BUCKET_COUNT =
+        (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+    /**
+     * @brief Bucket holding value (values above MAX_VALUE are clamped)
+     */
+    static size_t bucket_index(uint64_t value) {
+        if (value > MAX_VALUE) {
+            value = MAX_VALUE;
+        }
+        if (value < SUB_BUCKET_COUNT) {
+            return static_cast<size_t>(value);
+        }
+        unsigned shift = 63 - __builtin_clzll(value) - SUB_BUCKET_BITS;
+        return (shift + 1) * SUB_BUCKET_COUNT + ((value >> shift) - SUB_BUCKET_COUNT);
+    }
+
+    /**
+     * @brief Largest value that maps to a bucket
+     */
+    static uint64_t bucket_upper_bound(size_t index) {
+        if (index < SUB_BUCKET_COUNT) {
+            return index;
+        }
+        unsigned shift = static_cast<unsigned>(index / SUB_BUCKET_COUNT) - 1;
+        uint64_t sub = index % SUB_BUCKET_COUNT + SUB_BUCKET_COUNT;
+        return (sub << shift) + ((1ULL << shift) - 1);
+    }
+
+    /**
+     * @brief Record one sample; only the owning thread may call this
+     */
+    void record(uint64_t value) {
+        bump(counts_[bucket_index(value)], 1);
+        bump(count_, 1);
+        bump(sum_, value);
+        if (value > max_.load(std::memory_order_relaxed)) {
+            max_.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief Drop every sample; only the owning thread may call this
+     */
+    void reset() {
+        for (auto& c : counts_) {
+            c.store(0, std::memory_order_relaxed);
+        }
+        count_.store(0, std::memory_order_relaxed);
+        sum_.store(0, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+    uint64_t bucket(size_t index) const { return counts_[index].load(std::memory_order_relaxed); }
+
+private:
+    static void bump(std::atomic<uint64_t>& counter, uint64_t delta) {
+        counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> counts_{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+};
+
+/**
+ * @brief Plain-value sum of one or more histograms, used for reporting
+ */
+class HistogramSnapshot {
+public:
+    void merge(const LatencyHistogram& histogram) {
+        for (size_t i = 0; i < LatencyHistogram::BUCKET_COUNT; ++i) {
+            counts_[i] += histogram.bucket(i);
+        }
+        count_ += histogram.count();
+        sum_ += histogram.sum();
+        if (histogram.max() > max_) {
+            max_ = histogram.max();
+        }
+    }
+
+    void merge(const HistogramSnapshot& other) {
+        for (size_t i = 0; i < LatencyHistogram::BUCKET_COUNT; ++i) {
+            counts_[i] += other.counts_[i];
+        }
+        count_ += other.count_;
+        sum_ += other.sum_;
+        if (other.max_ > max_) {
+            max_ = other.max_;
+        }
+    }
+
+    /**
+     * @brief Value at or below which the given percentile of samples fall
+     * @param percentile In the range [0, 100]
+     */
+    uint64_t value_at_percentile(double percentile) const {
+        // Bucket counts are read one by one, so use their own total
+        uint64_t total = 0;
+        for (uint64_t c : counts_) {
+            total += c;
+        }
+        if (total == 0) {
+            return 0;
+        }
+
+        uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * static_cast<double>(total) + 0.5);
+        if (rank == 0) {
+            rank = 1;
+        }
+
+        uint64_t seen = 0;
+        for (size_t i = 0; i < LatencyHistogram::BUCKET_COUNT; ++i) {
+            seen += counts_[i];
+            if (seen >= rank) {
+                uint64_t value = LatencyHistogram::bucket_upper_bound(i);
+                return value < max_ ? value : max_;
+            }
+        }
+        return max_;
+    }
+
+    uint64_t count() const { return count_; }
+    uint64_t max() const { return max_; }
+    double mean() const { return count_ ? static_cast<double>(sum_) / count_ : 0.0; }
+
+private:
+    std::array<uint64_t, LatencyHistogram::BUCKET_COUNT> counts_{};
+    uint64_t count_{0};
+    uint64_t sum_{0};
+    uint64_t max_{0};
+};
+
+} // namespace hft
+
+#endif // LATENCY_HISTOGRAM_H
@@ -0,0 +1,311 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include "clock.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace hft {
+
+/**
+ * @brief Log severity, lowest first
+ */
+enum class LogLevel : uint8_t {
+    TRACE = 0,
+    DEBUG = 1,
+    INFO = 2,
+    WARN = 3,
+    ERROR = 4,
+    OFF = 5
+};
+
+/**
+ * @brief Wraps an errno value so strerror() runs on the logging thread
+ */
+struct LogErrno {
+    int value;
+};
+
+/**
+ * @brief One captured log argument
+ *
+ * Strings are copied inline and truncated to INLINE_STRING bytes, which
+ * fits symbols and IPv4 addresses.
+ */
+struct LogArg {
+    static constexpr size_t INLINE_STRING = 16;
+
+    enum class Type : uint8_t {
+        INT,
+        UINT,
+        DOUBLE,
+        STRING,
+        ERRNO
+    };
+
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+        int err;
+        char str[INLINE_STRING];
+    };
+};
+
+/**
+ * @brief Fixed-size binary log record; formatting is deferred to the writer
+ *
+ * The format string must be a string literal: only its pointer is stored.
+ * Placeholders are written as {} and consumed in order.
+ */
+struct alignas(64) LogRecord {
+    static constexpr size_t MAX_ARGS = 6;
+
+    uint64_t timestamp;                     // Wall clock, ns since epoch
+    const char* format;
+    LogLevel level;
+    uint8_t arg_count;
+    std::array<LogArg::Type, MAX_ARGS> types;
+    std::array<LogArg, MAX_ARGS> args;
+};
+
+/**
+ * @brief Single-producer single-consumer record ring owned by one thread
+ *
+ * The producer never blocks: when the ring is full the record is dropped
+ * and counted.
+ */
+class LogRing {
+public:
+    static constexpr size_t CAPACITY = 4096;  // Power of two
+
+    explicit LogRing(uint32_t id) : id_(id) {}
+
+    /**
+     * @brief Slot for the next record, or nullptr if the ring is full
+     */
+    LogRecord* claim() {
+        uint64_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_cache_ >= CAPACITY) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail - head_cache_ >= CAPACITY) {
+                dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+        }
+        return &records_[tail & (CAPACITY - 1)];
+    }
+
+    /**
+     * @brief Make the claimed record visible to the writer
+     */
+    void publish() {
+        tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /**
+     * @brief Consumer side: copy out pending records and free their slots
+     * @return Position up to which records were taken
+     */
+    uint64_t drain(std::vector<std::pair<uint32_t, LogRecord>>& out) {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        uint64_t tail = tail_.load(std::memory_order_acquire);
+        for (uint64_t i = head; i < tail; ++i) {
+            out.emplace_back(id_, records_[i & (CAPACITY - 1)]);
+        }
+        head_.store(tail, std::memory_order_release);
+        return tail;
+    }
+
+    /**
+     * @brief Consumer side: records up to position have reached the output
+     */
+    void mark_written(uint64_t position) {
+        written_.store(position, std::memory_order_release);
+    }
+
+    uint64_t published() const { return tail_.load(std::memory_order_acquire); }
+    uint64_t written() const { return written_.load(std::memory_order_acquire); }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+    uint32_t id() const { return id_; }
+
+    std::atomic<bool> in_use{true};         // Cleared when the owning thread exits
+
+private:
+    std::array<LogRecord, CAPACITY> records_;
+    uint32_t id_;
+    alignas(64) std::atomic<uint64_t> head_{0};     // Written by the writer thread
+    std::atomic<uint64_t> written_{0};
+    alignas(64) std::atomic<uint64_t> tail_{0};     // Written by the producer
+    uint64_t head_cache_{0};
+    std::atomic<uint64_t> dropped_{0};
+};
+
+/**
+ * @brief Asynchronous binary logger (Singleton)
+ *
+ * Callers capture a format pointer and raw arguments into their thread's
+ * LogRing; a background thread formats and writes them in timestamp
+ * order. Use the HFT_LOG_* macros so disabled levels cost one relaxed load
+ * and never evaluate their arguments.
+ */
+class Logger {
+public:
+    static Logger& get_instance();
+
+    // Delete copy constructor and assignment operator
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    bool enabled(LogLevel level) const {
+        return level >= level_.load(std::memory_order_relaxed);
+    }
+
+    void set_level(LogLevel level) {
+        level_.store(level, std::memory_order_relaxed);
+    }
+
+    LogLevel level() const {
+        return level_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Parse trace|debug|info|warn|error|off
+     * @return false if the name is unknown
+     */
+    static bool parse_level(const std::string& name, LogLevel& level);
+
+    /**
+     * @brief Capture a record into the calling thread's ring
+     */
+    template <typename... Args>
+    void log(LogLevel level, const char* format, const Args&... args) {
+        static_assert(sizeof...(Args) <= LogRecord::MAX_ARGS, "Too many log arguments");
+
+        LogRing* ring = thread_ring();
+        LogRecord* record = ring ? ring->claim() : nullptr;
+        if (!record) {
+            return;
+        }
+
+        record->timestamp = Clock::now_ns();
+        record->format = format;
+        record->level = level;
+        record->arg_count = static_cast<uint8_t>(sizeof...(Args));
+        size_t index = 0;
+        (capture(*record, index++, args), ...);
+        (void)index;
+
+        ring->publish();
+    }
+
+    /**
+     * @brief Block until every record published so far has been written
+     */
+    void flush();
+
+private:
+    Logger();
+    ~Logger();
+
+    LogRing* thread_ring();
+    LogRing* acquire_ring();
+    void writer_thread();
+    bool drain();
+    void format_record(uint32_t ring_id, const LogRecord& record);
+    void format_timestamp(uint64_t timestamp);
+
+    template <typename T>
+    static void capture(LogRecord& record, size_t index, const T& value) {
+        LogArg& arg = record.args[index];
+        if constexpr (std::is_enum<T>::value) {
+            capture(record, index, static_cast<std::underlying_type_t<T>>(value));
+        } else if constexpr (std::is_floating_point<T>::value) {
+            record.types[index] = LogArg::Type::DOUBLE;
+            arg.d = static_cast<double>(value);
+        } else if constexpr (std::is_integral<T>::value && std::is_signed<T>::value) {
+            record.types[index] = LogArg::Type::INT;
+            arg.i = static_cast<int64_t>(value);
+        } else if constexpr (std::is_integral<T>::value) {
+            record.types[index] = LogArg::Type::UINT;
+            arg.u = static_cast<uint64_t>(value);
+        } else {
+            capture_string(record, index, value);
+        }
+    }
+
+    static void capture_string(LogRecord& record, size_t index, const char* value) {
+        record.types[index] = LogArg::Type::STRING;
+        strncpy(record.args[index].str, value ? value : "(null)", LogArg::INLINE_STRING);
+    }
+
+    template <size_t N>
+    static void capture_string(LogRecord& record, size_t index, const std::array<char, N>& value) {
+        record.types[index] = LogArg::Type::STRING;
+        strncpy(record.args[index].str, value.data(), std::min(N, LogArg::INLINE_STRING));
+        if (N < LogArg::INLINE_STRING) {
+            record.args[index].str[N] = '\0';
+        }
+    }
+
+    static void capture_string(LogRecord& record, size_t index, const std::string& value) {
+        capture_string(record, index, value.c_str());
+    }
+
+    static void capture_string(LogRecord& record, size_t index, LogErrno value) {
+        record.types[index] = LogArg::Type::ERRNO;
+        record.args[index].err = value.value;
+    }
+
+    static constexpr size_t MAX_RINGS = 256;
+
+    std::atomic<LogLevel> level_{LogLevel::INFO};
+    std::atomic<bool> running_{true};
+
+    // Rings are never freed while the logger lives; exited threads' rings are reused
+    std::array<std::unique_ptr<LogRing>, MAX_RINGS> rings_;
+    std::atomic<size_t> ring_count_{0};
+    std::mutex rings_mutex_;                // Serializes ring registration only
+
+    // Writer thread state
+    std::vector<std::pair<uint32_t, LogRecord>> pending_;
+    std::vector<std::pair<uint64_t, uint32_t>> order_;  // (timestamp, index into pending_)
+    std::array<uint64_t, MAX_RINGS> drained_{};
+    std::array<uint64_t, MAX_RINGS> reported_drops_{};
+    std::string output_buffer_;
+    uint64_t cached_second_{0};
+    char cached_time_[32]{};
+    FILE* output_{stdout};
+
+    std::thread writer_;                    // Started last, after its state exists
+};
+
+} // namespace hft
+
+#define HFT_LOG(level, ...)                                                 \
+    do {                                                                    \
+        if (::hft::Logger::get_instance().enabled(level)) {                 \
+            ::hft::Logger::get_instance().log(level, __VA_ARGS__);          \
+        }                                                                   \
+    } while (0)
+
+#define HFT_LOG_TRACE(...) HFT_LOG(::hft::LogLevel::TRACE, __VA_ARGS__)
+#define HFT_LOG_DEBUG(...) HFT_LOG(::hft::LogLevel::DEBUG, __VA_ARGS__)
+#define HFT_LOG_INFO(...)  HFT_LOG(::hft::LogLevel::INFO, __VA_ARGS__)
+#define HFT_LOG_WARN(...)  HFT_LOG(::hft::LogLevel::WARN, __VA_ARGS__)
+#define HFT_LOG_ERROR(...) HFT_LOG(::hft::LogLevel::ERROR, __VA_ARGS__)
+
+#endif // LOGGER_H
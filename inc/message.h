@@ -1,6 +1,8 @@
 #ifndef MESSAGE_H
 #define MESSAGE_H
 
+#include "clock.h"
+
 #include <cstdint>
 #include <string>
 #include <chrono>
@@ -21,9 +23,20 @@ enum class MessageType : uint8_t {
     HEARTBEAT = 0x07,
     LOGIN = 0x08,
     LOGOUT = 0x09,
+    MARKET_DATA_SUBSCRIBE = 0x0A,
+    MARKET_DATA_UNSUBSCRIBE = 0x0B,
+    MARKET_DATA_RETRANSMIT = 0x0C,     // Multicast feed gap fill
+    MARKET_DATA_SNAPSHOT = 0x0D,       // Multicast feed state, for late joiners
     ERROR = 0xFF
 };
 
+/**
+ * @brief Dense instrument identifier assigned by the InstrumentRegistry
+ */
+using InstrumentId = uint16_t;
+
+constexpr InstrumentId INVALID_INSTRUMENT = 0xFFFF;   // Unknown; resolve by symbol
+
 /**
  * @brief Order side (buy/sell)
  */
@@ -75,16 +88,13 @@ struct Message {
     uint32_t source_id;            // Source system identifier
     uint32_t destination_id;       // Destination system identifier
     
-    // Payload size and data
-    uint32_t payload_size;         // Size of payload in bytes
-    std::array<uint8_t, 1024> payload; // Fixed-size payload buffer
+    // Typed fields live in the derived structs; see wire_format.h for encoding
+    uint32_t payload_size;         // Size of the typed body on the wire in bytes
     
     // Constructor
     Message() : message_id(0), timestamp(0), sequence_number(0), 
                 message_type(MessageType::HEARTBEAT), status(MessageStatus::PENDING),
-                source_id(0), destination_id(0), payload_size(0) {
-        payload.fill(0);
-    }
+                source_id(0), destination_id(0), payload_size(0) {}
     
     // Copy constructor
     Message(const Message& other) = default;
@@ -99,9 +109,7 @@ struct Message {
      * @brief Get current timestamp in nanoseconds
      */
     static uint64_t get_current_timestamp() {
-        auto now = std::chrono::high_resolution_clock::now();
-        auto duration = now.time_since_epoch();
-        return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+        return Clock::now_ns();
     }
     
     /**
@@ -115,7 +123,7 @@ struct Message {
      * @brief Check if message is valid
      */
     bool is_valid() const {
-        return message_id != 0 && timestamp != 0 && payload_size <= payload.size();
+        return message_id != 0 && timestamp != 0;
     }
     
     /**
@@ -130,7 +138,6 @@ struct Message {
         source_id = 0;
         destination_id = 0;
         payload_size = 0;
-        payload.fill(0);
     }
 };
 
@@ -148,10 +155,11 @@ struct OrderMessage : public Message {
     uint32_t quantity;                 // Order quantity
     uint64_t price;                    // Order price (in ticks)
     uint64_t stop_price;               // Stop price for stop orders
+    InstrumentId instrument_id;        // Takes precedence over symbol when valid
     
     OrderMessage() : side(OrderSide::BUY), order_type(OrderType::LIMIT),
                     time_in_force(TimeInForce::DAY), order_id(0), client_order_id(0),
-                    quantity(0), price(0), stop_price(0) {
+                    quantity(0), price(0), stop_price(0), instrument_id(INVALID_INSTRUMENT) {
         message_type = MessageType::ORDER_NEW;
         symbol.fill('\0');
     }
@@ -172,14 +180,34 @@ struct MarketDataMessage : public Message {
     uint64_t volume;                  // Total volume
     uint64_t high_price;              // High price
     uint64_t low_price;                // Low price
+    InstrumentId instrument_id;        // Takes precedence over symbol when valid
     
     MarketDataMessage() : bid_price(0), bid_size(0), ask_price(0), ask_size(0),
-                          last_price(0), last_size(0), volume(0), high_price(0), low_price(0) {
+                          last_price(0), last_size(0), volume(0), high_price(0), low_price(0),
+                          instrument_id(INVALID_INSTRUMENT) {
         message_type = MessageType::MARKET_DATA;
         symbol.fill('\0');
     }
 };
 
+/**
+ * @brief Multicast feed recovery request and reply
+ *
+ * A MARKET_DATA_RETRANSMIT request asks for the count frames from feed
+ * sequence first_sequence on; a MARKET_DATA_SNAPSHOT request carries no range.
+ * The reply comes after the frames it covers, with count the number sent:
+ * for a retransmission first_sequence is the feed sequence of the first of
+ * them, for a snapshot the last feed sequence the snapshot includes.
+ */
+struct RetransmitMessage : public Message {
+    uint64_t first_sequence;          // Feed sequence
+    uint32_t count;                   // Frames
+    
+    RetransmitMessage() : first_sequence(0), count(0) {
+        message_type = MessageType::MARKET_DATA_RETRANSMIT;
+    }
+};
+
 /**
  * @brief Fill message structure
  */
@@ -0,0 +1,164 @@
+#ifndef MULTICAST_FEED_H
+#define MULTICAST_FEED_H
+
+#include "message.h"
+#include "outbound_queue.h"
+#include "wire_format.h"
+
+#include <netinet/in.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace hft {
+
+/**
+ * @brief Multicast group, interface and publisher limits of the market data feed
+ *
+ * The defaults keep the feed on the loopback interface, for a publisher
+ * and receivers on one host.
+ */
+struct MulticastConfig {
+    std::string group = "239.255.0.1";
+    uint16_t port = 30001;
+    std::string interface = "127.0.0.1";   // Local address of the interface to send and join on
+    int ttl = 1;                            // Router hops; 1 stays on the subnet
+    bool loopback = true;                   // Deliver to receivers on the publishing host
+    size_t retransmit_frames = 65536;       // History kept for gap fill, rounded up to a power of two
+    uint32_t heartbeat_ms = 1000;           // Heartbeat while no frame is published, 0 for none
+};
+
+/**
+ * @brief Publishing side of the multicast market data feed
+ *
+ * Sends every frame in its own datagram under the next feed sequence and
+ * keeps the most recent ones, and each instrument's latest, by reference so
+ * a TCP session can fill a receiver's gap or bring a late joiner up to
+ * date. Publishing is serialized so datagrams leave in sequence order.
+ */
+class MulticastPublisher {
+public:
+    MulticastPublisher() = default;
+    ~MulticastPublisher() { close(); }
+
+    MulticastPublisher(const MulticastPublisher&) = delete;
+    MulticastPublisher& operator=(const MulticastPublisher&) = delete;
+
+    /**
+     * @brief Create the socket and start a new session at sequence 1
+     * @return false with the reason on stderr
+     */
+    bool open(const MulticastConfig& config);
+
+    /**
+     * @brief Stop heartbeats, close the socket and drop the history
+     */
+    void close();
+
+    bool enabled() const { return fd_ != -1; }
+
+    /**
+     * @brief Send a frame under the next sequence and keep a reference to it
+     */
+    void publish(InstrumentId instrument, SharedFrame* frame);
+
+    /**
+     * @brief Retained frames from sequence first on, at most count
+     *
+     * Each frame in out carries a reference for the caller.
+     * @return false if first is older than the history, which then starts at oldest
+     */
+    bool retransmit(uint64_t first, uint32_t count, std::vector<SharedFrame*>& out, uint64_t& oldest);
+
+    /**
+     * @brief Latest frame of every instrument published so far
+     *
+     * Each frame in out carries a reference for the caller.
+     * @return Last sequence the snapshot includes
+     */
+    uint64_t snapshot(std::vector<SharedFrame*>& out);
+
+    uint64_t session() const { return session_; }
+    uint64_t frames_published() const { return published_.load(std::memory_order_relaxed); }
+    uint64_t send_errors() const { return send_errors_.load(std::memory_order_relaxed); }
+
+private:
+    void send_locked(SharedFrame* frame);
+    void heartbeat_thread_func();
+
+    int fd_{-1};
+    sockaddr_in group_{};
+    uint64_t session_{0};
+    uint32_t heartbeat_ms_{0};
+
+    std::mutex mutex_;                          // Guards everything below
+    uint64_t next_sequence_{1};
+    std::vector<SharedFrame*> history_;         // By sequence & history_mask_
+    uint64_t history_mask_{0};
+    std::vector<SharedFrame*> latest_;          // By instrument id
+    std::chrono::steady_clock::time_point last_send_;
+
+    std::atomic<uint64_t> published_{0};
+    std::atomic<uint64_t> send_errors_{0};
+
+    bool stopping_{false};
+    std::condition_variable heartbeat_cv_;
+    std::thread heartbeat_thread_;
+};
+
+/**
+ * @brief Multicast group membership and datagram reads for a feed receiver
+ */
+class MulticastReceiver {
+public:
+    static constexpr size_t MAX_DATAGRAM = 65536;
+
+    MulticastReceiver() = default;
+    ~MulticastReceiver() { close(); }
+
+    MulticastReceiver(const MulticastReceiver&) = delete;
+    MulticastReceiver& operator=(const MulticastReceiver&) = delete;
+
+    /**
+     * @brief Bind the feed port and join the group on the configured interface
+     * @return false with the reason on stderr
+     */
+    bool open(const MulticastConfig& config);
+
+    void close();
+
+    /**
+     * @brief Wait up to timeout_ms for a datagram
+     * @return Its length, 0 on timeout, -1 on error
+     */
+    ssize_t receive(uint8_t* buffer, size_t size, int timeout_ms);
+
+private:
+    int fd_{-1};
+};
+
+/**
+ * @brief Split a datagram into its header and the frames that follow
+ * @return false if it is too short to be a feed packet
+ */
+inline bool parse_feed_packet(const uint8_t* data, size_t length, wire::WireFeedHeader& header,
+                              const uint8_t*& frames, size_t& frames_length) {
+    if (length < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    frames = data + sizeof(header);
+    frames_length = length - sizeof(header);
+    return true;
+}
+
+} // namespace hft
+
+#endif // MULTICAST_FEED_H
@@ -0,0 +1,320 @@
+#ifndef ORDER_BOOK_H
+#define ORDER_BOOK_H
+
+#include "message.h"
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace hft {
+
+struct Connection;
+class OrderBook;
+
+/**
+ * @brief Resting order, linked into its price level's FIFO queue
+ *
+ * Nodes live in a preallocated OrderPool and are linked by pool index, so
+ * adding, filling and removing orders never touches the heap. A resting
+ * node is also on its owner's list, so a disconnect visits only its orders.
+ * The generation is bumped each time the node is reused.
+ */
+struct OrderNode {
+    static constexpr uint32_t NIL = UINT32_MAX;
+
+    uint64_t order_id{0};
+    uint64_t client_order_id{0};
+    Connection* owner{nullptr};
+    OrderBook* book{nullptr};
+    uint64_t price{0};
+    uint32_t remaining{0};
+    uint32_t prev{NIL};
+    uint32_t next{NIL};
+    uint32_t owner_prev{NIL};
+    uint32_t owner_next{NIL};
+    uint32_t generation{0};
+    OrderSide side{OrderSide::BUY};
+    bool active{false};
+    bool owner_listed{false};   // On its owner's list; only resting orders are
+};
+
+/**
+ * @brief Fixed-capacity free list of order nodes
+ *
+ * Server order ids are direct-mapped onto the pool: the low 32 bits hold
+ * the node index and the high 32 bits its generation, so resolving an id
+ * is one bounds check and one compare, and ids of reused nodes go stale.
+ * The pool also keeps the head of each owner's list of resting nodes; a
+ * released node leaves its owner's list.
+ */
+class OrderPool {
+public:
+    explicit OrderPool(size_t capacity);
+
+    uint32_t allocate();
+    void release(uint32_t index);
+
+    /**
+     * @brief Add a node that is starting to rest to its owner's list
+     */
+    void link_owner(uint32_t index);
+
+    /**
+     * @brief First resting node of an owner, or NIL
+     */
+    uint32_t first_of(const Connection* owner) const {
+        auto it = owner_heads_.find(owner);
+        return it == owner_heads_.end() ? OrderNode::NIL : it->second;
+    }
+
+    /**
+     * @brief Forget an owner whose list is empty
+     */
+    void forget_owner(const Connection* owner) { owner_heads_.erase(owner); }
+
+    /**
+     * @brief Allocate the nodes of recovered order ids in an unused pool
+     * @return Node index per id, NIL for an id that is out of range or repeated
+     */
+    std::vector<uint32_t> restore(const std::vector<uint64_t>& order_ids);
+
+    /**
+     * @brief Server order id of an allocated node
+     */
+    uint64_t order_id(uint32_t index) const {
+        return (static_cast<uint64_t>(nodes_[index].generation) << 32) | index;
+    }
+
+    /**
+     * @brief Node index for a live order id, or NIL if unknown or stale
+     */
+    uint32_t find(uint64_t order_id) const {
+        uint32_t index = static_cast<uint32_t>(order_id);
+        if (index >= nodes_.size()) {
+            return OrderNode::NIL;
+        }
+        const OrderNode& node = nodes_[index];
+        if (!node.active || node.generation != static_cast<uint32_t>(order_id >> 32)) {
+            return OrderNode::NIL;
+        }
+        return index;
+    }
+
+    OrderNode& operator[](uint32_t index) { return nodes_[index]; }
+    const OrderNode& operator[](uint32_t index) const { return nodes_[index]; }
+
+    size_t capacity() const { return nodes_.size(); }
+
+private:
+    void unlink_owner(OrderNode& node);
+
+    std::vector<OrderNode> nodes_;
+    uint32_t free_head_;
+    std::unordered_map<const Connection*, uint32_t> owner_heads_;  // Kept until the owner is forgotten
+};
+
+/**
+ * @brief One execution between a resting (maker) and incoming (taker) order
+ */
+struct Trade {
+    uint64_t maker_order_id;
+    uint64_t maker_client_order_id;
+    Connection* maker_owner;
+    uint64_t taker_order_id;
+    uint64_t taker_client_order_id;
+    Connection* taker_owner;
+    uint64_t price;
+    uint32_t quantity;
+    OrderSide taker_side;
+};
+
+/**
+ * @brief Receives trades synchronously while an order is matched
+ */
+class TradeSink {
+public:
+    virtual ~TradeSink() = default;
+    virtual void on_trade(const Trade& trade) = 0;
+};
+
+/**
+ * @brief Resting order put back on its book by recovery
+ */
+struct RestingOrder {
+    uint64_t order_id;
+    uint64_t client_order_id;
+    Connection* owner;
+    uint64_t price;
+    uint32_t remaining;
+    InstrumentId instrument;
+    OrderSide side;
+};
+
+/**
+ * @brief Outcome of submitting an order
+ */
+enum class MatchStatus : uint8_t {
+    RESTING = 0x01,     // Remainder rests on the book
+    FILLED = 0x02,      // Fully executed
+    CANCELLED = 0x03,   // IOC/MARKET remainder or FOK that could not fill
+    REJECTED = 0x04,    // Unknown instrument, unsupported type, price outside the band or pool full
+    NOT_FOUND = 0x05    // Cancel/replace of an unknown or foreign order
+};
+
+struct MatchResult {
+    uint64_t order_id{0};
+    uint32_t filled_quantity{0};
+    uint32_t remaining_quantity{0};
+    MatchStatus status{MatchStatus::REJECTED};
+};
+
+/**
+ * @brief Price-time priority limit order book for one symbol
+ *
+ * Each side is an array of price levels indexed by (price - base_price), so
+ * locating a level is a subtraction and a page lookup. Levels are allocated
+ * a page at a time when an order first rests there, so a book only costs
+ * memory around the prices it trades at. Best bid/ask are tracked as indices
+ * and advanced by scanning when a level empties, skipping absent pages.
+ */
+class OrderBook {
+public:
+    OrderBook(OrderPool& pool, uint64_t base_price, size_t price_levels);
+
+    /**
+     * @brief Match an incoming order and rest any eligible remainder
+     *
+     * A node is taken from the pool up front so the order has a server id
+     * while matching; it is returned unless the order rests.
+     */
+    MatchResult submit(const OrderMessage& order, Connection* owner, TradeSink& sink);
+
+    /**
+     * @brief Queue an allocated, filled-in node behind its price level
+     */
+    void restore(uint32_t index) {
+        rest(index, static_cast<size_t>(pool_[index].price - base_price_));
+    }
+
+    /**
+     * @brief Reduce a resting order's open quantity in place, keeping priority
+     */
+    void reduce(uint32_t index, uint32_t quantity);
+
+    /**
+     * @brief Remove a resting order from its level (node stays allocated)
+     */
+    void unlink(uint32_t index);
+
+    bool in_band(uint64_t price) const {
+        return price >= base_price_ && price - base_price_ < price_levels_;
+    }
+
+    uint64_t best_bid() const;
+    uint64_t best_ask() const;
+
+    static constexpr size_t NO_LEVEL = SIZE_MAX;
+
+private:
+    struct PriceLevel {
+        uint32_t head{OrderNode::NIL};
+        uint32_t tail{OrderNode::NIL};
+        uint64_t quantity{0};
+    };
+
+    static constexpr size_t PAGE_LEVELS = 256;      // Power of two
+
+    // One side's levels, in pages that stay null until an order rests in them
+    using Levels = std::vector<std::unique_ptr<PriceLevel[]>>;
+
+    // A level that holds or held an order; its page exists
+    static PriceLevel& level_at(Levels& levels, size_t index) {
+        return levels[index / PAGE_LEVELS][index % PAGE_LEVELS];
+    }
+
+    static const PriceLevel* find_level(const Levels& levels, size_t index) {
+        const PriceLevel* page = levels[index / PAGE_LEVELS].get();
+        return page ? &page[index % PAGE_LEVELS] : nullptr;
+    }
+
+    uint32_t match(OrderSide side, uint64_t limit_level, bool is_market,
+                   uint32_t quantity, uint64_t taker_id, uint64_t taker_client_id,
+                   Connection* taker, TradeSink& sink);
+    uint64_t available(OrderSide side, uint64_t limit_level, bool is_market,
+                       uint32_t wanted) const;
+    void rest(uint32_t index, size_t level);
+    void refresh_best_bid();
+    void refresh_best_ask();
+
+    OrderPool& pool_;
+    uint64_t base_price_;
+    size_t price_levels_;
+    Levels bids_;
+    Levels asks_;
+    size_t best_bid_{NO_LEVEL};
+    size_t best_ask_{NO_LEVEL};
+};
+
+/**
+ * @brief Per-instrument order books sharing one order pool
+ *
+ * Books are indexed by instrument id, so orders must carry a resolved
+ * instrument_id (see InstrumentRegistry::resolve); others are rejected.
+ * Not thread-safe; callers serialize access.
+ */
+class MatchingEngine {
+public:
+    struct Config {
+        uint64_t base_price = 0;          // Lowest tradable price in ticks
+        size_t price_levels = 1 << 18;    // Ticks covered by each book; allocated as used
+        size_t max_orders = 1 << 18;      // Resting order capacity
+    };
+
+    MatchingEngine();
+    explicit MatchingEngine(const Config& config);
+
+    MatchResult submit(const OrderMessage& order, Connection* owner, TradeSink& sink);
+
+    /**
+     * @brief Cancel a resting order by server order id in constant time
+     */
+    MatchResult cancel(uint64_t order_id, const Connection* owner);
+
+    /**
+     * @brief Change price and/or open quantity of a resting order
+     *
+     * A pure quantity reduction keeps time priority; anything else cancels
+     * and resubmits, which may trade and yields a new order id.
+     */
+    MatchResult replace(uint64_t order_id, uint32_t quantity, uint64_t price,
+                        Connection* owner, TradeSink& sink);
+
+    /**
+     * @brief Drop every resting order of a connection (cancel on disconnect)
+     */
+    size_t remove_owner(const Connection* owner);
+
+    /**
+     * @brief Put recovered orders back under their original ids
+     *
+     * Call on an engine that has not taken any order yet, with orders in
+     * time priority. Orders outside the price band or the pool are skipped.
+     * @return Number of orders restored
+     */
+    size_t restore(const std::vector<RestingOrder>& orders);
+
+private:
+    OrderBook& book_for(InstrumentId instrument);
+
+    Config config_;
+    OrderPool pool_;
+    std::vector<std::unique_ptr<OrderBook>> books_;     // Indexed by instrument id
+};
+
+} // namespace hft
+
+#endif // ORDER_BOOK_H
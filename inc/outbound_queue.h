@@ -0,0 +1,319 @@
+#ifndef OUTBOUND_QUEUE_H
+#define OUTBOUND_QUEUE_H
+
+#include "wire_format.h"
+
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace hft {
+
+/**
+ * @brief What to do with a frame that does not fit a client's outbound queue
+ *
+ * DROP and CONFLATE only ever discard market data. Acks and fills are never
+ * dropped: a client that cannot keep up with its own order flow is always
+ * disconnected.
+ */
+enum class SlowConsumerPolicy : uint8_t {
+    DISCONNECT = 0,     // Shut the connection down
+    CONFLATE = 1,       // Overwrite a queued update for the same symbol, else drop
+    DROP = 2            // Discard the new update
+};
+
+/**
+ * @brief Reference-counted encoded frame queued on many connections at once
+ *
+ * Encoded once by the publisher; every holder releases its reference after
+ * the frame reaches its socket, and the last one frees it.
+ */
+class SharedFrame {
+public:
+    /**
+     * @brief Encode msg into a new frame owned by refs holders
+     */
+    template <typename T>
+    static SharedFrame* create(const T& msg, uint32_t refs) {
+        auto* frame = new SharedFrame(refs);
+        frame->length_ = static_cast<uint16_t>(wire::encode(msg, frame->data_));
+        return frame;
+    }
+
+    SharedFrame(const SharedFrame&) = delete;
+    SharedFrame& operator=(const SharedFrame&) = delete;
+
+    const uint8_t* data() const { return data_; }
+    size_t length() const { return length_; }
+
+    void retain() {
+        refs_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void release() {
+        if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+private:
+    explicit SharedFrame(uint32_t refs) : refs_(refs) {}
+
+    std::atomic<uint32_t> refs_;
+    uint16_t length_{0};
+    uint8_t data_[wire::MAX_FRAME_SIZE];
+};
+
+/**
+ * @brief Bounded per-connection queue of encoded frames awaiting the socket
+ *
+ * A ring of frame references: frames private to the connection are copied
+ * into an owned arena, shared frames are referenced in place, so fan-out
+ * costs one pointer per subscriber rather than one copy. gather() describes
+ * the queue as iovecs for a single writev()/sendmsg(), merging adjacent
+ * arena frames; complete() releases what reached the socket and keeps the
+ * offset into a partly written frame.
+ */
+class OutboundQueue {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 64 * 1024;
+    static constexpr int MAX_IOVECS = 64;
+
+    explicit OutboundQueue(size_t capacity = DEFAULT_CAPACITY)
+        : arena_(round_up(capacity)), arena_mask_(arena_.size() - 1),
+          segments_(round_up(arena_.size() / wire::HEADER_SIZE)), segment_mask_(segments_.size() - 1) {}
+
+    ~OutboundQueue() {
+        while (head_ != tail_) {
+            pop_front();
+        }
+    }
+
+    OutboundQueue(const OutboundQueue&) = delete;
+    OutboundQueue& operator=(const OutboundQueue&) = delete;
+
+    OutboundQueue(OutboundQueue&& other) noexcept { swap(other); }
+
+    OutboundQueue& operator=(OutboundQueue&& other) noexcept {
+        OutboundQueue(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    /** Position of a frame that can never be queued */
+    static constexpr uint64_t NO_POSITION = ~uint64_t(0);
+
+    bool empty() const { return head_ == tail_; }
+    size_t size() const { return bytes_; }
+    size_t capacity() const { return arena_.size(); }
+
+    /**
+     * @brief Position of the most recently pushed frame, for replace()
+     */
+    uint64_t back_position() const { return tail_ - 1; }
+
+    /**
+     * @brief Copy one frame into the queue
+     * @return false, leaving the queue untouched, if it does not fit
+     */
+    bool push(const uint8_t* frame, size_t length) {
+        if (!has_room(length)) {
+            return false;
+        }
+
+        // Frames never wrap in the arena, so each is one contiguous iovec
+        uint64_t start = arena_tail_;
+        size_t offset = static_cast<size_t>(start & arena_mask_);
+        if (offset + length > arena_.size()) {
+            start += arena_.size() - offset;
+            offset = 0;
+        }
+        if (start + length - arena_head_ > arena_.size()) {
+            return false;
+        }
+        std::memcpy(arena_.data() + offset, frame, length);
+        arena_tail_ = start + length;
+
+        append({arena_.data() + offset, nullptr, static_cast<uint32_t>(length), arena_tail_});
+        return true;
+    }
+
+    /**
+     * @brief Queue a reference to a shared frame
+     * @return true if the queue took over the caller's reference
+     */
+    bool push(SharedFrame* frame) {
+        if (!has_room(frame->length())) {
+            return false;
+        }
+        append({frame->data(), frame, static_cast<uint32_t>(frame->length()), 0});
+        return true;
+    }
+
+    /**
+     * @brief Describe queued bytes from the head as at most max iovecs
+     * @return Number of iovecs filled
+     */
+    int gather(iovec* iov, int max) const {
+        int count = 0;
+        for (uint64_t i = head_; i != tail_ && count < max; ++i) {
+            const Segment& segment = segments_[i & segment_mask_];
+            const uint8_t* data = segment.data;
+            size_t length = segment.length;
+            if (i == head_) {
+                data += sent_;
+                length -= sent_;
+            }
+            if (count > 0 && static_cast<uint8_t*>(iov[count - 1].iov_base) + iov[count - 1].iov_len == data) {
+                iov[count - 1].iov_len += length;
+                continue;
+            }
+            iov[count++] = {const_cast<uint8_t*>(data), length};
+        }
+        return count;
+    }
+
+    /**
+     * @brief Release bytes written to the socket
+     */
+    void complete(size_t bytes) {
+        bytes_ -= bytes;
+        while (bytes > 0) {
+            size_t left = segments_[head_ & segment_mask_].length - sent_;
+            if (bytes < left) {
+                sent_ += bytes;
+                return;
+            }
+            bytes -= left;
+            pop_front();
+        }
+    }
+
+    /**
+     * @brief Freeze the frames queued so far while an asynchronous send reads them
+     *
+     * replace() and conflate() leave pinned frames alone; complete() and
+     * push() never move queued bytes, so the iovecs from gather() stay valid.
+     */
+    void pin() { pinned_ = tail_; }
+
+    void unpin() { pinned_ = 0; }
+
+    /**
+     * @brief Swap the shared frame at position for frame if none of it is written yet
+     * @return true if the queue took over the caller's reference
+     */
+    bool replace(uint64_t position, SharedFrame* frame) {
+        uint64_t first = std::max(sent_ > 0 ? head_ + 1 : head_, pinned_);
+        if (position < first || position >= tail_) {
+            return false;
+        }
+        Segment& segment = segments_[position & segment_mask_];
+        if (!segment.shared || segment.length != frame->length()) {
+            return false;
+        }
+        segment.shared->release();
+        segment.shared = frame;
+        segment.data = frame->data();
+        return true;
+    }
+
+    /**
+     * @brief Replace a queued, unsent shared update for frame's symbol
+     * @return true if the queue took over the caller's reference
+     */
+    bool conflate(SharedFrame* frame) {
+        const uint8_t* data = frame->data();
+        if (wire::peek_type(data) != MessageType::MARKET_DATA) {
+            return false;
+        }
+
+        // The head may be partly written; only later frames can change
+        for (uint64_t i = std::max(sent_ > 0 ? head_ + 1 : head_, pinned_); i < tail_; ++i) {
+            Segment& segment = segments_[i & segment_mask_];
+            if (segment.shared && segment.length == frame->length() &&
+                wire::peek_type(segment.data) == MessageType::MARKET_DATA &&
+                std::memcmp(segment.data + wire::HEADER_SIZE, data + wire::HEADER_SIZE, SYMBOL_SIZE) == 0) {
+                segment.shared->release();
+                segment.shared = frame;
+                segment.data = data;
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    static constexpr size_t SYMBOL_SIZE = sizeof(wire::WireMarketData::symbol);
+
+    struct Segment {
+        const uint8_t* data;
+        SharedFrame* shared;        // Reference held by this queue, or nullptr for arena frames
+        uint32_t length;
+        uint64_t arena_end;         // Arena position after this frame, for arena frames
+    };
+
+    static size_t round_up(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity || size < wire::MAX_FRAME_SIZE) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    bool has_room(size_t length) const {
+        return bytes_ + length <= capacity() && tail_ - head_ < segments_.size();
+    }
+
+    void append(const Segment& segment) {
+        segments_[tail_ & segment_mask_] = segment;
+        ++tail_;
+        bytes_ += segment.length;
+    }
+
+    void pop_front() {
+        Segment& segment = segments_[head_ & segment_mask_];
+        if (segment.shared) {
+            segment.shared->release();
+        } else {
+            arena_head_ = segment.arena_end;
+        }
+        ++head_;
+        sent_ = 0;
+    }
+
+    void swap(OutboundQueue& other) noexcept {
+        std::swap(arena_, other.arena_);
+        std::swap(arena_mask_, other.arena_mask_);
+        std::swap(arena_head_, other.arena_head_);
+        std::swap(arena_tail_, other.arena_tail_);
+        std::swap(segments_, other.segments_);
+        std::swap(segment_mask_, other.segment_mask_);
+        std::swap(head_, other.head_);
+        std::swap(tail_, other.tail_);
+        std::swap(sent_, other.sent_);
+        std::swap(pinned_, other.pinned_);
+        std::swap(bytes_, other.bytes_);
+    }
+
+    std::vector<uint8_t> arena_;        // Power-of-two size
+    uint64_t arena_mask_{0};
+    uint64_t arena_head_{0};            // Oldest arena byte still queued
+    uint64_t arena_tail_{0};            // Next arena byte to write
+    std::vector<Segment> segments_;     // Power-of-two size
+    uint64_t segment_mask_{0};
+    uint64_t head_{0};                  // Next frame to send
+    uint64_t tail_{0};                  // Next free slot
+    size_t sent_{0};                    // Bytes of the head frame already written
+    uint64_t pinned_{0};                // Frames before this one are being sent asynchronously
+    size_t bytes_{0};                   // Queued bytes not yet written
+};
+
+} // namespace hft
+
+#endif // OUTBOUND_QUEUE_H
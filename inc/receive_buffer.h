@@ -0,0 +1,102 @@
+#ifndef RECEIVE_BUFFER_H
+#define RECEIVE_BUFFER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+namespace hft {
+
+/**
+ * @brief Per-connection receive buffer for TCP stream reassembly
+ *
+ * Bytes are appended at the tail by recv() and consumed from the head by
+ * the framing layer. Unconsumed partial frames are moved back to the front
+ * only when the free tail space runs short, so in the common case a read
+ * never copies data.
+ */
+class ReceiveBuffer {
+public:
+    explicit ReceiveBuffer(size_t capacity = DEFAULT_CAPACITY)
+        : buffer_(capacity), head_(0), tail_(0) {}
+
+    /**
+     * @brief Pointer to free space for the next recv()
+     */
+    uint8_t* write_ptr() {
+        return buffer_.data() + tail_;
+    }
+
+    /**
+     * @brief Free space available at write_ptr()
+     */
+    size_t writable() const {
+        return buffer_.size() - tail_;
+    }
+
+    /**
+     * @brief Mark bytes written at write_ptr() as received
+     */
+    void commit(size_t bytes) {
+        tail_ += bytes;
+    }
+
+    /**
+     * @brief Pointer to the oldest unconsumed byte
+     */
+    const uint8_t* read_ptr() const {
+        return buffer_.data() + head_;
+    }
+
+    /**
+     * @brief Number of received but unconsumed bytes
+     */
+    size_t readable() const {
+        return tail_ - head_;
+    }
+
+    /**
+     * @brief Release bytes handed to the framing layer
+     */
+    void consume(size_t bytes) {
+        head_ += bytes;
+        if (head_ == tail_) {
+            head_ = 0;
+            tail_ = 0;
+        }
+    }
+
+    /**
+     * @brief Move a partial tail to the front once free space drops below min_free
+     */
+    void compact(size_t min_free) {
+        if (head_ == 0 || writable() >= min_free) {
+            return;
+        }
+        size_t pending = readable();
+        std::memmove(buffer_.data(), buffer_.data() + head_, pending);
+        head_ = 0;
+        tail_ = pending;
+    }
+
+    void clear() {
+        head_ = 0;
+        tail_ = 0;
+    }
+
+    size_t capacity() const {
+        return buffer_.size();
+    }
+
+    static constexpr size_t DEFAULT_CAPACITY = 64 * 1024;
+
+private:
+    std::vector<uint8_t> buffer_;
+    size_t head_;
+    size_t tail_;
+};
+
+} // namespace hft
+
+#endif // RECEIVE_BUFFER_H
@@ -0,0 +1,153 @@
+#ifndef RECOVERY_H
+#define RECOVERY_H
+
+#include "journal.h"
+#include "message.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace hft {
+
+/**
+ * @brief Resting order as reconstructed from the journal
+ */
+struct RecoveredOrder {
+    uint64_t order_id;
+    uint64_t client_order_id;
+    uint64_t session;               // Connection::client_id of the owner
+    uint64_t price;
+    uint64_t priority;              // Sequence of the record that queued it; lower is older
+    uint32_t remaining;
+    OrderSide side;
+    std::array<char, 16> symbol;
+};
+
+/**
+ * @brief Order book and sequencing state rebuilt from the journal
+ *
+ * Books are derived from what the server did rather than by matching
+ * again: each request is paired with the ack journaled after it under the
+ * engine lock, and fills and disconnects are applied as they come. Order
+ * ids, open quantities and queue priority come back exactly as clients saw
+ * them, however the live engine allocated ids.
+ *
+ * State is split into shards by symbol. Every shard reads every record
+ * from the same read-only segment mappings but keeps only its own orders
+ * and instruments, so shards replay in parallel, one thread each.
+ *
+ * Snapshots (snapshot-<sequence>.snap, next to the segments) hold the
+ * state as of a journal sequence; recovery loads the newest one and
+ * replays only the records after it.
+ */
+class JournalState {
+public:
+    explicit JournalState(size_t shards = 1);
+
+    /**
+     * @brief Load the newest snapshot in directory, then replay the records after it
+     * @return false on an unreadable snapshot or segment
+     */
+    bool recover(const std::string& directory);
+
+    /**
+     * @brief Apply the records of segments, oldest first, that follow sequence()
+     * @return false if a segment cannot be read
+     */
+    bool replay(const std::vector<std::string>& segments);
+
+    /**
+     * @brief Replace the state with a snapshot file
+     */
+    bool load_snapshot(const std::string& path);
+
+    /**
+     * @brief Write the state as of sequence() into directory and drop all but the previous snapshot
+     */
+    bool save_snapshot(const std::string& directory) const;
+
+    /**
+     * @brief Newest snapshot in directory, or an empty string
+     */
+    static std::string latest_snapshot(const std::string& directory);
+
+    /** Resting orders, oldest first */
+    std::vector<RecoveredOrder> orders() const;
+
+    /** Latest update per instrument, carrying its sequence number */
+    std::vector<MarketDataMessage> market_data() const;
+
+    uint64_t last_fill_id() const;
+    uint64_t sequence() const { return sequence_; }     // Last journal record applied
+    uint64_t segment() const { return segment_; }       // Last segment replayed
+    uint64_t replayed() const { return replayed_; }     // Records applied since construction or load
+
+private:
+    using Symbol = std::array<char, 16>;
+
+    struct Shard {
+        std::unordered_map<uint64_t, RecoveredOrder> orders;
+        std::map<Symbol, MarketDataMessage> market_data;
+        uint64_t last_fill_id{0};
+
+        // Order request awaiting its ack
+        OrderMessage request;
+        uint64_t request_session{0};
+        bool pending{false};
+    };
+
+    size_t shard_of(const Symbol& symbol) const;
+    void apply(Shard& shard, size_t index, const JournalRecordHeader& record, const uint8_t* frame);
+    void apply_ack(Shard& shard, size_t index, const JournalRecordHeader& record, const OrderMessage& ack);
+
+    std::vector<Shard> shards_;
+    uint64_t sequence_{0};
+    uint64_t segment_{0};
+    uint64_t replayed_{0};
+};
+
+/**
+ * @brief Snapshots the journal each time it completes a segment
+ *
+ * Keeps its own JournalState, starting from the recovered one, and
+ * replays each segment once the journal has moved past it; the matching
+ * path never pauses for a snapshot. The snapshot interval is therefore
+ * the segment size.
+ */
+class Checkpointer {
+public:
+    Checkpointer() = default;
+    ~Checkpointer() { stop(); }
+
+    Checkpointer(const Checkpointer&) = delete;
+    Checkpointer& operator=(const Checkpointer&) = delete;
+
+    /**
+     * @brief Snapshot state now if it replayed anything, then follow the journal in directory
+     */
+    void start(const std::string& directory, JournalState state);
+    void stop();
+
+    uint64_t snapshots() const { return snapshots_.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+    void checkpoint();
+
+    std::string directory_;
+    JournalState state_;
+    std::atomic<bool> running_{false};
+    std::atomic<uint64_t> snapshots_{0};
+    std::thread thread_;
+};
+
+} // namespace hft
+
+#endif // RECOVERY_H
@@ -0,0 +1,143 @@
+#ifndef SEND_RING_H
+#define SEND_RING_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+
+namespace hft {
+
+/**
+ * @brief Who may claim slots of a SendRing
+ */
+enum class ProducerMode : uint8_t {
+    SINGLE = 0,     // One thread claims; a claim is a load and a store
+    MULTI = 1       // Any thread claims; a claim is a compare-and-swap
+};
+
+/**
+ * @brief Bounded lock-free ring of slots written in place, one consumer
+ *
+ * A producer claims a slot, builds its value there and publishes it with
+ * one release store of the slot's sequence. Every slot has a cache line of
+ * its own sequence, so a consumer can tell published slots from claimed
+ * ones without a shared count, and several producers can publish out of
+ * claim order. The producer never blocks: claim() fails on a full ring.
+ */
+template <typename T>
+class SendRing {
+public:
+    /**
+     * @param capacity Rounded up to a power of two
+     */
+    explicit SendRing(size_t capacity = 1024, ProducerMode mode = ProducerMode::SINGLE)
+        : capacity_(round_up(capacity)), mask_(capacity_ - 1), mode_(mode), slots_(new Slot[capacity_]) {
+        for (size_t i = 0; i < capacity_; ++i) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    SendRing(const SendRing&) = delete;
+    SendRing& operator=(const SendRing&) = delete;
+
+    /**
+     * @brief Producer side: slot for the next value, or nullptr if the ring is full
+     * @param ticket Set to the claim, to pass to publish()
+     */
+    T* claim(uint64_t& ticket) {
+        uint64_t tail = tail_.load(std::memory_order_relaxed);
+        if (mode_ == ProducerMode::SINGLE) {
+            if (slots_[tail & mask_].sequence.load(std::memory_order_acquire) != tail) {
+                return nullptr;
+            }
+            tail_.store(tail + 1, std::memory_order_relaxed);
+        } else {
+            while (true) {
+                // Free for this lap when its sequence is the position; behind it, the consumer has not freed it
+                auto lag = static_cast<int64_t>(slots_[tail & mask_].sequence.load(std::memory_order_acquire) - tail);
+                if (lag < 0) {
+                    return nullptr;
+                }
+                if (lag == 0 && tail_.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+                if (lag > 0) {
+                    tail = tail_.load(std::memory_order_relaxed);
+                }
+            }
+        }
+        ticket = tail;
+        return &slots_[tail & mask_].value;
+    }
+
+    /**
+     * @brief Producer side: make a claimed slot visible to the consumer
+     */
+    void publish(uint64_t ticket) {
+        slots_[ticket & mask_].sequence.store(ticket + 1, std::memory_order_release);
+    }
+
+    /**
+     * @brief Producer side: every value claimed so far has been consumed
+     */
+    bool drained() const {
+        uint64_t tail = tail_.load(std::memory_order_relaxed);
+        return tail == 0 || slots_[(tail - 1) & mask_].sequence.load(std::memory_order_acquire) == tail - 1 + capacity_;
+    }
+
+    /**
+     * @brief Consumer side: the oldest value, or nullptr until it is published
+     */
+    T* front() { return at(0); }
+
+    /**
+     * @brief Consumer side: the value offset places behind the front, or nullptr until it is published
+     */
+    T* at(size_t offset) {
+        uint64_t position = head_ + offset;
+        if (offset >= capacity_) {
+            return nullptr;
+        }
+        Slot& slot = slots_[position & mask_];
+        return slot.sequence.load(std::memory_order_acquire) == position + 1 ? &slot.value : nullptr;
+    }
+
+    /**
+     * @brief Consumer side: hand the front count slots back to the producers
+     */
+    void pop(size_t count = 1) {
+        for (size_t i = 0; i < count; ++i) {
+            slots_[head_ & mask_].sequence.store(head_ + capacity_, std::memory_order_release);
+            ++head_;
+        }
+    }
+
+    size_t capacity() const { return capacity_; }
+    ProducerMode mode() const { return mode_; }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> sequence;     // Position for the producers, position + 1 once published
+        T value;
+    };
+
+    static size_t round_up(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    size_t capacity_;
+    size_t mask_;
+    ProducerMode mode_;
+    std::unique_ptr<Slot[]> slots_;
+    alignas(64) std::atomic<uint64_t> tail_{0};     // Next position to claim
+    alignas(64) uint64_t head_{0};                  // Next position to consume; consumer only
+};
+
+} // namespace hft
+
+#endif // SEND_RING_H
@@ -0,0 +1,226 @@
+#ifndef SHM_TRANSPORT_H
+#define SHM_TRANSPORT_H
+
+#include <sys/uio.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace hft {
+
+/**
+ * @brief Cross-process wake-up on a futex word in shared memory
+ *
+ * An event count: a waiter registers before re-checking its condition and
+ * a notifier only makes a system call when someone is registered, so the
+ * uncontended path is one fence and one load.
+ */
+struct ShmEvent {
+    std::atomic<uint32_t> sequence{0};
+    std::atomic<uint32_t> waiters{0};
+
+    /**
+     * @brief Sleep until notified or timeout_us pass, unless ready() already holds
+     */
+    template <typename Ready>
+    void wait(Ready&& ready, uint32_t timeout_us) {
+        uint32_t seen = sequence.load(std::memory_order_acquire);
+        waiters.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!ready()) {
+            sleep(seen, timeout_us);
+        }
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void notify() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) != 0) {
+            sequence.fetch_add(1, std::memory_order_release);
+            wake();
+        }
+    }
+
+private:
+    void sleep(uint32_t seen, uint32_t timeout_us);
+    void wake();
+};
+
+/**
+ * @brief Positions of one ring, each on its own cache line
+ */
+struct ShmRingControl {
+    alignas(64) std::atomic<uint64_t> head{0};              // Bytes consumed
+    alignas(64) std::atomic<uint64_t> tail{0};              // Bytes published
+    alignas(64) std::atomic<uint32_t> writer_blocked{0};    // Writer found the ring full
+};
+
+/**
+ * @brief Single-producer single-consumer byte ring in shared memory
+ *
+ * Carries the same length-prefixed wire frames as a TCP stream, with the
+ * same partial-write semantics, so both ends reuse their socket framing.
+ * Each process builds its own view over the shared control block and
+ * data; a view belongs to one side and caches the other side's position.
+ */
+class ShmRing {
+public:
+    ShmRing() = default;
+
+    /**
+     * @param capacity Power of two
+     * @param reader Event the consumer waits on for data
+     * @param writer Event the producer waits on for space
+     */
+    ShmRing(ShmRingControl* control, uint8_t* data, size_t capacity, ShmEvent* reader, ShmEvent* writer)
+        : control_(control), data_(data), capacity_(capacity), reader_(reader), writer_(writer) {}
+
+    /**
+     * @brief Copy as many bytes as fit, publish them and wake the reader
+     * @return Bytes written; less than requested when the ring is full
+     */
+    size_t write(const iovec* iov, int count);
+    size_t write(const void* data, size_t length);
+
+    /**
+     * @brief Copy out up to length bytes and wake a writer waiting for space
+     * @return Bytes read
+     */
+    size_t read(void* out, size_t length);
+
+    size_t readable() const {
+        return static_cast<size_t>(control_->tail.load(std::memory_order_acquire) -
+                                   control_->head.load(std::memory_order_relaxed));
+    }
+
+    size_t writable() const {
+        return capacity_ - static_cast<size_t>(control_->tail.load(std::memory_order_relaxed) -
+                                               control_->head.load(std::memory_order_acquire));
+    }
+
+    bool valid() const { return control_ != nullptr; }
+
+private:
+    ShmRingControl* control_{nullptr};
+    uint8_t* data_{nullptr};
+    size_t capacity_{0};
+    ShmEvent* reader_{nullptr};
+    ShmEvent* writer_{nullptr};
+    uint64_t cached_head_{0};   // Writer side: last head seen
+};
+
+/**
+ * @brief Life cycle of a session slot
+ *
+ * A client claims a FREE slot, resets its rings and marks it OPENING; the
+ * server turns it into a connection and marks it OPEN. Either side may
+ * close: the client by marking CLIENT_CLOSED, which the server frees, the
+ * server by marking SERVER_CLOSED, which the client frees.
+ */
+enum class ShmSlotState : uint32_t {
+    FREE = 0,
+    CLAIMED = 1,            // Client is resetting the rings
+    OPENING = 2,            // Waiting for the server to accept
+    OPEN = 3,
+    CLIENT_CLOSED = 4,
+    SERVER_CLOSED = 5
+};
+
+/**
+ * @brief Start of the shared-memory segment
+ */
+struct ShmSegmentHeader {
+    char magic[8];                          // "HFTSHM01"
+    uint32_t version;
+    uint32_t slot_count;
+    uint64_t ring_bytes;                    // Capacity of each ring
+    uint64_t slot_bytes;                    // Stride between slots
+    std::atomic<int32_t> server_pid{0};     // 0 once the server has shut down
+    alignas(64) ShmEvent server_event;      // Clients wake the server here
+};
+
+/**
+ * @brief Control block of one session, followed by its inbound and outbound ring data
+ */
+struct ShmSlotHeader {
+    alignas(64) std::atomic<ShmSlotState> state{ShmSlotState::FREE};
+    std::atomic<int32_t> client_pid{0};
+    alignas(64) ShmEvent client_event;      // The server wakes this slot's client here
+    ShmRingControl inbound;                 // Client to server
+    ShmRingControl outbound;                // Server to client
+};
+
+/**
+ * @brief Mapping of the shared-memory segment (/dev/shm/<name>) served by HFTServer
+ *
+ * The server creates the segment with a fixed number of session slots,
+ * each holding a pair of SPSC rings; co-located clients attach to it and
+ * claim a slot instead of connecting over loopback TCP.
+ */
+class ShmSegment {
+public:
+    static constexpr size_t DEFAULT_SLOTS = 16;
+    static constexpr size_t DEFAULT_RING_BYTES = 1 << 20;
+
+    ShmSegment() = default;
+    ~ShmSegment() { close(); }
+
+    ShmSegment(const ShmSegment&) = delete;
+    ShmSegment& operator=(const ShmSegment&) = delete;
+
+    /**
+     * @brief Create the segment, replacing one left behind by a server that is gone
+     * @param ring_bytes Rounded up to a power of two
+     * @return false if it cannot be created or a live server owns it
+     */
+    bool create(const std::string& name, size_t slots, size_t ring_bytes);
+
+    /**
+     * @brief Map an existing segment
+     * @return false if it does not exist or is not a segment
+     */
+    bool attach(const std::string& name);
+
+    /**
+     * @brief Unmap, and remove the segment if this mapping created it
+     */
+    void close();
+
+    bool valid() const { return header_ != nullptr; }
+
+    ShmSegmentHeader& header() const { return *header_; }
+    size_t slot_count() const { return header_->slot_count; }
+    ShmSlotHeader& slot(size_t index) const;
+
+    ShmRing inbound(size_t index) const;
+    ShmRing outbound(size_t index) const;
+
+    /**
+     * @brief Client side: claim a free slot, reset it and ask the server to open it
+     * @return Slot index, or -1 if every slot is taken
+     */
+    int claim();
+
+    /**
+     * @brief Client side: give a slot back
+     */
+    void release(size_t index);
+
+    /**
+     * @brief Whether the process that owns pid has exited
+     */
+    static bool process_gone(int32_t pid);
+
+private:
+    static std::string object_name(const std::string& name);
+
+    ShmSegmentHeader* header_{nullptr};
+    size_t size_{0};
+    std::string unlink_name_;           // Set when this mapping created the segment
+};
+
+} // namespace hft
+
+#endif // SHM_TRANSPORT_H
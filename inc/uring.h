@@ -0,0 +1,130 @@
+#ifndef URING_H
+#define URING_H
+
+#include <linux/io_uring.h>
+#include <sys/socket.h>
+
+#include <cstdint>
+#include <cstddef>
+
+namespace hft {
+
+/**
+ * @brief Minimal io_uring instance driven through the raw system calls
+ *
+ * Covers what the server needs without depending on liburing: one
+ * submission and completion ring, a provided buffer ring for multishot
+ * receives, and prep helpers for accept, recv, sendmsg, poll and cancel. An
+ * instance is owned and driven by a single thread.
+ */
+class IoUring {
+public:
+    IoUring() = default;
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    /**
+     * @brief Create the rings, preferring single-issuer deferred task running
+     * @return false with errno set on failure
+     */
+    bool init(unsigned entries);
+
+    /**
+     * @brief Whether the running kernel supports everything the server uses
+     */
+    static bool supported();
+
+    /**
+     * @brief Next free submission entry (zeroed), or nullptr if the queue is full
+     */
+    io_uring_sqe* get_sqe();
+
+    /**
+     * @brief Submit queued entries and wait for completions in one io_uring_enter
+     * @param wait_nr Completions to wait for (0 to only submit)
+     * @param timeout_us Upper bound on the wait
+     * @return Entries submitted, or -errno
+     */
+    int submit_and_wait(unsigned wait_nr, unsigned timeout_us);
+
+    /**
+     * @brief Call handler for every available completion, then release them
+     * @return Number of completions handled
+     */
+    template <typename Handler>
+    unsigned for_each_cqe(Handler&& handler) {
+        unsigned head = *cq_head_;
+        unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        unsigned count = 0;
+        for (; head != tail; ++head, ++count) {
+            handler(cqes_[head & cq_mask_]);
+        }
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+        return count;
+    }
+
+    /**
+     * @brief Register a provided buffer ring of count buffers of size bytes
+     * @param count Power of two, at most 32768
+     */
+    bool setup_buffer_ring(uint16_t group, uint16_t count, uint32_t size);
+
+    uint8_t* buffer(uint16_t id) const {
+        return buffers_ + static_cast<size_t>(id) * buffer_size_;
+    }
+
+    /**
+     * @brief Hand a consumed buffer back to the kernel
+     */
+    void recycle_buffer(uint16_t id);
+
+    uint16_t buffer_group() const { return buffer_group_; }
+
+    static void prep_multishot_accept(io_uring_sqe* sqe, int fd, uint64_t user_data);
+    static void prep_multishot_recv(io_uring_sqe* sqe, int fd, uint16_t group, uint64_t user_data);
+    static void prep_sendmsg(io_uring_sqe* sqe, int fd, const msghdr* msg, unsigned flags, uint64_t user_data);
+    static void prep_poll(io_uring_sqe* sqe, int fd, uint32_t events, uint64_t user_data);
+    static void prep_cancel(io_uring_sqe* sqe, uint64_t target, uint64_t user_data);
+
+private:
+    void unmap();
+
+    int ring_fd_{-1};
+    unsigned features_{0};
+
+    // Submission queue
+    void* sq_ptr_{nullptr};
+    size_t sq_size_{0};
+    unsigned* sq_head_{nullptr};
+    unsigned* sq_tail_{nullptr};
+    unsigned sq_mask_{0};
+    unsigned sq_entries_{0};
+    io_uring_sqe* sqes_{nullptr};
+    size_t sqes_size_{0};
+    unsigned sqe_head_{0};      // First entry not yet submitted
+    unsigned sqe_tail_{0};      // Next entry to hand out
+
+    // Completion queue
+    void* cq_ptr_{nullptr};
+    size_t cq_size_{0};
+    unsigned* cq_head_{nullptr};
+    unsigned* cq_tail_{nullptr};
+    unsigned cq_mask_{0};
+    io_uring_cqe* cqes_{nullptr};
+
+    // Provided buffers
+    io_uring_buf_ring* buf_ring_{nullptr};
+    size_t buf_ring_size_{0};
+    uint8_t* buffers_{nullptr};
+    size_t buffers_size_{0};
+    uint32_t buffer_size_{0};
+    uint16_t buffer_count_{0};
+    uint16_t buffer_group_{0};
+    uint16_t buf_tail_{0};
+};
+
+} // namespace hft
+
+#endif // URING_H
@@ -0,0 +1,431 @@
+#ifndef WIRE_FORMAT_H
+#define WIRE_FORMAT_H
+
+#include "message.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <array>
+
+namespace hft {
+namespace wire {
+
+/**
+ * @brief Compact, length-prefixed binary encoding for HFT messages
+ *
+ * Every frame is a packed WireHeader followed by a body whose layout is
+ * selected by message_type. Fields are written in host byte order
+ * (little-endian on all supported targets). Frames are at most
+ * MAX_FRAME_SIZE bytes, so callers can encode into a fixed stack buffer.
+ * Bodies naming an instrument carry both the symbol and its registry id,
+ * INVALID_INSTRUMENT when the sender does not know it.
+ */
+#pragma pack(push, 1)
+
+struct WireHeader {
+    uint16_t length;               // Total frame length including header
+    uint8_t message_type;          // MessageType
+    uint8_t status;                // MessageStatus
+    uint32_t sequence_number;
+    uint64_t message_id;
+    uint64_t timestamp;
+    uint32_t source_id;
+    uint32_t destination_id;
+};
+
+struct WireOrder {
+    std::array<char, 16> symbol;
+    uint8_t side;
+    uint8_t order_type;
+    uint8_t time_in_force;
+    uint64_t order_id;
+    uint64_t client_order_id;
+    uint32_t quantity;
+    uint64_t price;
+    uint64_t stop_price;
+    uint16_t instrument_id;
+};
+
+struct WireCancel {
+    std::array<char, 16> symbol;
+    uint64_t order_id;
+    uint64_t client_order_id;
+    uint16_t instrument_id;
+};
+
+struct WireReplace {
+    std::array<char, 16> symbol;
+    uint64_t order_id;
+    uint64_t client_order_id;
+    uint32_t quantity;
+    uint64_t price;
+    uint16_t instrument_id;
+};
+
+struct WireFill {
+    uint64_t order_id;
+    uint64_t fill_id;
+    uint32_t fill_quantity;
+    uint64_t fill_price;
+    uint64_t commission;
+    std::array<char, 16> execution_venue;
+};
+
+struct WireMarketData {
+    std::array<char, 16> symbol;
+    uint64_t bid_price;
+    uint32_t bid_size;
+    uint64_t ask_price;
+    uint32_t ask_size;
+    uint64_t last_price;
+    uint32_t last_size;
+    uint64_t volume;
+    uint64_t high_price;
+    uint64_t low_price;
+    uint16_t instrument_id;
+};
+
+struct WireSubscription {
+    std::array<char, 16> symbol;
+    uint16_t instrument_id;
+};
+
+struct WireRetransmit {
+    uint64_t first_sequence;
+    uint32_t count;
+};
+
+/**
+ * @brief Start of a multicast market data datagram, followed by count frames
+ *
+ * Frames are numbered by a feed sequence that starts at 1 in every
+ * publisher session. A heartbeat has count 0 and the sequence of the next
+ * frame to be published, so receivers notice a lost tail while the feed
+ * is quiet.
+ */
+struct WireFeedHeader {
+    uint64_t session;              // Publisher start time; a new one restarts the sequence
+    uint64_t sequence;             // Of the first frame
+    uint16_t count;
+};
+
+#pragma pack(pop)
+
+constexpr size_t HEADER_SIZE = sizeof(WireHeader);
+
+constexpr size_t max_body_size() {
+    size_t size = sizeof(WireOrder);
+    size = sizeof(WireCancel) > size ? sizeof(WireCancel) : size;
+    size = sizeof(WireReplace) > size ? sizeof(WireReplace) : size;
+    size = sizeof(WireFill) > size ? sizeof(WireFill) : size;
+    size = sizeof(WireMarketData) > size ? sizeof(WireMarketData) : size;
+    size = sizeof(WireRetransmit) > size ? sizeof(WireRetransmit) : size;
+    return size;
+}
+
+constexpr size_t MAX_FRAME_SIZE = HEADER_SIZE + max_body_size();
+
+/** Returned by frame_length() when the length prefix cannot be a valid frame */
+constexpr size_t INVALID_FRAME = static_cast<size_t>(-1);
+
+/**
+ * @brief Encoded frame ready for the socket
+ */
+struct Frame {
+    uint16_t length{0};
+    std::array<uint8_t, MAX_FRAME_SIZE> data;
+};
+
+/**
+ * @brief Length of the complete frame at data, or 0 if more bytes are needed
+ */
+inline size_t frame_length(const uint8_t* data, size_t available) {
+    if (available < sizeof(uint16_t)) {
+        return 0;
+    }
+    uint16_t length;
+    std::memcpy(&length, data, sizeof(length));
+    if (length < HEADER_SIZE || length > MAX_FRAME_SIZE) {
+        return INVALID_FRAME;
+    }
+    return available >= length ? length : 0;
+}
+
+/**
+ * @brief Message type of a complete frame
+ */
+inline MessageType peek_type(const uint8_t* frame) {
+    return static_cast<MessageType>(frame[offsetof(WireHeader, message_type)]);
+}
+
+namespace detail {
+
+inline size_t write_header(const Message& msg, size_t body_size, uint8_t* out) {
+    WireHeader header;
+    header.length = static_cast<uint16_t>(HEADER_SIZE + body_size);
+    header.message_type = static_cast<uint8_t>(msg.message_type);
+    header.status = static_cast<uint8_t>(msg.status);
+    header.sequence_number = msg.sequence_number;
+    header.message_id = msg.message_id;
+    header.timestamp = msg.timestamp;
+    header.source_id = msg.source_id;
+    header.destination_id = msg.destination_id;
+    std::memcpy(out, &header, HEADER_SIZE);
+    return header.length;
+}
+
+inline bool read_header(const uint8_t* frame, size_t length, size_t body_size, Message& msg) {
+    if (length < HEADER_SIZE + body_size) {
+        return false;
+    }
+    WireHeader header;
+    std::memcpy(&header, frame, HEADER_SIZE);
+    msg.message_type = static_cast<MessageType>(header.message_type);
+    msg.status = static_cast<MessageStatus>(header.status);
+    msg.sequence_number = header.sequence_number;
+    msg.message_id = header.message_id;
+    msg.timestamp = header.timestamp;
+    msg.source_id = header.source_id;
+    msg.destination_id = header.destination_id;
+    msg.payload_size = static_cast<uint32_t>(length - HEADER_SIZE);
+    return true;
+}
+
+} // namespace detail
+
+/**
+ * @brief Encode a header-only message (heartbeat, login, logout, ...)
+ * @param out Buffer of at least MAX_FRAME_SIZE bytes
+ * @return Encoded frame length
+ */
+inline size_t encode(const Message& msg, uint8_t* out) {
+    return detail::write_header(msg, 0, out);
+}
+
+/**
+ * @brief Encode an order; the body layout follows message_type
+ *
+ * ORDER_CANCEL and ORDER_REPLACE carry only the fields they need, every
+ * other type carries the full order.
+ */
+inline size_t encode(const OrderMessage& order, uint8_t* out) {
+    uint8_t* body = out + HEADER_SIZE;
+    switch (order.message_type) {
+        case MessageType::ORDER_CANCEL: {
+            WireCancel cancel;
+            cancel.symbol = order.symbol;
+            cancel.instrument_id = order.instrument_id;
+            cancel.order_id = order.order_id;
+            cancel.client_order_id = order.client_order_id;
+            std::memcpy(body, &cancel, sizeof(cancel));
+            return detail::write_header(order, sizeof(cancel), out);
+        }
+        case MessageType::ORDER_REPLACE: {
+            WireReplace replace;
+            replace.symbol = order.symbol;
+            replace.instrument_id = order.instrument_id;
+            replace.order_id = order.order_id;
+            replace.client_order_id = order.client_order_id;
+            replace.quantity = order.quantity;
+            replace.price = order.price;
+            std::memcpy(body, &replace, sizeof(replace));
+            return detail::write_header(order, sizeof(replace), out);
+        }
+        default: {
+            WireOrder wire;
+            wire.symbol = order.symbol;
+            wire.instrument_id = order.instrument_id;
+            wire.side = static_cast<uint8_t>(order.side);
+            wire.order_type = static_cast<uint8_t>(order.order_type);
+            wire.time_in_force = static_cast<uint8_t>(order.time_in_force);
+            wire.order_id = order.order_id;
+            wire.client_order_id = order.client_order_id;
+            wire.quantity = order.quantity;
+            wire.price = order.price;
+            wire.stop_price = order.stop_price;
+            std::memcpy(body, &wire, sizeof(wire));
+            return detail::write_header(order, sizeof(wire), out);
+        }
+    }
+}
+
+inline size_t encode(const FillMessage& fill, uint8_t* out) {
+    WireFill wire;
+    wire.order_id = fill.order_id;
+    wire.fill_id = fill.fill_id;
+    wire.fill_quantity = fill.fill_quantity;
+    wire.fill_price = fill.fill_price;
+    wire.commission = fill.commission;
+    wire.execution_venue = fill.execution_venue;
+    std::memcpy(out + HEADER_SIZE, &wire, sizeof(wire));
+    return detail::write_header(fill, sizeof(wire), out);
+}
+
+/**
+ * @brief Encode market data; subscription requests and acks carry only the symbol
+ */
+inline size_t encode(const MarketDataMessage& data, uint8_t* out) {
+    if (data.message_type == MessageType::MARKET_DATA_SUBSCRIBE ||
+        data.message_type == MessageType::MARKET_DATA_UNSUBSCRIBE) {
+        WireSubscription subscription;
+        subscription.symbol = data.symbol;
+        subscription.instrument_id = data.instrument_id;
+        std::memcpy(out + HEADER_SIZE, &subscription, sizeof(subscription));
+        return detail::write_header(data, sizeof(subscription), out);
+    }
+
+    WireMarketData wire;
+    wire.symbol = data.symbol;
+    wire.instrument_id = data.instrument_id;
+    wire.bid_price = data.bid_price;
+    wire.bid_size = data.bid_size;
+    wire.ask_price = data.ask_price;
+    wire.ask_size = data.ask_size;
+    wire.last_price = data.last_price;
+    wire.last_size = data.last_size;
+    wire.volume = data.volume;
+    wire.high_price = data.high_price;
+    wire.low_price = data.low_price;
+    std::memcpy(out + HEADER_SIZE, &wire, sizeof(wire));
+    return detail::write_header(data, sizeof(wire), out);
+}
+
+inline size_t encode(const RetransmitMessage& request, uint8_t* out) {
+    WireRetransmit wire;
+    wire.first_sequence = request.first_sequence;
+    wire.count = request.count;
+    std::memcpy(out + HEADER_SIZE, &wire, sizeof(wire));
+    return detail::write_header(request, sizeof(wire), out);
+}
+
+/**
+ * @brief Encode any message type into a Frame
+ */
+template <typename T>
+inline Frame make_frame(const T& msg) {
+    Frame frame;
+    frame.length = static_cast<uint16_t>(encode(msg, frame.data.data()));
+    return frame;
+}
+
+/**
+ * @brief Decode the header of a complete frame
+ * @return false if the frame is truncated
+ */
+inline bool decode(const uint8_t* frame, size_t length, Message& msg) {
+    return detail::read_header(frame, length, 0, msg);
+}
+
+inline bool decode(const uint8_t* frame, size_t length, OrderMessage& order) {
+    const uint8_t* body = frame + HEADER_SIZE;
+    switch (peek_type(frame)) {
+        case MessageType::ORDER_CANCEL: {
+            WireCancel cancel;
+            if (!detail::read_header(frame, length, sizeof(cancel), order)) {
+                return false;
+            }
+            std::memcpy(&cancel, body, sizeof(cancel));
+            order.symbol = cancel.symbol;
+            order.instrument_id = cancel.instrument_id;
+            order.order_id = cancel.order_id;
+            order.client_order_id = cancel.client_order_id;
+            return true;
+        }
+        case MessageType::ORDER_REPLACE: {
+            WireReplace replace;
+            if (!detail::read_header(frame, length, sizeof(replace), order)) {
+                return false;
+            }
+            std::memcpy(&replace, body, sizeof(replace));
+            order.symbol = replace.symbol;
+            order.instrument_id = replace.instrument_id;
+            order.order_id = replace.order_id;
+            order.client_order_id = replace.client_order_id;
+            order.quantity = replace.quantity;
+            order.price = replace.price;
+            return true;
+        }
+        default: {
+            WireOrder wire;
+            if (!detail::read_header(frame, length, sizeof(wire), order)) {
+                return false;
+            }
+            std::memcpy(&wire, body, sizeof(wire));
+            order.symbol = wire.symbol;
+            order.instrument_id = wire.instrument_id;
+            order.side = static_cast<OrderSide>(wire.side);
+            order.order_type = static_cast<OrderType>(wire.order_type);
+            order.time_in_force = static_cast<TimeInForce>(wire.time_in_force);
+            order.order_id = wire.order_id;
+            order.client_order_id = wire.client_order_id;
+            order.quantity = wire.quantity;
+            order.price = wire.price;
+            order.stop_price = wire.stop_price;
+            return true;
+        }
+    }
+}
+
+inline bool decode(const uint8_t* frame, size_t length, FillMessage& fill) {
+    WireFill wire;
+    if (!detail::read_header(frame, length, sizeof(wire), fill)) {
+        return false;
+    }
+    std::memcpy(&wire, frame + HEADER_SIZE, sizeof(wire));
+    fill.order_id = wire.order_id;
+    fill.fill_id = wire.fill_id;
+    fill.fill_quantity = wire.fill_quantity;
+    fill.fill_price = wire.fill_price;
+    fill.commission = wire.commission;
+    fill.execution_venue = wire.execution_venue;
+    return true;
+}
+
+inline bool decode(const uint8_t* frame, size_t length, MarketDataMessage& data) {
+    MessageType type = peek_type(frame);
+    if (type == MessageType::MARKET_DATA_SUBSCRIBE || type == MessageType::MARKET_DATA_UNSUBSCRIBE) {
+        WireSubscription subscription;
+        if (!detail::read_header(frame, length, sizeof(subscription), data)) {
+            return false;
+        }
+        std::memcpy(&subscription, frame + HEADER_SIZE, sizeof(subscription));
+        data.symbol = subscription.symbol;
+        data.instrument_id = subscription.instrument_id;
+        return true;
+    }
+
+    WireMarketData wire;
+    if (!detail::read_header(frame, length, sizeof(wire), data)) {
+        return false;
+    }
+    std::memcpy(&wire, frame + HEADER_SIZE, sizeof(wire));
+    data.symbol = wire.symbol;
+    data.instrument_id = wire.instrument_id;
+    data.bid_price = wire.bid_price;
+    data.bid_size = wire.bid_size;
+    data.ask_price = wire.ask_price;
+    data.ask_size = wire.ask_size;
+    data.last_price = wire.last_price;
+    data.last_size = wire.last_size;
+    data.volume = wire.volume;
+    data.high_price = wire.high_price;
+    data.low_price = wire.low_price;
+    return true;
+}
+
+inline bool decode(const uint8_t* frame, size_t length, RetransmitMessage& request) {
+    WireRetransmit wire;
+    if (!detail::read_header(frame, length, sizeof(wire), request)) {
+        return false;
+    }
+    std::memcpy(&wire, frame + HEADER_SIZE, sizeof(wire));
+    request.first_sequence = wire.first_sequence;
+    request.count = wire.count;
+    return true;
+}
+
+} // namespace wire
+} // namespace hft
+
+#endif // WIRE_FORMAT_H
@@ -18,8 +18,6 @@ public:
           quantity_dist_(100, 10000), price_dist_(100000, 200000) {
         
         test_symbols_ = {"AAPL", "GOOGL", "MSFT", "TSLA", "AMZN", "NVDA", "META", "NFLX"};
-        recv_buffer_.resize(65536);
-        send_buffer_.resize(65536);
     }
     
     bool connect() {
@@ -93,7 +91,7 @@ public:
         latency_measurements_.clear();
         latency_measurements_.reserve(num_messages);
         
-        auto start_time = std::chrono::high_resolution_clock::now();
+        uint64_t start_ns = Clock::monotonic_ns();
         
         // Send all messages as fast as possible
         for (size_t i = 0; i < num_messages; ++i) {
@@ -101,22 +99,21 @@ public:
             order.message_id = message_id_dist_(gen_);
             order.update_timestamp();
             
-            auto send_time = std::chrono::high_resolution_clock::now();
+            uint64_t send_ns = Clock::monotonic_ns();
             send_order(order);
             
             // Store send time for latency calculation
-            send_times_.push_back(send_time.time_since_epoch().count());
+            send_times_.push_back(send_ns);
             
             if (i % 10000 == 0 && i > 0) {
                 std::cout << "Sent " << i << " messages..." << std::endl;
             }
         }
         
-        auto send_end_time = std::chrono::high_resolution_clock::now();
-        auto send_duration = std::chrono::duration_cast<std::chrono::milliseconds>(send_end_time - start_time);
+        uint64_t send_duration_ns = Clock::monotonic_ns() - start_ns;
         
-        std::cout << "All " << num_messages << " messages sent in " << send_duration.count() << "ms" << std::endl;
-        std::cout << "Sending rate: " << (num_messages * 1000.0 / send_duration.count()) << " msg/sec" << std::endl;
+        std::cout << "All " << num_messages << " messages sent in " << send_duration_ns / 1000000 << "ms" << std::endl;
+        std::cout << "Sending rate: " << (num_messages * 1e9 / send_duration_ns) << " msg/sec" << std::endl;
         
         // Receive responses and calculate latency
         std::cout << "\nReceiving responses and calculating latency..." << std::endl;
@@ -127,23 +124,24 @@ public:
     }
     
     void receive_responses() {
-        char buffer[65536];
         size_t messages_received = 0;
         size_t send_time_index = 0;
         
-        auto start_receive = std::chrono::high_resolution_clock::now();
+        uint64_t start_receive_ns = Clock::monotonic_ns();
         
         while (messages_received < send_times_.size()) {
-            ssize_t bytes_received = recv(socket_fd_, buffer, sizeof(buffer), MSG_DONTWAIT);
+            recv_buffer_.compact(wire::MAX_FRAME_SIZE);
+            ssize_t bytes_received = recv(socket_fd_, recv_buffer_.write_ptr(), recv_buffer_.writable(), MSG_DONTWAIT);
             
             if (bytes_received > 0) {
-                size_t offset = 0;
-                while (offset + sizeof(Message) <= static_cast<size_t>(bytes_received) && 
+                recv_buffer_.commit(static_cast<size_t>(bytes_received));
+                
+                size_t frame_length;
+                while ((frame_length = wire::frame_length(recv_buffer_.read_ptr(), recv_buffer_.readable())) != 0 &&
+                       frame_length != wire::INVALID_FRAME &&
                        send_time_index < send_times_.size()) {
                     
-                    const Message* msg = reinterpret_cast<const Message*>(buffer + offset);
-                    auto receive_time = std::chrono::high_resolution_clock::now();
-                    auto receive_ns = receive_time.time_since_epoch().count();
+                    uint64_t receive_ns = Clock::monotonic_ns();
                     
                     // Calculate latency
                     uint64_t latency_ns = receive_ns - send_times_[send_time_index];
@@ -156,7 +154,7 @@ public:
                         std::cout << "Received " << messages_received << " responses..." << std::endl;
                     }
                     
-                    offset += sizeof(Message);
+                    recv_buffer_.consume(frame_length);
                 }
             } else if (bytes_received == 0) {
                 std::cout << "Server disconnected" << std::endl;
@@ -168,10 +166,9 @@ public:
             std::this_thread::sleep_for(std::chrono::microseconds(10));
         }
         
-        auto end_receive = std::chrono::high_resolution_clock::now();
-        auto receive_duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_receive - start_receive);
+        uint64_t receive_duration_ms = (Clock::monotonic_ns() - start_receive_ns) / 1000000;
         
-        std::cout << "Received " << messages_received << " responses in " << receive_duration.count() << "ms" << std::endl;
+        std::cout << "Received " << messages_received << " responses in " << receive_duration_ms << "ms" << std::endl;
     }
     
     void calculate_statistics() {
@@ -253,20 +250,15 @@ public:
     }
     
     bool send_order(const OrderMessage& order) {
-        Message msg;
-        msg.message_id = order.message_id;
-        msg.timestamp = order.timestamp;
+        OrderMessage msg = order;
         msg.message_type = MessageType::ORDER_NEW;
         msg.status = MessageStatus::PENDING;
         msg.source_id = 1;
         msg.destination_id = 0;
-        msg.payload_size = sizeof(OrderMessage);
         
-        size_t copy_size = std::min(sizeof(order), msg.payload.size());
-        std::memcpy(msg.payload.data(), &order, copy_size);
-        
-        ssize_t bytes_sent = send(socket_fd_, &msg, sizeof(msg), MSG_NOSIGNAL);
-        return bytes_sent == sizeof(msg);
+        wire::Frame frame = wire::make_frame(msg);
+        ssize_t bytes_sent = send(socket_fd_, frame.data.data(), frame.length, MSG_NOSIGNAL);
+        return bytes_sent == frame.length;
     }
     
     void setup_socket_options(int sock_fd) {
@@ -297,8 +289,7 @@ private:
     std::vector<uint64_t> latency_measurements_;
     std::vector<uint64_t> send_times_;
     
-    std::vector<char> recv_buffer_;
-    std::vector<char> send_buffer_;
+    ReceiveBuffer recv_buffer_;
     
     std::random_device rd_;
     std::mt19937 gen_;
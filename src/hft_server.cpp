@@ -1,7 +1,16 @@
 
 #include "hft_server.h"
+#include "instrument_registry.h"
+#include "journal.h"
+#include "logger.h"
 
 #include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <cstring>
 #include <iostream>
 #include <algorithm>
@@ -13,6 +22,9 @@ namespace hft {
 
 // Singleton instance
 HFTServer& HFTServer::get_instance() {
+    // Construct the logger and journal first so they outlive the server
+    Logger::get_instance();
+    Journal::get_instance();
     static HFTServer instance;
     return instance;
 }
@@ -21,52 +33,116 @@ HFTServer::~HFTServer() {
     stop();
 }
 
-bool HFTServer::initialize(const std::string& ip, uint16_t port, size_t thread_count) {
+bool HFTServer::initialize(const std::string& ip, uint16_t port, size_t thread_count,
+                           bool sharded, IoBackend backend, const UnixSocketConfig& local) {
     server_ip_ = ip;
     server_port_ = port;
     thread_count_ = thread_count;
+    sharded_ = sharded;
+    backend_ = backend;
+    local_ = local;
     
-    // Pre-allocate buffers
-    send_buffer_.resize(BUFFER_SIZE);
-    recv_buffer_.resize(BUFFER_SIZE);
+    // Session ids outlive the process in the journal; wall clock ns never repeat across restarts
+    next_client_id_.store(Message::get_current_timestamp(), std::memory_order_relaxed);
     
+    if (backend_ == IoBackend::IO_URING && !IoUring::supported()) {
+        std::cerr << "io_uring backend unavailable: " << strerror(errno) << std::endl;
+        return false;
+    }
+    
+    // Per-worker statistics slots
+    worker_stats_.clear();
+    for (size_t i = 0; i < thread_count_; ++i) {
+        worker_stats_.push_back(std::make_unique<WorkerStats>());
+    }
+    
+    // One reactor per worker when sharded, otherwise a single shared one
+    size_t reactor_count = sharded_ ? thread_count_ : 1;
+    reactors_.clear();
+    auto close_reactors = [this] {
+        for (auto& r : reactors_) {
+            if (r->epoll_fd != -1) {
+                close(r->epoll_fd);
+            }
+            close(r->listen_fd);
+        }
+        reactors_.clear();
+    };
+    for (size_t i = 0; i < reactor_count; ++i) {
+        auto reactor = std::make_unique<Reactor>();
+        if (!setup_reactor(*reactor, sharded_)) {
+            close_reactors();
+            return false;
+        }
+        reactors_.push_back(std::move(reactor));
+    }
+    if (!local_.path.empty() && !setup_local_listener()) {
+        close_reactors();
+        return false;
+    }
+    
+    std::cout << "HFT Server initialized on " << ip << ":" << port
+              << (sharded_ ? " (sharded, SO_REUSEPORT)" : "")
+              << (backend_ == IoBackend::IO_URING ? " (io_uring)" : "") << std::endl;
+    if (local_listen_fd_ != -1) {
+        std::cout << "Local socket: " << local_.path
+                  << (local_.seqpacket ? " (SOCK_SEQPACKET)" : " (SOCK_STREAM)") << std::endl;
+    }
+    return true;
+}
+
+bool HFTServer::setup_reactor(Reactor& reactor, bool reuse_port) {
     // Create server socket
-    server_socket_ = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_socket_ == -1) {
+    reactor.listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (reactor.listen_fd == -1) {
         std::cerr << "Failed to create server socket: " << strerror(errno) << std::endl;
         return false;
     }
     
     // Set socket options for high performance
-    setup_socket_options(server_socket_);
+    setup_socket_options(reactor.listen_fd);
+    
+    // Let the kernel spread incoming connections across the worker listeners
+    if (reuse_port) {
+        int opt = 1;
+        if (setsockopt(reactor.listen_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) == -1) {
+            std::cerr << "Failed to set SO_REUSEPORT: " << strerror(errno) << std::endl;
+            close(reactor.listen_fd);
+            return false;
+        }
+    }
     
     // Bind socket
     sockaddr_in server_addr{};
     server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(port);
-    server_addr.sin_addr.s_addr = inet_addr(ip.c_str());
+    server_addr.sin_port = htons(server_port_);
+    server_addr.sin_addr.s_addr = inet_addr(server_ip_.c_str());
     
-    if (bind(server_socket_, reinterpret_cast<sockaddr*>(&server_addr), sizeof(server_addr)) == -1) {
+    if (bind(reactor.listen_fd, reinterpret_cast<sockaddr*>(&server_addr), sizeof(server_addr)) == -1) {
         std::cerr << "Failed to bind socket: " << strerror(errno) << std::endl;
-        close(server_socket_);
+        close(reactor.listen_fd);
         return false;
     }
     
     // Listen for connections
-    if (listen(server_socket_, BACKLOG) == -1) {
+    if (listen(reactor.listen_fd, BACKLOG) == -1) {
         std::cerr << "Failed to listen: " << strerror(errno) << std::endl;
-        close(server_socket_);
+        close(reactor.listen_fd);
         return false;
     }
     
     // Set non-blocking
-    set_non_blocking(server_socket_);
+    set_non_blocking(reactor.listen_fd);
+    
+    if (backend_ == IoBackend::IO_URING) {
+        return true; // Each worker's ring accepts on the listener directly
+    }
     
     // Create epoll instance
-    epoll_fd_ = epoll_create1(0);
-    if (epoll_fd_ == -1) {
+    reactor.epoll_fd = epoll_create1(0);
+    if (reactor.epoll_fd == -1) {
         std::cerr << "Failed to create epoll: " << strerror(errno) << std::endl;
-        close(server_socket_);
+        close(reactor.listen_fd);
         return false;
     }
     
@@ -74,17 +150,228 @@ bool HFTServer::initialize(const std::string& ip, uint16_t port, size_t thread_c
     epoll_event ev{};
     ev.events = EPOLLIN;
     ev.data.ptr = nullptr;
-    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, server_socket_, &ev) == -1) {
+    if (epoll_ctl(reactor.epoll_fd, EPOLL_CTL_ADD, reactor.listen_fd, &ev) == -1) {
         std::cerr << "Failed to add server socket to epoll: " << strerror(errno) << std::endl;
-        close(epoll_fd_);
-        close(server_socket_);
+        close(reactor.epoll_fd);
+        close(reactor.listen_fd);
+        return false;
+    }
+    
+    return true;
+}
+
+bool HFTServer::setup_local_listener() {
+    const std::string& path = local_.path;
+    int type = local_.seqpacket ? SOCK_SEQPACKET : SOCK_STREAM;
+    
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Unix socket path too long: " << path << std::endl;
+        return false;
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    
+    // A socket file left behind by a server that is gone refuses connections; a live one is not replaced
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            std::cerr << "Unix socket path exists and is not a socket: " << path << std::endl;
+            return false;
+        }
+        int probe = socket(AF_UNIX, type, 0);
+        bool stale = probe != -1 && connect(probe, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1 &&
+                     errno == ECONNREFUSED;
+        if (probe != -1) {
+            close(probe);
+        }
+        if (!stale) {
+            std::cerr << "Unix socket " << path << " is in use" << std::endl;
+            return false;
+        }
+        unlink(path.c_str());
+    }
+    
+    local_listen_fd_ = socket(AF_UNIX, type, 0);
+    if (local_listen_fd_ == -1) {
+        std::cerr << "Failed to create Unix socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+    auto fail = [this](const char* what) {
+        std::cerr << what << ": " << strerror(errno) << std::endl;
+        close(local_listen_fd_);
+        local_listen_fd_ = -1;
+        return false;
+    };
+    
+    if (bind(local_listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1) {
+        return fail("Failed to bind Unix socket");
+    }
+    if (listen(local_listen_fd_, BACKLOG) == -1) {
+        unlink(path.c_str());
+        return fail("Failed to listen on Unix socket");
+    }
+    set_non_blocking(local_listen_fd_);
+    
+    if (backend_ == IoBackend::IO_URING) {
+        return true; // Each worker's ring accepts on it as well
+    }
+    
+    // One listener for every reactor; when sharded only one worker is woken per connection
+    for (auto& reactor : reactors_) {
+        epoll_event ev{};
+        ev.events = sharded_ ? EPOLLIN | EPOLLEXCLUSIVE : EPOLLIN;
+        ev.data.ptr = &local_listen_fd_;
+        if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, local_listen_fd_, &ev) == -1) {
+            unlink(path.c_str());
+            return fail("Failed to add Unix socket to epoll");
+        }
+    }
+    return true;
+}
+
+bool HFTServer::enable_shared_memory(const SharedMemoryConfig& config) {
+    if (!shm_.create(config.name, config.sessions, config.ring_bytes)) {
         return false;
     }
     
-    std::cout << "HFT Server initialized on " << ip << ":" << port << std::endl;
+    // Statistics slot of the shared-memory thread, after the workers'
+    worker_stats_.push_back(std::make_unique<WorkerStats>());
+    
+    std::cout << "Shared memory: /dev/shm/" << (config.name[0] == '/' ? config.name.substr(1) : config.name)
+              << ", " << shm_.slot_count() << " sessions, " << shm_.header().ring_bytes / 1024
+              << " KB rings" << std::endl;
     return true;
 }
 
+void HFTServer::set_polling(const PollingConfig& config) {
+    polling_ = config;
+}
+
+void HFTServer::set_outbound(const OutboundConfig& config) {
+    outbound_ = config;
+}
+
+void HFTServer::pin_worker(size_t thread_id) {
+    if (polling_.cpus.empty()) {
+        return;
+    }
+    
+    int cpu = polling_.cpus[thread_id % polling_.cpus.size()];
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+    int result = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+    if (result != 0) {
+        HFT_LOG_WARN("Worker {} could not be pinned to CPU {}: {}", thread_id, cpu, LogErrno{result});
+        return;
+    }
+    HFT_LOG_INFO("Worker {} pinned to CPU {}", thread_id, cpu);
+}
+
+/**
+ * @brief Per-worker io_uring state
+ *
+ * Completions are tagged in the low bits of user_data; the upper bits hold
+ * the Connection pointer for recv, send and writability polls. A send is
+ * only queued here; the next io_uring_enter submits every connection's at
+ * once. The ring has a single issuer, so other threads hand connections
+ * over rather than touch it.
+ */
+struct HFTServer::UringWorker {
+    static constexpr unsigned RING_ENTRIES = 4096;
+    static constexpr uint16_t RECV_BUFFERS = 1024;     // Power of two
+    
+    enum Op : uint64_t {
+        OP_ACCEPT = 1,
+        OP_RECV = 2,
+        OP_WRITABLE = 3,
+        OP_CANCEL = 4,
+        OP_ACCEPT_LOCAL = 5,        // Unix-domain listener
+        OP_SEND = 6
+    };
+    static constexpr uint64_t OP_MASK = 7;
+    
+    int index{-1};
+    
+    // Connections waiting for socket space or a send, kept alive until it completes
+    std::unordered_map<Connection*, std::shared_ptr<Connection>> blocked;
+    std::unordered_map<Connection*, std::shared_ptr<Connection>> sending;
+    
+    // Closed connections whose multishot recv has not completed yet
+    std::unordered_map<Connection*, std::shared_ptr<Connection>> closing;
+    
+    // Blocked connections handed over by threads without a ring
+    std::mutex handoff_mutex;
+    std::vector<std::shared_ptr<Connection>> handoff;
+    std::atomic<bool> has_handoff{false};
+    
+    // Torn down first, so the kernel is done with in-flight sends before the maps drop their connections
+    IoUring ring;
+    
+    io_uring_sqe* next_sqe() {
+        io_uring_sqe* sqe = ring.get_sqe();
+        if (!sqe) {
+            // Queue full: submit what is pending without waiting
+            ring.submit_and_wait(0, 0);
+            sqe = ring.get_sqe();
+        }
+        return sqe;
+    }
+    
+    void arm_accept(int listen_fd, Op op = OP_ACCEPT) {
+        if (io_uring_sqe* sqe = next_sqe()) {
+            IoUring::prep_multishot_accept(sqe, listen_fd, op);
+        }
+    }
+    
+    void arm_recv(Connection& conn) {
+        if (io_uring_sqe* sqe = next_sqe()) {
+            IoUring::prep_multishot_recv(sqe, conn.fd, ring.buffer_group(),
+                                         reinterpret_cast<uint64_t>(&conn) | OP_RECV);
+        }
+    }
+    
+    void watch_writable(Connection& conn) {
+        if (io_uring_sqe* sqe = next_sqe()) {
+            IoUring::prep_poll(sqe, conn.fd, POLLOUT, reinterpret_cast<uint64_t>(&conn) | OP_WRITABLE);
+            blocked.emplace(&conn, conn.shared_from_this());
+        }
+    }
+    
+    void send(Connection& conn) {
+        io_uring_sqe* sqe = next_sqe();
+        if (!sqe) {
+            return;
+        }
+        // No MSG_DONTWAIT: the kernel waits for socket space itself, so a full socket needs no poll
+        int count = conn.outbound.gather(conn.send_iov, OutboundQueue::MAX_IOVECS);
+        conn.send_msg = {};
+        conn.send_msg.msg_iov = conn.send_iov;
+        conn.send_msg.msg_iovlen = static_cast<size_t>(count);
+        IoUring::prep_sendmsg(sqe, conn.fd, &conn.send_msg, MSG_NOSIGNAL,
+                              reinterpret_cast<uint64_t>(&conn) | OP_SEND);
+        conn.outbound.pin();
+        conn.sending = true;
+        conn.want_write = true;
+        sending.emplace(&conn, conn.shared_from_this());
+    }
+    
+    void hand_off(std::shared_ptr<Connection> conn) {
+        std::lock_guard<std::mutex> lock(handoff_mutex);
+        handoff.push_back(std::move(conn));
+        has_handoff.store(true, std::memory_order_release);
+    }
+    
+    void retire(std::shared_ptr<Connection> conn) {
+        uint64_t target = reinterpret_cast<uint64_t>(conn.get()) | OP_RECV;
+        closing[conn.get()] = std::move(conn);
+        if (io_uring_sqe* sqe = next_sqe()) {
+            IoUring::prep_cancel(sqe, target, OP_CANCEL);
+        }
+    }
+};
+
 void HFTServer::start() {
     if (running_.load()) {
         return;
@@ -94,10 +381,24 @@ void HFTServer::start() {
     
     // Start worker threads (they will handle both accepting and processing)
     for (size_t i = 0; i < thread_count_; ++i) {
-        worker_threads_.emplace_back(&HFTServer::worker_thread, this, i);
+        if (backend_ == IoBackend::IO_URING) {
+            uring_workers_.push_back(std::make_unique<UringWorker>());
+            uring_workers_.back()->index = static_cast<int>(i);
+        }
+    }
+    for (size_t i = 0; i < thread_count_; ++i) {
+        if (backend_ == IoBackend::IO_URING) {
+            worker_threads_.emplace_back(&HFTServer::uring_worker_thread, this, i);
+        } else {
+            worker_threads_.emplace_back(&HFTServer::worker_thread, this, i);
+        }
+    }
+    if (shm_.valid()) {
+        worker_threads_.emplace_back(&HFTServer::shm_thread, this, thread_count_);
     }
     
-    std::cout << "HFT Server started with " << thread_count_ << " worker threads" << std::endl;
+    std::cout << "HFT Server started with " << thread_count_ << " worker threads"
+              << (shm_.valid() ? " and a shared-memory thread" : "") << std::endl;
 }
 
 void HFTServer::stop() {
@@ -107,10 +408,17 @@ void HFTServer::stop() {
     
     running_.store(false);
     
-    // Close server socket to unblock accept
-    if (server_socket_ != -1) {
-        close(server_socket_);
-        server_socket_ = -1;
+    // Close server sockets to unblock accept
+    for (auto& reactor : reactors_) {
+        if (reactor->listen_fd != -1) {
+            close(reactor->listen_fd);
+            reactor->listen_fd = -1;
+        }
+    }
+    if (local_listen_fd_ != -1) {
+        close(local_listen_fd_);
+        local_listen_fd_ = -1;
+        unlink(local_.path.c_str());
     }
     
     // Join threads
@@ -120,341 +428,1185 @@ void HFTServer::stop() {
         }
     }
     worker_threads_.clear();
+    uring_workers_.clear();
     
-    // Close epoll
-    if (epoll_fd_ != -1) {
-        close(epoll_fd_);
-        epoll_fd_ = -1;
-    }
-    
-    // Close all client connections
-    std::lock_guard<std::mutex> lock(connections_mutex_);
-    for (auto& [fd, conn] : connections_) {
-        close(conn->fd);
+    for (auto& reactor : reactors_) {
+        // Close epoll
+        if (reactor->epoll_fd != -1) {
+            close(reactor->epoll_fd);
+            reactor->epoll_fd = -1;
+        }
+        
+        // Close all client connections
+        std::lock_guard<std::mutex> lock(reactor->connections_mutex);
+        for (auto& [fd, conn] : reactor->connections) {
+            close(conn->fd);
+        }
+        reactor->connections.clear();
     }
-    connections_.clear();
+    shm_.close();
+    active_connections_.store(0);
     
+    // Let queued worker logs out before the final banner
+    Logger::get_instance().flush();
     std::cout << "HFT Server stopped" << std::endl;
 }
 
-void HFTServer::accept_connections() {
+void HFTServer::accept_connections(Reactor& reactor, int listen_fd, WorkerStats& stats) {
     sockaddr_in client_addr{};
     socklen_t client_len = sizeof(client_addr);
     
-    int client_fd = accept(server_socket_, reinterpret_cast<sockaddr*>(&client_addr), &client_len);
+    // A Unix-domain peer shows up as family AF_UNIX; its path is truncated away
+    int client_fd = accept(listen_fd, reinterpret_cast<sockaddr*>(&client_addr), &client_len);
     if (client_fd == -1) {
         if (errno == EAGAIN || errno == EWOULDBLOCK) {
             return; // No pending connections
         }
-        std::cerr << "Accept failed: " << strerror(errno) << std::endl;
+        HFT_LOG_ERROR("Accept failed: {}", LogErrno{errno});
         return;
     }
-        
-        // Set client socket options
-        setup_socket_options(client_fd);
-        set_non_blocking(client_fd);
-        
-        // Create connection object
-        auto conn = std::make_unique<Connection>();
-        conn->fd = client_fd;
+    
+    add_connection(reactor, client_fd, client_addr, stats);
+}
+
+Connection* HFTServer::add_connection(Reactor& reactor, int client_fd, const sockaddr_in& client_addr,
+                                      WorkerStats& stats) {
+    bool local = client_addr.sin_family == AF_UNIX;
+    
+    // Set client socket options
+    setup_socket_options(client_fd, !local);
+    set_non_blocking(client_fd);
+    
+    // Create connection object
+    auto conn = std::make_shared<Connection>();
+    conn->fd = client_fd;
+    if (local) {
+        conn->addr.sin_family = AF_UNIX;
+        conn->seqpacket = local_.seqpacket;
+    } else {
         conn->addr = client_addr;
-        conn->last_heartbeat = std::chrono::steady_clock::now();
-        conn->client_id = reinterpret_cast<uint64_t>(conn.get());
-        
+    }
+    conn->last_heartbeat = std::chrono::steady_clock::now();
+    conn->client_id = next_client_id_.fetch_add(1, std::memory_order_relaxed);
+    conn->outbound = OutboundQueue(outbound_.queue_bytes);
+    
+    // Store before registering: another worker may pick up the first event at once
+    Connection& stored = *conn;
+    {
+        std::lock_guard<std::mutex> lock(reactor.connections_mutex);
+        reactor.connections[client_fd] = std::move(conn);
+    }
+    notify_services(stored, true);
+    
+    if (backend_ == IoBackend::EPOLL) {
         // Add to epoll
         epoll_event ev{};
         ev.events = EPOLLIN | EPOLLET; // Edge-triggered
-        ev.data.ptr = conn.get();
+        if (sharded_) {
+            // Only fires once a full socket drains, so it can stay registered
+            ev.events |= EPOLLOUT;
+        } else {
+            // Shared reactor: only one worker may drain a connection at a time
+            ev.events |= EPOLLONESHOT;
+        }
+        ev.data.ptr = &stored;
         
-        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, client_fd, &ev) == -1) {
-            std::cerr << "Failed to add client to epoll: " << strerror(errno) << std::endl;
-            close(client_fd);
-            return;
+        if (epoll_ctl(reactor.epoll_fd, EPOLL_CTL_ADD, client_fd, &ev) == -1) {
+            HFT_LOG_ERROR("Failed to add client to epoll: {}", LogErrno{errno});
+            active_connections_.fetch_add(1); // Balanced by close_connection()
+            close_connection(reactor, stored);
+            return nullptr;
+        }
+    }
+    
+    count_connection(stats);
+    
+    if (local) {
+        HFT_LOG_INFO("New connection on {} (fd {})", local_.path, client_fd);
+        return &stored;
+    }
+    char client_ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &client_addr.sin_addr, client_ip, sizeof(client_ip));
+    HFT_LOG_INFO("New connection from {}:{}", client_ip, ntohs(client_addr.sin_port));
+    return &stored;
+}
+
+void HFTServer::count_connection(WorkerStats& stats) {
+    uint64_t active = active_connections_.fetch_add(1) + 1;
+    stats.connections_accepted.store(stats.connections_accepted.load(std::memory_order_relaxed) + 1,
+                                     std::memory_order_relaxed);
+    uint64_t peak = peak_connections_.load(std::memory_order_relaxed);
+    while (active > peak &&
+           !peak_connections_.compare_exchange_weak(peak, active, std::memory_order_relaxed)) {
+    }
+}
+
+void HFTServer::shm_thread(size_t thread_id) {
+    WorkerStats& stats = *worker_stats_[thread_id];
+    std::vector<std::shared_ptr<Connection>> pending_flush;
+    pending_flush_ = &pending_flush;
+    pin_worker(thread_id);
+    
+    std::vector<ShmSession> sessions(shm_.slot_count());
+    ShmSegmentHeader& header = shm_.header();
+    auto next_liveness_check = std::chrono::steady_clock::now();
+    
+    // Anything a client asked for since the last pass
+    auto ready = [&] {
+        for (size_t i = 0; i < sessions.size(); ++i) {
+            ShmSlotState state = shm_.slot(i).state.load(std::memory_order_acquire);
+            if (state == ShmSlotState::OPENING || state == ShmSlotState::CLIENT_CLOSED ||
+                (sessions[i].conn && sessions[i].inbound.readable() > 0)) {
+                return true;
+            }
+        }
+        return false;
+    };
+    
+    while (running_.load()) {
+        bool busy = false;
+        for (size_t i = 0; i < sessions.size(); ++i) {
+            busy |= poll_shm_session(i, sessions[i], stats);
+        }
+        flush_pending();
+        
+        // Clients that exited without closing their session
+        auto now = std::chrono::steady_clock::now();
+        if (now >= next_liveness_check) {
+            for (size_t i = 0; i < sessions.size(); ++i) {
+                ShmSlotHeader& slot = shm_.slot(i);
+                ShmSlotState state = slot.state.load(std::memory_order_acquire);
+                if (state == ShmSlotState::FREE || state == ShmSlotState::CLAIMED ||
+                    !ShmSegment::process_gone(slot.client_pid.load(std::memory_order_relaxed))) {
+                    continue;
+                }
+                if (sessions[i].conn) {
+                    close_shm_session(i, sessions[i], ShmSlotState::FREE);
+                } else {
+                    slot.client_pid.store(0, std::memory_order_relaxed);
+                    slot.state.store(ShmSlotState::FREE, std::memory_order_release);
+                }
+            }
+            next_liveness_check = now + std::chrono::seconds(1);
         }
         
-        // Store connection
-        {
-            std::lock_guard<std::mutex> lock(connections_mutex_);
-            connections_[client_fd] = std::move(conn);
-            stats_.total_connections++;
-            stats_.peak_connections = std::max(stats_.peak_connections, static_cast<uint64_t>(connections_.size()));
+        // Spinning never sleeps; otherwise a client write wakes us, or 1ms passes
+        if (!busy && !polling_.spin) {
+            header.server_event.wait(ready, 1000);
         }
+    }
+    
+    for (size_t i = 0; i < sessions.size(); ++i) {
+        if (sessions[i].conn) {
+            close_shm_session(i, sessions[i], ShmSlotState::SERVER_CLOSED);
+        }
+    }
+    pending_flush_ = nullptr;
+}
+
+bool HFTServer::poll_shm_session(size_t index, ShmSession& session, WorkerStats& stats) {
+    ShmSlotHeader& slot = shm_.slot(index);
+    ShmSlotState state = slot.state.load(std::memory_order_acquire);
+    if (!session.conn) {
+        if (state == ShmSlotState::OPENING) {
+            open_shm_session(index, session, stats);
+            return true;
+        }
+        if (state == ShmSlotState::CLIENT_CLOSED) {
+            // Given up before it was accepted
+            slot.client_pid.store(0, std::memory_order_relaxed);
+            slot.state.store(ShmSlotState::FREE, std::memory_order_release);
+            return true;
+        }
+        return false;
+    }
+    if (state == ShmSlotState::CLIENT_CLOSED) {
+        close_shm_session(index, session, ShmSlotState::FREE);
+        return true;
+    }
+    
+    // One ring read per pass, so a busy client cannot starve the other slots
+    Connection& conn = *session.conn;
+    bool busy = false;
+    if (session.inbound.readable() > 0) {
+        ReceiveBuffer& buffer = conn.recv_buffer;
+        buffer.compact(BUFFER_SIZE);
+        buffer.commit(session.inbound.read(buffer.write_ptr(), buffer.writable()));
+        busy = true;
         
-        std::cout << "New connection from " << inet_ntoa(client_addr.sin_addr) 
-                  << ":" << ntohs(client_addr.sin_port) << std::endl;
+        size_t frame_length;
+        while ((frame_length = wire::frame_length(buffer.read_ptr(), buffer.readable())) != 0) {
+            if (frame_length == wire::INVALID_FRAME) {
+                HFT_LOG_WARN("Invalid frame length in shared-memory slot {}", index);
+                close_shm_session(index, session, ShmSlotState::SERVER_CLOSED);
+                return true;
+            }
+            dispatch_frame(buffer.read_ptr(), frame_length, conn, stats);
+            buffer.consume(frame_length);
+        }
+    }
+    
+    bool discarding;
+    {
+        // The ring was full: retry now that the client may have read
+        std::lock_guard<std::mutex> lock(conn.send_mutex);
+        discarding = conn.discarding;
+        if (conn.want_write && !discarding) {
+            conn.want_write = false;
+            flush_locked(conn);
+        }
+    }
+    if (discarding) {
+        close_shm_session(index, session, ShmSlotState::SERVER_CLOSED);
+        return true;
+    }
+    return busy;
+}
+
+void HFTServer::open_shm_session(size_t index, ShmSession& session, WorkerStats& stats) {
+    ShmSlotHeader& slot = shm_.slot(index);
+    auto conn = std::make_shared<Connection>();
+    conn->last_heartbeat = std::chrono::steady_clock::now();
+    conn->client_id = next_client_id_.fetch_add(1, std::memory_order_relaxed);
+    conn->outbound = OutboundQueue(outbound_.queue_bytes);
+    conn->shm_slot = static_cast<int>(index);
+    conn->shm_outbound = shm_.outbound(index);
+    session.conn = std::move(conn);
+    session.inbound = shm_.inbound(index);
+    notify_services(*session.conn, true);
+    count_connection(stats);
+    
+    // The client may have given up meanwhile
+    ShmSlotState expected = ShmSlotState::OPENING;
+    if (!slot.state.compare_exchange_strong(expected, ShmSlotState::OPEN, std::memory_order_acq_rel)) {
+        close_shm_session(index, session, ShmSlotState::FREE);
+        return;
+    }
+    slot.client_event.notify();
+    HFT_LOG_INFO("New shared-memory session in slot {} from pid {}", index,
+                 slot.client_pid.load(std::memory_order_relaxed));
+}
+
+void HFTServer::close_shm_session(size_t index, ShmSession& session, ShmSlotState next) {
+    Connection& conn = *session.conn;
+    notify_services(conn, false);
+    {
+        // Under send_mutex so no flush writes the ring once the slot can be reused
+        std::lock_guard<std::mutex> lock(conn.send_mutex);
+        conn.closed = true;
+    }
+    active_connections_.fetch_sub(1);
+    
+    // A client that closed its side meanwhile leaves the slot for us to free
+    ShmSlotHeader& slot = shm_.slot(index);
+    ShmSlotState expected = ShmSlotState::OPEN;
+    if (next == ShmSlotState::SERVER_CLOSED &&
+        slot.state.compare_exchange_strong(expected, ShmSlotState::SERVER_CLOSED, std::memory_order_acq_rel)) {
+        slot.client_event.notify();
+    } else {
+        slot.client_pid.store(0, std::memory_order_relaxed);
+        slot.state.store(ShmSlotState::FREE, std::memory_order_release);
+    }
+    session = ShmSession{};
+    HFT_LOG_INFO("Shared-memory session in slot {} closed", index);
 }
 
 void HFTServer::worker_thread(size_t thread_id) {
+    Reactor& reactor = *reactors_[sharded_ ? thread_id : 0];
+    WorkerStats& stats = *worker_stats_[thread_id];
     std::vector<epoll_event> events(MAX_EVENTS);
+    std::vector<std::shared_ptr<Connection>> pending_flush;
+    pending_flush.reserve(MAX_EVENTS);
+    pending_flush_ = &pending_flush;
+    pin_worker(thread_id);
+    
+    // Spinning workers never sleep in the kernel; otherwise wake at least every 1ms
+    int timeout_ms = polling_.spin ? 0 : 1;
     
     while (running_.load()) {
-        int nfds = epoll_wait(epoll_fd_, events.data(), MAX_EVENTS, 1); // 1ms timeout
+        int nfds = epoll_wait(reactor.epoll_fd, events.data(), MAX_EVENTS, timeout_ms);
         
         if (nfds == -1) {
             if (errno == EINTR) continue;
-            std::cerr << "Worker " << thread_id << " epoll_wait failed: " << strerror(errno) << std::endl;
+            HFT_LOG_ERROR("Worker {} epoll_wait failed: {}", thread_id, LogErrno{errno});
             break;
         }
         
         for (int i = 0; i < nfds; ++i) {
             if (events[i].data.ptr == nullptr) {
                 // This is the server socket - new connection
-                accept_connections();
+                accept_connections(reactor, reactor.listen_fd, stats);
+            } else if (events[i].data.ptr == &local_listen_fd_) {
+                accept_connections(reactor, local_listen_fd_, stats);
             } else {
                 // This is a client connection
                 auto* conn = static_cast<Connection*>(events[i].data.ptr);
-                handle_client_events(conn->fd);
+                handle_client_events(reactor, conn->fd, events[i].events, stats);
             }
         }
+        
+        flush_pending();
     }
+    
+    flush_pending();
+    pending_flush_ = nullptr;
 }
 
-void HFTServer::handle_client_events(int client_fd) {
+void HFTServer::handle_client_events(Reactor& reactor, int client_fd, uint32_t events, WorkerStats& stats) {
     // Find the connection for this file descriptor
-    Connection* conn = nullptr;
+    std::shared_ptr<Connection> owner;
     {
-        std::lock_guard<std::mutex> lock(connections_mutex_);
-        auto it = connections_.find(client_fd);
-        if (it == connections_.end()) {
+        std::lock_guard<std::mutex> lock(reactor.connections_mutex);
+        auto it = reactor.connections.find(client_fd);
+        if (it == reactor.connections.end()) {
             return; // Connection not found
         }
-        conn = it->second.get();
+        owner = it->second;
     }
+    Connection* conn = owner.get();
     
-    if (!conn) {
-        return;
+    // A flush that hit a full socket re-arms the registration, so another worker may still be in here
+    if (!sharded_ && conn->handling.exchange(true, std::memory_order_acquire)) {
+        return; // It re-arms again on its way out
+    }
+    
+    if (events & EPOLLOUT) {
+        // Socket drained: resume a blocked flush
+        flush_connection(*conn);
     }
     
-    // Process all available data from the client
+    // Drain the socket into the connection's buffer, extracting every complete frame
+    ReceiveBuffer& buffer = conn->recv_buffer;
     while (true) {
-        ssize_t bytes_read = recv(client_fd, recv_buffer_.data(), recv_buffer_.size(), MSG_DONTWAIT);
+        buffer.compact(BUFFER_SIZE);
+        if (buffer.writable() == 0) {
+            HFT_LOG_WARN("Receive buffer overflow on fd {}", client_fd);
+            close_connection(reactor, *conn);
+            return;
+        }
+        
+        // A record that does not fit is cut short; MSG_TRUNC reports its real length
+        int flags = MSG_DONTWAIT | (conn->seqpacket ? MSG_TRUNC : 0);
+        ssize_t bytes_read = recv(client_fd, buffer.write_ptr(), buffer.writable(), flags);
         
         if (bytes_read == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
             if (errno == EAGAIN || errno == EWOULDBLOCK) {
                 break; // No more data
             }
-            std::cerr << "Recv failed: " << strerror(errno) << std::endl;
+            HFT_LOG_WARN("Recv failed on fd {}: {}", client_fd, LogErrno{errno});
+            close_connection(reactor, *conn);
             return;
         }
         
         if (bytes_read == 0) {
             // Client disconnected
-            close_connection(*conn);
+            close_connection(reactor, *conn);
             return;
         }
         
-        // Process message - check for different message types
-        // Fix: Cast bytes_read to size_t to avoid signed/unsigned comparison warning
-        if (static_cast<size_t>(bytes_read) >= sizeof(Message)) {
-            const Message* msg = reinterpret_cast<const Message*>(recv_buffer_.data());
-            std::cout << "Processing message type: " << static_cast<int>(msg->message_type) 
-                      << " size: " << bytes_read << " bytes" << std::endl;
-            
-            // Check if this is an OrderMessage (larger than base Message)
-            if (msg->message_type == MessageType::ORDER_NEW || 
-                msg->message_type == MessageType::ORDER_CANCEL || 
-                msg->message_type == MessageType::ORDER_REPLACE) {
-                // Fix: Cast bytes_read to size_t to avoid signed/unsigned comparison warning
-                if (static_cast<size_t>(bytes_read) >= sizeof(OrderMessage)) {
-                    const OrderMessage* order_msg = reinterpret_cast<const OrderMessage*>(recv_buffer_.data());
-                    process_client_message(*order_msg, *conn);
-                } else {
-                    std::cout << "Incomplete order message: " << bytes_read << " bytes (need " 
-                              << sizeof(OrderMessage) << ")" << std::endl;
-                }
-            } else if (msg->message_type == MessageType::MARKET_DATA) {
-                // Fix: Cast bytes_read to size_t to avoid signed/unsigned comparison warning
-                if (static_cast<size_t>(bytes_read) >= sizeof(MarketDataMessage)) {
-                    const MarketDataMessage* market_msg = reinterpret_cast<const MarketDataMessage*>(recv_buffer_.data());
-                    process_client_message(*market_msg, *conn);
-                } else {
-                    std::cout << "Incomplete market data message: " << bytes_read << " bytes (need " 
-                              << sizeof(MarketDataMessage) << ")" << std::endl;
-                }
-            } else {
-                // Regular message
-                process_client_message(*msg, *conn);
-            }
-        } else {
-            std::cout << "Received incomplete message: " << bytes_read << " bytes (need at least " 
-                      << sizeof(Message) << ")" << std::endl;
+        if (static_cast<size_t>(bytes_read) > buffer.writable()) {
+            HFT_LOG_WARN("Oversized record of {} bytes on fd {}", bytes_read, client_fd);
+            close_connection(reactor, *conn);
+            return;
         }
-    }
-}
-
-void HFTServer::process_client_message(const Message& msg, Connection& conn) {
-    auto start_time = std::chrono::high_resolution_clock::now();
-    
-    std::cout << "Processing base message type: " << static_cast<int>(msg.message_type) << std::endl;
-    
-    // Find appropriate service
-    std::shared_ptr<IMessageService> service;
-    {
-        std::lock_guard<std::mutex> lock(services_mutex_);
-        auto it = services_.find(msg.message_type);
-        if (it != services_.end()) {
-            service = it->second;
+        
+        buffer.commit(static_cast<size_t>(bytes_read));
+        if (!process_frames(reactor, *conn, stats)) {
+            return;
         }
     }
     
-    if (service) {
-        service->process_message(msg, conn);
-    }
-    
-    // Update statistics
-    auto end_time = std::chrono::high_resolution_clock::now();
-    auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time);
-    
-    {
-        std::lock_guard<std::mutex> lock(stats_mutex_);
-        stats_.total_messages_processed++;
-        
-        // Update average latency (exponential moving average)
-        constexpr double alpha = 0.01; // Smoothing factor
-        double current_latency_us = latency.count() / 1000.0;
-        stats_.avg_latency_us = alpha * current_latency_us + (1.0 - alpha) * stats_.avg_latency_us;
+    if (!sharded_) {
+        // Release first: an event that fires as soon as we re-arm must not be turned away
+        conn->handling.store(false, std::memory_order_release);
+        std::lock_guard<std::mutex> lock(conn->send_mutex);
+        if (!conn->closed) {
+            arm_connection(reactor, *conn);
+        }
     }
 }
 
-void HFTServer::process_client_message(const OrderMessage& msg, Connection& conn) {
-    auto start_time = std::chrono::high_resolution_clock::now();
-    
-    std::cout << "Processing ORDER message: " << msg.symbol.data() 
-              << " " << (msg.side == OrderSide::BUY ? "BUY" : "SELL")
-              << " " << msg.quantity << " @ " << msg.price << std::endl;
-    
-    // Find appropriate service
-    std::shared_ptr<IMessageService> service;
-    {
-        std::lock_guard<std::mutex> lock(services_mutex_);
-        auto it = services_.find(msg.message_type);
-        if (it != services_.end()) {
-            service = it->second;
-        }
-    }
-    
-    if (service) {
-        service->process_message(msg, conn);
-    }
-    
-    // Update statistics
-    auto end_time = std::chrono::high_resolution_clock::now();
-    auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time);
-    
-    {
-        std::lock_guard<std::mutex> lock(stats_mutex_);
-        stats_.total_messages_processed++;
-        
-        // Update average latency (exponential moving average)
-        constexpr double alpha = 0.01; // Smoothing factor
-        double current_latency_us = latency.count() / 1000.0;
-        stats_.avg_latency_us = alpha * current_latency_us + (1.0 - alpha) * stats_.avg_latency_us;
+void HFTServer::arm_connection(Reactor& reactor, Connection& conn) {
+    // Shared reactor: re-arm the one-shot registration, watching for space only while output is blocked
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLET | EPOLLONESHOT;
+    if (conn.want_write) {
+        ev.events |= EPOLLOUT;
     }
+    ev.data.ptr = &conn;
+    epoll_ctl(reactor.epoll_fd, EPOLL_CTL_MOD, conn.fd, &ev);
 }
 
-void HFTServer::process_client_message(const MarketDataMessage& msg, Connection& conn) {
-    auto start_time = std::chrono::high_resolution_clock::now();
+thread_local HFTServer::UringWorker* HFTServer::current_uring_ = nullptr;
+thread_local std::vector<std::shared_ptr<Connection>>* HFTServer::pending_flush_ = nullptr;
+
+void HFTServer::uring_worker_thread(size_t thread_id) {
+    Reactor& reactor = *reactors_[sharded_ ? thread_id : 0];
+    WorkerStats& stats = *worker_stats_[thread_id];
     
-    std::cout << "Processing MARKET_DATA message: " << msg.symbol.data() 
-              << " Bid: " << msg.bid_price << " Ask: " << msg.ask_price << std::endl;
+    pin_worker(thread_id);
     
-    // Find appropriate service
-    std::shared_ptr<IMessageService> service;
-    {
-        std::lock_guard<std::mutex> lock(services_mutex_);
-        auto it = services_.find(msg.message_type);
-        if (it != services_.end()) {
-            service = it->second;
-        }
+    // The ring is created here so this thread is its single issuer
+    UringWorker* worker = uring_workers_[thread_id].get();
+    if (!worker->ring.init(UringWorker::RING_ENTRIES) ||
+        !worker->ring.setup_buffer_ring(0, UringWorker::RECV_BUFFERS, BUFFER_SIZE)) {
+        HFT_LOG_ERROR("Worker {} io_uring setup failed: {}", thread_id, LogErrno{errno});
+        return;
     }
-    
-    if (service) {
-        service->process_message(msg, conn);
+    current_uring_ = worker;
+    std::vector<std::shared_ptr<Connection>> pending_flush;
+    pending_flush.reserve(UringWorker::RING_ENTRIES);
+    pending_flush_ = &pending_flush;
+    worker->arm_accept(reactor.listen_fd);
+    if (local_listen_fd_ != -1) {
+        worker->arm_accept(local_listen_fd_, UringWorker::OP_ACCEPT_LOCAL);
     }
     
-    // Update statistics
-    auto end_time = std::chrono::high_resolution_clock::now();
-    auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time);
+    // Spinning workers only reap completions; otherwise wait up to 1ms for one
+    unsigned wait_nr = polling_.spin ? 0 : 1;
+    unsigned timeout_us = polling_.spin ? 0 : 1000;
     
-    {
-        std::lock_guard<std::mutex> lock(stats_mutex_);
-        stats_.total_messages_processed++;
+    while (running_.load()) {
+        // One io_uring_enter submits every queued recv, accept and send, then waits
+        int ret = worker->ring.submit_and_wait(wait_nr, timeout_us);
+        if (ret < 0) {
+            HFT_LOG_ERROR("Worker {} io_uring_enter failed: {}", thread_id, LogErrno{-ret});
+            break;
+        }
         
-        // Update average latency (exponential moving average)
-        constexpr double alpha = 0.01; // Smoothing factor
-        double current_latency_us = latency.count() / 1000.0;
-        stats_.avg_latency_us = alpha * current_latency_us + (1.0 - alpha) * stats_.avg_latency_us;
+        worker->ring.for_each_cqe([&](const io_uring_cqe& cqe) {
+            handle_uring_completion(reactor, *worker, cqe, stats);
+        });
+        
+        if (worker->has_handoff.load(std::memory_order_acquire)) {
+            resume_handoffs(*worker);
+        }
+        
+        // Sends go out with the next io_uring_enter
+        flush_pending();
     }
-}
-
-void HFTServer::send_response(Connection& conn, const Message& response) {
-    // Zero-copy send using pre-allocated buffer
-    memcpy(send_buffer_.data(), &response, sizeof(Message));
     
-    ssize_t bytes_sent = send(conn.fd, send_buffer_.data(), sizeof(Message), MSG_NOSIGNAL);
-    if (bytes_sent == -1) {
-        std::cerr << "Send failed: " << strerror(errno) << std::endl;
-    }
+    // Flush responses queued by the last batch
+    flush_pending();
+    worker->ring.submit_and_wait(0, 0);
+    pending_flush_ = nullptr;
+    current_uring_ = nullptr;
 }
 
-void HFTServer::close_connection(Connection& conn) {
-    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, conn.fd, nullptr);
-    close(conn.fd);
-    
+void HFTServer::resume_handoffs(UringWorker& worker) {
+    std::vector<std::shared_ptr<Connection>> handed;
     {
-        std::lock_guard<std::mutex> lock(connections_mutex_);
-        connections_.erase(conn.fd);
+        std::lock_guard<std::mutex> lock(worker.handoff_mutex);
+        handed.swap(worker.handoff);
+        worker.has_handoff.store(false, std::memory_order_relaxed);
+    }
+    for (auto& conn : handed) {
+        // Queued as a send on this ring; the kernel waits for the socket to drain
+        std::lock_guard<std::mutex> lock(conn->send_mutex);
+        if (!conn->sending) {
+            conn->want_write = false;
+            flush_locked(*conn);
+        }
     }
 }
 
-void HFTServer::setup_socket_options(int sock_fd) {
-    // Set SO_REUSEADDR
-    int opt = 1;
-    setsockopt(sock_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-    
-    // Set TCP_NODELAY for low latency
-    //setsockopt(sock_fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
-    setsockopt(sock_fd, IPPROTO_TCP, O_NDELAY, &opt, sizeof(opt));
+void HFTServer::handle_uring_completion(Reactor& reactor, UringWorker& worker, const io_uring_cqe& cqe,
+                                        WorkerStats& stats) {
+    bool more = cqe.flags & IORING_CQE_F_MORE;
     
-    // Set SO_KEEPALIVE
-    setsockopt(sock_fd, SOL_SOCKET, SO_KEEPALIVE, &opt, sizeof(opt));
-    
-    // Set send and receive buffer sizes
-    int send_buf_size = 1024 * 1024; // 1MB
-    int recv_buf_size = 1024 * 1024; // 1MB
-    setsockopt(sock_fd, SOL_SOCKET, SO_SNDBUF, &send_buf_size, sizeof(send_buf_size));
-    setsockopt(sock_fd, SOL_SOCKET, SO_RCVBUF, &recv_buf_size, sizeof(recv_buf_size));
-}
-
-void HFTServer::set_non_blocking(int sock_fd) {
-    int flags = fcntl(sock_fd, F_GETFL, 0);
-    fcntl(sock_fd, F_SETFL, flags | O_NONBLOCK);
-}
+    switch (cqe.user_data & UringWorker::OP_MASK) {
+        case UringWorker::OP_ACCEPT:
+        case UringWorker::OP_ACCEPT_LOCAL: {
+            bool local = (cqe.user_data & UringWorker::OP_MASK) == UringWorker::OP_ACCEPT_LOCAL;
+            if (cqe.res >= 0) {
+                sockaddr_in client_addr{};
+                socklen_t client_len = sizeof(client_addr);
+                getpeername(cqe.res, reinterpret_cast<sockaddr*>(&client_addr), &client_len);
+                if (Connection* conn = add_connection(reactor, cqe.res, client_addr, stats)) {
+                    conn->uring_worker = worker.index;
+                    worker.arm_recv(*conn);
+                }
+            } else if (cqe.res != -ECANCELED) {
+                HFT_LOG_ERROR("Accept failed: {}", LogErrno{-cqe.res});
+            }
+            if (!more && running_.load()) {
+                if (local) {
+                    worker.arm_accept(local_listen_fd_, UringWorker::OP_ACCEPT_LOCAL);
+                } else {
+                    worker.arm_accept(reactor.listen_fd);
+                }
+            }
+            break;
+        }
+        case UringWorker::OP_RECV: {
+            auto* conn = reinterpret_cast<Connection*>(cqe.user_data & ~UringWorker::OP_MASK);
+            bool has_buffer = cqe.flags & IORING_CQE_F_BUFFER;
+            uint16_t buffer_id = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+            
+            if (!worker.closing.empty() && worker.closing.count(conn)) {
+                // Late data for a connection already closed
+                if (has_buffer) {
+                    worker.ring.recycle_buffer(buffer_id);
+                }
+                if (!more) {
+                    worker.closing.erase(conn);
+                }
+                break;
+            }
+            
+            if (cqe.res > 0) {
+                // Append to the connection's buffer so frames can span receives
+                size_t bytes_read = static_cast<size_t>(cqe.res);
+                ReceiveBuffer& buffer = conn->recv_buffer;
+                buffer.compact(bytes_read);
+                bool fits = buffer.writable() >= bytes_read;
+                if (fits) {
+                    std::memcpy(buffer.write_ptr(), worker.ring.buffer(buffer_id), bytes_read);
+                    buffer.commit(bytes_read);
+                }
+                worker.ring.recycle_buffer(buffer_id);
+                
+                if (!fits) {
+                    HFT_LOG_WARN("Receive buffer overflow on fd {}", conn->fd);
+                    close_connection(reactor, *conn);
+                } else {
+                    process_frames(reactor, *conn, stats);
+                }
+            } else if (cqe.res == 0) {
+                // Client disconnected
+                close_connection(reactor, *conn);
+            } else if (cqe.res != -ENOBUFS) {
+                HFT_LOG_WARN("Recv failed on fd {}: {}", conn->fd, LogErrno{-cqe.res});
+                close_connection(reactor, *conn);
+            }
+            
+            if (!more) {
+                // Final completion: free a connection closed above, otherwise keep receiving
+                if (worker.closing.erase(conn) == 0) {
+                    worker.arm_recv(*conn);
+                }
+            }
+            break;
+        }
+        case UringWorker::OP_WRITABLE: {
+            auto* conn = reinterpret_cast<Connection*>(cqe.user_data & ~UringWorker::OP_MASK);
+            auto it = worker.blocked.find(conn);
+            std::shared_ptr<Connection> owner = std::move(it->second);
+            worker.blocked.erase(it);
+            
+            // Socket drained (or shut down): resume the flush
+            std::lock_guard<std::mutex> lock(conn->send_mutex);
+            conn->want_write = false;
+            flush_locked(*conn);
+            break;
+        }
+        case UringWorker::OP_SEND: {
+            auto* conn = reinterpret_cast<Connection*>(cqe.user_data & ~UringWorker::OP_MASK);
+            auto it = worker.sending.find(conn);
+            std::shared_ptr<Connection> owner = std::move(it->second);
+            worker.sending.erase(it);
+            
+            std::lock_guard<std::mutex> lock(conn->send_mutex);
+            conn->sending = false;
+            conn->outbound.unpin();
+            if (cqe.res > 0) {
+                // Send what is left, and whatever was queued meanwhile
+                conn->outbound.complete(static_cast<size_t>(cqe.res));
+                conn->want_write = false;
+                flush_locked(*conn);
+            } else if (cqe.res == -EAGAIN && !conn->closed) {
+                worker.watch_writable(*conn); // The kernel did not wait; poll instead
+            } else if (!conn->closed && !conn->discarding) {
+                // The receive side sees the failure and closes the connection
+                HFT_LOG_WARN("Send failed on fd {}: {}", conn->fd, LogErrno{-cqe.res});
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+bool HFTServer::process_frames(Reactor& reactor, Connection& conn, WorkerStats& stats) {
+    // Pull out every complete frame; a partial tail stays for the next read
+    ReceiveBuffer& buffer = conn.recv_buffer;
+    size_t frame_length;
+    while ((frame_length = wire::frame_length(buffer.read_ptr(), buffer.readable())) != 0) {
+        if (frame_length == wire::INVALID_FRAME) {
+            HFT_LOG_WARN("Invalid frame length on fd {}", conn.fd);
+            close_connection(reactor, conn);
+            return false;
+        }
+        dispatch_frame(buffer.read_ptr(), frame_length, conn, stats);
+        buffer.consume(frame_length);
+    }
+    if (conn.seqpacket && buffer.readable() != 0) {
+        HFT_LOG_WARN("Record ends mid-frame on fd {}", conn.fd);
+        close_connection(reactor, conn);
+        return false;
+    }
+    return true;
+}
+
+void HFTServer::dispatch_frame(const uint8_t* frame, size_t length, Connection& conn,
+                               WorkerStats& stats) {
+    switch (wire::peek_type(frame)) {
+        case MessageType::ORDER_NEW:
+        case MessageType::ORDER_CANCEL:
+        case MessageType::ORDER_REPLACE: {
+            OrderMessage order;
+            if (wire::decode(frame, length, order)) {
+                InstrumentRegistry::get_instance().resolve(order);
+                process_client_message(order, conn, stats);
+                return;
+            }
+            break;
+        }
+        case MessageType::MARKET_DATA:
+        case MessageType::MARKET_DATA_SUBSCRIBE:
+        case MessageType::MARKET_DATA_UNSUBSCRIBE: {
+            MarketDataMessage data;
+            if (wire::decode(frame, length, data)) {
+                InstrumentRegistry::get_instance().resolve(data);
+                process_client_message(data, conn, stats);
+                return;
+            }
+            break;
+        }
+        case MessageType::MARKET_DATA_RETRANSMIT:
+        case MessageType::MARKET_DATA_SNAPSHOT: {
+            RetransmitMessage request;
+            if (wire::decode(frame, length, request)) {
+                process_client_message(request, conn, stats);
+                return;
+            }
+            break;
+        }
+        default: {
+            Message msg;
+            if (wire::decode(frame, length, msg)) {
+                process_client_message(msg, conn, stats);
+                return;
+            }
+            break;
+        }
+    }
+    
+    HFT_LOG_WARN("Truncated frame: type {} length {} bytes", wire::peek_type(frame), length);
+}
+
+void HFTServer::process_client_message(const Message& msg, Connection& conn, WorkerStats& stats) {
+    uint64_t start_ns = Clock::monotonic_ns();
+    
+    HFT_LOG_DEBUG("Processing base message type: {}", msg.message_type);
+    
+    invoke_service(msg, conn);
+    
+    record_latency(stats, msg.message_type, start_ns);
+}
+
+void HFTServer::process_client_message(const OrderMessage& msg, Connection& conn, WorkerStats& stats) {
+    uint64_t start_ns = Clock::monotonic_ns();
+    
+    HFT_LOG_DEBUG("Processing ORDER message: {} {} {} @ {}", msg.symbol,
+                  msg.side == OrderSide::BUY ? "BUY" : "SELL", msg.quantity, msg.price);
+    
+    invoke_service(msg, conn);
+    
+    record_latency(stats, msg.message_type, start_ns);
+}
+
+void HFTServer::process_client_message(const MarketDataMessage& msg, Connection& conn, WorkerStats& stats) {
+    uint64_t start_ns = Clock::monotonic_ns();
+    
+    HFT_LOG_DEBUG("Processing MARKET_DATA message: {} Bid: {} Ask: {}", msg.symbol,
+                  msg.bid_price, msg.ask_price);
+    
+    invoke_service(msg, conn);
+    
+    record_latency(stats, msg.message_type, start_ns);
+}
+
+size_t HFTServer::stats_type(MessageType type) {
+    switch (type) {
+        case MessageType::ORDER_NEW:     return STATS_ORDER_NEW;
+        case MessageType::ORDER_CANCEL:  return STATS_ORDER_CANCEL;
+        case MessageType::ORDER_REPLACE: return STATS_ORDER_REPLACE;
+        case MessageType::MARKET_DATA:   return STATS_MARKET_DATA;
+        default:                         return STATS_OTHER;
+    }
+}
+
+const char* HFTServer::stats_type_name(size_t type) {
+    switch (type) {
+        case STATS_ORDER_NEW:     return "ORDER_NEW";
+        case STATS_ORDER_CANCEL:  return "ORDER_CANCEL";
+        case STATS_ORDER_REPLACE: return "ORDER_REPLACE";
+        case STATS_MARKET_DATA:   return "MARKET_DATA";
+        default:                  return "OTHER";
+    }
+}
+
+void HFTServer::record_latency(WorkerStats& stats, MessageType type, uint64_t start_ns) {
+    uint64_t latency_ns = Clock::monotonic_ns() - start_ns;
+    
+    // Single writer per slot: plain load/store instead of a locked increment
+    stats.messages_processed.store(stats.messages_processed.load(std::memory_order_relaxed) + 1,
+                                   std::memory_order_relaxed);
+    stats.latency[stats_type(type)].record(latency_ns);
+}
+
+void HFTServer::invoke_service(const Message& msg, Connection& conn) {
+    const ServiceTable* table = service_table_.load(std::memory_order_acquire);
+    if (!table) {
+        return;
+    }
+    
+    const ServiceEntry& entry = table->entries[static_cast<uint8_t>(msg.message_type)];
+    switch (entry.kind) {
+        case ServiceKind::ORDER:
+            static_cast<OrderService*>(entry.service)->process_message(msg, conn);
+            break;
+        case ServiceKind::MARKET_DATA:
+            static_cast<MarketDataService*>(entry.service)->process_message(msg, conn);
+            break;
+        case ServiceKind::GENERIC:
+            entry.service->process_message(msg, conn);
+            break;
+        case ServiceKind::NONE:
+            break;
+    }
+}
+
+void HFTServer::send_response(Connection& conn, const Message& response) {
+    uint8_t frame[wire::MAX_FRAME_SIZE];
+    send_frame(conn, frame, wire::encode(response, frame));
+}
+
+void HFTServer::send_response(Connection& conn, const OrderMessage& response) {
+    uint8_t frame[wire::MAX_FRAME_SIZE];
+    send_frame(conn, frame, wire::encode(response, frame));
+}
+
+void HFTServer::send_response(Connection& conn, const FillMessage& response) {
+    uint8_t frame[wire::MAX_FRAME_SIZE];
+    send_frame(conn, frame, wire::encode(response, frame));
+}
+
+void HFTServer::send_response(Connection& conn, const MarketDataMessage& response) {
+    uint8_t frame[wire::MAX_FRAME_SIZE];
+    send_frame(conn, frame, wire::encode(response, frame));
+}
+
+void HFTServer::send_response(Connection& conn, const RetransmitMessage& response) {
+    uint8_t frame[wire::MAX_FRAME_SIZE];
+    send_frame(conn, frame, wire::encode(response, frame));
+}
+
+void HFTServer::send_shared(Connection& conn, SharedFrame* frame, uint64_t* position) {
+    send_frame(conn, frame->data(), frame->length(), frame, position);
+}
+
+void HFTServer::send_frame(Connection& conn, const uint8_t* frame, size_t length, SharedFrame* shared,
+                           uint64_t* position) {
+    bool schedule = false;
+    {
+        std::lock_guard<std::mutex> lock(conn.send_mutex);
+        if (conn.closed || conn.discarding) {
+            if (shared) {
+                shared->release();
+            }
+            return;
+        }
+        if (!queue_frame(conn, frame, length, shared, position)) {
+            return;
+        }
+        // Otherwise a listed flush or the wait for socket space picks the frame up
+        schedule = !conn.flush_scheduled && !conn.want_write;
+        conn.flush_scheduled = conn.flush_scheduled || schedule;
+    }
+    
+    if (!schedule) {
+        return;
+    }
+    if (pending_flush_) {
+        pending_flush_->push_back(conn.shared_from_this());
+    } else {
+        flush_connection(conn); // Not a worker thread: write through
+    }
+}
+
+bool HFTServer::queue_frame(Connection& conn, const uint8_t* frame, size_t length, SharedFrame* shared,
+                            uint64_t* position) {
+    // Lagging: supersede the stream's pending update rather than grow the backlog
+    if (position && conn.want_write && conn.outbound.replace(*position, shared)) {
+        frames_conflated_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    
+    auto push = [&] {
+        if (!shared) {
+            return conn.outbound.push(frame, length);
+        }
+        if (!conn.outbound.push(shared)) {
+            return false;
+        }
+        if (position) {
+            *position = conn.outbound.back_position();
+        }
+        return true;
+    };
+    if (push()) {
+        return true;
+    }
+    
+    // Full before the end of the iteration: make room now unless the socket is full too
+    if (!conn.want_write) {
+        flush_locked(conn, true);
+        if (push()) {
+            return true;
+        }
+    }
+    
+    // Slow consumer: market data may be conflated or dropped, order traffic never
+    bool market_data = wire::peek_type(frame) == MessageType::MARKET_DATA;
+    if (market_data && outbound_.policy == SlowConsumerPolicy::CONFLATE && shared &&
+        conn.outbound.conflate(shared)) {
+        frames_conflated_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    if (shared) {
+        shared->release();
+    }
+    if (market_data && outbound_.policy != SlowConsumerPolicy::DISCONNECT) {
+        frames_dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    
+    HFT_LOG_WARN("Slow consumer on fd {}: {} bytes queued, disconnecting", conn.fd, conn.outbound.size());
+    slow_consumer_disconnects_.fetch_add(1, std::memory_order_relaxed);
+    
+    // The worker reading the connection sees EOF and closes it as usual; the shared-memory thread checks the flag
+    if (conn.shm_slot < 0) {
+        shutdown(conn.fd, SHUT_RDWR);
+    }
+    conn.discarding = true;
+    return false;
+}
+
+void HFTServer::flush_pending() {
+    // One send per connection, however many frames this iteration queued for it
+    for (auto& conn : *pending_flush_) {
+        flush_connection(*conn);
+    }
+    pending_flush_->clear();
+}
+
+void HFTServer::flush_connection(Connection& conn) {
+    std::lock_guard<std::mutex> lock(conn.send_mutex);
+    conn.flush_scheduled = false;
+    flush_locked(conn);
+}
+
+void HFTServer::flush_locked(Connection& conn, bool immediate) {
+    if (conn.closed || conn.discarding || conn.outbound.empty() || conn.sending) {
+        return; // A send in flight resumes the flush when it completes
+    }
+    if (conn.shm_slot >= 0) {
+        flush_shm_locked(conn);
+        return;
+    }
+    if (current_uring_ && !conn.seqpacket && !immediate) {
+        current_uring_->send(conn); // Submitted with the worker's next io_uring_enter
+        return;
+    }
+    
+    iovec iov[OutboundQueue::MAX_IOVECS];
+    msghdr msg{};
+    msg.msg_iov = iov;
+    bool drained;
+    do {
+        // More than MAX_IOVECS frames only takes another call if the socket took everything
+        int count = conn.outbound.gather(iov, OutboundQueue::MAX_IOVECS);
+        size_t gathered = 0;
+        for (int i = 0; i < count; ++i) {
+            gathered += iov[i].iov_len;
+        }
+        ssize_t bytes_sent;
+        if (conn.seqpacket) {
+            bytes_sent = send_records(conn.fd, iov, count, gathered);
+        } else {
+            msg.msg_iovlen = static_cast<size_t>(count);
+            bytes_sent = sendmsg(conn.fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        }
+        if (bytes_sent == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            HFT_LOG_WARN("Send failed on fd {}: {}", conn.fd, LogErrno{errno});
+        }
+        conn.outbound.complete(bytes_sent > 0 ? static_cast<size_t>(bytes_sent) : 0);
+        drained = bytes_sent > 0 && static_cast<size_t>(bytes_sent) == gathered;
+    } while (drained && !conn.outbound.empty());
+    
+    bool was_blocked = conn.want_write;
+    conn.want_write = !conn.outbound.empty();
+    if (!conn.want_write || was_blocked) {
+        return;
+    }
+    
+    // Socket full: resume once it drains instead of retrying
+    if (backend_ == IoBackend::IO_URING) {
+        if (current_uring_) {
+            current_uring_->watch_writable(conn);
+        } else if (conn.uring_worker >= 0) {
+            // The ring belongs to its worker; that worker queues the rest as a send
+            uring_workers_[conn.uring_worker]->hand_off(conn.shared_from_this());
+        } else {
+            conn.want_write = false;
+        }
+    } else if (!sharded_) {
+        arm_connection(*reactors_[0], conn); // Sharded registrations always include EPOLLOUT
+    }
+}
+
+ssize_t HFTServer::send_records(int fd, const iovec* iov, int count, size_t& offered) {
+    // Split merged frames back apart so each is its own record; one sendmmsg still sends them all
+    iovec frames[MAX_RECORDS];
+    mmsghdr records[MAX_RECORDS];
+    int record_count = 0;
+    offered = 0;
+    for (int i = 0; i < count && record_count < MAX_RECORDS; ++i) {
+        auto* base = static_cast<uint8_t*>(iov[i].iov_base);
+        size_t offset = 0;
+        while (offset < iov[i].iov_len && record_count < MAX_RECORDS) {
+            size_t length = wire::frame_length(base + offset, iov[i].iov_len - offset);
+            if (length == 0 || length == wire::INVALID_FRAME) {
+                length = iov[i].iov_len - offset; // Never queued; send the rest as is
+            }
+            frames[record_count] = {base + offset, length};
+            records[record_count] = {};
+            records[record_count].msg_hdr.msg_iov = &frames[record_count];
+            records[record_count].msg_hdr.msg_iovlen = 1;
+            ++record_count;
+            offset += length;
+            offered += length;
+        }
+    }
+    
+    int sent = sendmmsg(fd, records, static_cast<unsigned>(record_count), MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (sent <= 0) {
+        return sent;
+    }
+    size_t bytes = 0;
+    for (int i = 0; i < sent; ++i) {
+        bytes += frames[i].iov_len;
+    }
+    return static_cast<ssize_t>(bytes);
+}
+
+void HFTServer::flush_shm_locked(Connection& conn) {
+    iovec iov[OutboundQueue::MAX_IOVECS];
+    bool drained;
+    do {
+        int count = conn.outbound.gather(iov, OutboundQueue::MAX_IOVECS);
+        size_t gathered = 0;
+        for (int i = 0; i < count; ++i) {
+            gathered += iov[i].iov_len;
+        }
+        size_t written = conn.shm_outbound.write(iov, count);
+        conn.outbound.complete(written);
+        drained = written == gathered;
+    } while (drained && !conn.outbound.empty());
+    
+    // Ring full: the shared-memory thread retries on its next pass
+    conn.want_write = !conn.outbound.empty();
+}
+
+void HFTServer::notify_services(Connection& conn, bool established) {
+    // A service registered for several types is notified once
+    std::vector<std::shared_ptr<IMessageService>> unique_services;
+    {
+        std::lock_guard<std::mutex> lock(services_mutex_);
+        unique_services = service_owners_;
+    }
+    
+    for (auto& service : unique_services) {
+        if (established) {
+            service->on_connection_established(conn);
+        } else {
+            service->on_connection_closed(conn);
+        }
+    }
+}
+
+void HFTServer::close_connection(Reactor& reactor, Connection& conn) {
+    notify_services(conn, false);
+    
+    // Detach before closing so a concurrent accept cannot reuse the fd slot first
+    std::shared_ptr<Connection> owned;
+    {
+        std::lock_guard<std::mutex> lock(reactor.connections_mutex);
+        auto it = reactor.connections.find(conn.fd);
+        if (it != reactor.connections.end()) {
+            owned = std::move(it->second);
+            reactor.connections.erase(it);
+        }
+    }
+    
+    if (backend_ == IoBackend::EPOLL) {
+        epoll_ctl(reactor.epoll_fd, EPOLL_CTL_DEL, conn.fd, nullptr);
+    }
+    {
+        // Under send_mutex so no flush touches the fd once it can be reused
+        std::lock_guard<std::mutex> lock(conn.send_mutex);
+        conn.closed = true;
+        if (backend_ == IoBackend::IO_URING) {
+            // Completes a writability poll pending on any worker's ring, which pins the socket open
+            shutdown(conn.fd, SHUT_RDWR);
+        }
+        close(conn.fd);
+    }
+    active_connections_.fetch_sub(1);
+    
+    if (current_uring_ && owned) {
+        // The multishot recv still references conn until its final completion
+        current_uring_->retire(std::move(owned));
+    }
+}
+
+void HFTServer::setup_socket_options(int sock_fd, bool tcp) {
+    int opt = 1;
+    if (tcp) {
+        // Set SO_REUSEADDR
+        setsockopt(sock_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        
+        // Set TCP_NODELAY for low latency
+        setsockopt(sock_fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+        
+        // Busy-poll the device queue on blocking reads instead of waiting for an interrupt
+        if (polling_.busy_poll_us > 0 &&
+            setsockopt(sock_fd, SOL_SOCKET, SO_BUSY_POLL, &polling_.busy_poll_us, sizeof(polling_.busy_poll_us)) == -1) {
+            HFT_LOG_WARN("Failed to set SO_BUSY_POLL on fd {}: {}", sock_fd, LogErrno{errno});
+        }
+        
+        // Set SO_KEEPALIVE
+        setsockopt(sock_fd, SOL_SOCKET, SO_KEEPALIVE, &opt, sizeof(opt));
+    }
+    
+    // Set send and receive buffer sizes
+    int send_buf_size = 1024 * 1024; // 1MB
+    int recv_buf_size = 1024 * 1024; // 1MB
+    setsockopt(sock_fd, SOL_SOCKET, SO_SNDBUF, &send_buf_size, sizeof(send_buf_size));
+    setsockopt(sock_fd, SOL_SOCKET, SO_RCVBUF, &recv_buf_size, sizeof(recv_buf_size));
+}
+
+void HFTServer::set_non_blocking(int sock_fd) {
+    int flags = fcntl(sock_fd, F_GETFL, 0);
+    fcntl(sock_fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+namespace {
+
+HFTServer::LatencySummary summarize(const HistogramSnapshot& snapshot) {
+    HFTServer::LatencySummary summary{};
+    summary.count = snapshot.count();
+    summary.mean_us = snapshot.mean() / 1000.0;
+    summary.p50_us = snapshot.value_at_percentile(50.0) / 1000.0;
+    summary.p99_us = snapshot.value_at_percentile(99.0) / 1000.0;
+    summary.p999_us = snapshot.value_at_percentile(99.9) / 1000.0;
+    summary.p9999_us = snapshot.value_at_percentile(99.99) / 1000.0;
+    summary.max_us = snapshot.max() / 1000.0;
+    return summary;
+}
+
+} // namespace
 
 HFTServer::ServerStats HFTServer::get_stats() const {
-    std::lock_guard<std::mutex> lock(stats_mutex_);
-    return stats_;
+    ServerStats result{};
+    
+    // Merge every worker's histograms per message class, then across classes
+    std::array<HistogramSnapshot, STATS_TYPE_COUNT> by_type;
+    for (const auto& worker : worker_stats_) {
+        result.total_messages_processed += worker->messages_processed.load(std::memory_order_relaxed);
+        result.total_connections += worker->connections_accepted.load(std::memory_order_relaxed);
+        for (size_t type = 0; type < STATS_TYPE_COUNT; ++type) {
+            by_type[type].merge(worker->latency[type]);
+        }
+    }
+    
+    HistogramSnapshot overall;
+    for (size_t type = 0; type < STATS_TYPE_COUNT; ++type) {
+        overall.merge(by_type[type]);
+        result.latency_by_type[type] = summarize(by_type[type]);
+    }
+    result.latency = summarize(overall);
+    result.avg_latency_us = result.latency.mean_us;
+    result.peak_connections = peak_connections_.load(std::memory_order_relaxed);
+    result.frames_dropped = frames_dropped_.load(std::memory_order_relaxed);
+    result.frames_conflated = frames_conflated_.load(std::memory_order_relaxed);
+    result.slow_consumer_disconnects = slow_consumer_disconnects_.load(std::memory_order_relaxed);
+    return result;
 }
 
 void HFTServer::register_service(MessageType type, std::shared_ptr<IMessageService> service) {
     std::lock_guard<std::mutex> lock(services_mutex_);
-    services_[type] = service;
+    
+    // Copy the current table and patch one entry
+    auto table = std::make_unique<ServiceTable>();
+    if (const ServiceTable* current = service_table_.load(std::memory_order_relaxed)) {
+        *table = *current;
+    }
+    
+    ServiceEntry& entry = table->entries[static_cast<uint8_t>(type)];
+    entry.service = service.get();
+    if (!service) {
+        entry.kind = ServiceKind::NONE;
+    } else if (dynamic_cast<OrderService*>(service.get())) {
+        entry.kind = ServiceKind::ORDER;
+    } else if (dynamic_cast<MarketDataService*>(service.get())) {
+        entry.kind = ServiceKind::MARKET_DATA;
+    } else {
+        entry.kind = ServiceKind::GENERIC;
+    }
+    
+    if (service && std::find(service_owners_.begin(), service_owners_.end(), service) == service_owners_.end()) {
+        service_owners_.push_back(service);
+    }
+    
+    // Publish; readers of the old table stay valid because it is retained
+    service_table_.store(table.get(), std::memory_order_release);
+    service_tables_.push_back(std::move(table));
 }
 
+namespace {
+
+/**
+ * @brief Journal msg, if any, for conn's session if journaling is on
+ */
+template <typename... T>
+void journal(JournalEntry entry, const Connection& conn, const T&... msg) {
+    Journal& journal = Journal::get_instance();
+    if (journal.enabled()) {
+        journal.append(entry, conn.client_id, msg...);
+    }
+}
+
+} // namespace
+
 // OrderService implementation
+OrderService::OrderService(const MatchingEngine::Config& config) : engine_(config) {}
+
 void OrderService::process_message(const Message& msg, Connection& conn) {
     switch (msg.message_type) {
         case MessageType::ORDER_NEW:
-            if (msg.payload_size >= sizeof(OrderMessage)) {
-                const OrderMessage& order = *reinterpret_cast<const OrderMessage*>(&msg);
-                handle_new_order(order, conn);
-            }
+            handle_new_order(static_cast<const OrderMessage&>(msg), conn);
             break;
         case MessageType::ORDER_CANCEL:
-            handle_cancel_order(msg, conn);
+            handle_cancel_order(static_cast<const OrderMessage&>(msg), conn);
             break;
         case MessageType::ORDER_REPLACE:
-            handle_replace_order(msg, conn);
+            handle_replace_order(static_cast<const OrderMessage&>(msg), conn);
             break;
         default:
             break;
@@ -467,69 +1619,367 @@ void OrderService::on_connection_established(Connection& conn) {
 
 void OrderService::on_connection_closed(Connection& conn) {
     conn.is_authenticated = false;
+    
+    // Cancel on disconnect: nobody is left to receive fills for these orders
+    std::lock_guard<std::mutex> lock(engine_mutex_);
+    journal(JournalEntry::DISCONNECT, conn);
+    engine_.remove_owner(&conn);
+}
+
+size_t OrderService::restore(const std::vector<RecoveredOrder>& orders, uint64_t last_fill_id) {
+    InstrumentRegistry& registry = InstrumentRegistry::get_instance();
+    std::lock_guard<std::mutex> lock(engine_mutex_);
+    
+    // The sessions that owned these orders were open when the server stopped; each gets a closed stand-in
+    std::unordered_map<uint64_t, std::shared_ptr<Connection>> sessions;
+    std::vector<RestingOrder> resting;
+    resting.reserve(orders.size());
+    for (const RecoveredOrder& order : orders) {
+        auto& owner = sessions[order.session];
+        if (!owner) {
+            owner = std::make_shared<Connection>();
+            owner->client_id = order.session;
+            owner->closed = true;
+        }
+        resting.push_back({order.order_id, order.client_order_id, owner.get(), order.price,
+                           order.remaining, registry.intern(order.symbol), order.side});
+    }
+    
+    // Restored first so their ids are never handed out again, then cancelled as on disconnect
+    engine_.restore(resting);
+    size_t cancelled = 0;
+    for (auto& session : sessions) {
+        journal(JournalEntry::DISCONNECT, *session.second);
+        cancelled += engine_.remove_owner(session.second.get());
+    }
+    
+    next_fill_id_ = std::max(next_fill_id_, last_fill_id + 1);
+    return cancelled;
 }
 
-// Fix: Add (void) to suppress unused parameter warnings
 void OrderService::handle_new_order(const OrderMessage& order, Connection& conn) {
-    (void)conn; // Suppress unused parameter warning
-    // Process new order (implement order matching logic here)
-    // For now, just send confirmation
-    Message response = order;
-    response.status = MessageStatus::PROCESSED;
+    OrderMessage ack;
+    {
+        std::lock_guard<std::mutex> lock(engine_mutex_);
+        journal(JournalEntry::INBOUND, conn, order);
+        ack = make_ack(order, engine_.submit(order, &conn, *this), conn);
+    }
+    
+    HFTServer::get_instance().send_response(conn, ack);
+    
+    HFT_LOG_DEBUG("New order received: {} {} {} @ {}", order.symbol,
+                  order.side == OrderSide::BUY ? "BUY" : "SELL", order.quantity, order.price);
+}
+
+void OrderService::handle_cancel_order(const OrderMessage& cancel, Connection& conn) {
+    OrderMessage ack;
+    {
+        std::lock_guard<std::mutex> lock(engine_mutex_);
+        journal(JournalEntry::INBOUND, conn, cancel);
+        ack = make_ack(cancel, engine_.cancel(cancel.order_id, &conn), conn);
+    }
+    HFTServer::get_instance().send_response(conn, ack);
+}
+
+void OrderService::handle_replace_order(const OrderMessage& replace, Connection& conn) {
+    OrderMessage ack;
+    {
+        std::lock_guard<std::mutex> lock(engine_mutex_);
+        journal(JournalEntry::INBOUND, conn, replace);
+        ack = make_ack(replace, engine_.replace(replace.order_id, replace.quantity, replace.price, &conn, *this),
+                       conn);
+    }
+    HFTServer::get_instance().send_response(conn, ack);
+}
+
+OrderMessage OrderService::make_ack(const OrderMessage& request, const MatchResult& result, Connection& conn) {
+    // Called with engine_mutex_ held, so the journal keeps the ack next to its request
+    OrderMessage response = request;
+    response.order_id = result.order_id;
+    response.quantity = result.remaining_quantity;
+    switch (result.status) {
+        case MatchStatus::RESTING:
+            response.status = MessageStatus::PROCESSED;
+            break;
+        case MatchStatus::FILLED:
+        case MatchStatus::CANCELLED:
+            response.status = MessageStatus::COMPLETED;
+            break;
+        case MatchStatus::REJECTED:
+        case MatchStatus::NOT_FOUND:
+            response.message_type = MessageType::ORDER_REJECT;
+            response.status = MessageStatus::FAILED;
+            break;
+    }
     response.update_timestamp();
     
-    // In real implementation, you'd send this back to the client
-    // For now, just log it
-    std::cout << "New order received: " << order.symbol.data() 
-              << " " << (order.side == OrderSide::BUY ? "BUY" : "SELL")
-              << " " << order.quantity << " @ " << order.price << std::endl;
+    journal(JournalEntry::OUTBOUND, conn, response);
+    return response;
 }
 
-// Fix: Add (void) to suppress unused parameter warnings
-void OrderService::handle_cancel_order(const Message& msg, Connection& conn) {
-    (void)msg;   // Suppress unused parameter warning
-    (void)conn;  // Suppress unused parameter warning
-    // Handle order cancellation
-    std::cout << "Cancel order received" << std::endl;
+void OrderService::on_trade(const Trade& trade) {
+    // Called with engine_mutex_ held, from inside MatchingEngine::submit
+    send_fill(*trade.taker_owner, trade.taker_order_id, trade);
+    send_fill(*trade.maker_owner, trade.maker_order_id, trade);
 }
 
-// Fix: Add (void) to suppress unused parameter warnings
-void OrderService::handle_replace_order(const Message& msg, Connection& conn) {
-    (void)msg;   // Suppress unused parameter warning
-    (void)conn;  // Suppress unused parameter warning
-    // Handle order replacement
-    std::cout << "Replace order received" << std::endl;
+void OrderService::send_fill(Connection& conn, uint64_t order_id, const Trade& trade) {
+    FillMessage fill;
+    fill.fill_id = next_fill_id_++;
+    fill.message_id = fill.fill_id;
+    fill.update_timestamp();
+    fill.status = MessageStatus::COMPLETED;
+    fill.order_id = order_id;
+    fill.fill_quantity = trade.quantity;
+    fill.fill_price = trade.price;
+    std::memcpy(fill.execution_venue.data(), "HFT", 3);
+    
+    journal(JournalEntry::OUTBOUND, conn, fill);
+    HFTServer::get_instance().send_response(conn, fill);
 }
 
 // MarketDataService implementation
-// Fix: Add (void) to suppress unused parameter warnings
-void MarketDataService::process_message(const Message& msg, Connection& conn) {
-    (void)conn; // Suppress unused parameter warning
-    if (msg.message_type == MessageType::MARKET_DATA) {
-        if (msg.payload_size >= sizeof(MarketDataMessage)) {
-            const MarketDataMessage& data = *reinterpret_cast<const MarketDataMessage*>(&msg);
-            broadcast_market_data(data);
+MarketDataService::MarketDataService()
+    : channels_(new std::atomic<Channel*>[InstrumentRegistry::MAX_INSTRUMENTS]) {
+    for (size_t i = 0; i < InstrumentRegistry::MAX_INSTRUMENTS; ++i) {
+        channels_[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+MarketDataService::~MarketDataService() {
+    for (size_t i = 0; i < InstrumentRegistry::MAX_INSTRUMENTS; ++i) {
+        Channel* channel = channels_[i].load(std::memory_order_relaxed);
+        if (channel && channel->snapshot) {
+            channel->snapshot->release();
         }
+        delete channel;
+    }
+}
+
+void MarketDataService::process_message(const Message& msg, Connection& conn) {
+    const auto& data = static_cast<const MarketDataMessage&>(msg);
+    switch (msg.message_type) {
+        case MessageType::MARKET_DATA:
+            broadcast_market_data(data, conn);
+            break;
+        case MessageType::MARKET_DATA_SUBSCRIBE:
+            subscribe(data, conn);
+            break;
+        case MessageType::MARKET_DATA_UNSUBSCRIBE:
+            unsubscribe(data, conn);
+            break;
+        case MessageType::MARKET_DATA_RETRANSMIT:
+        case MessageType::MARKET_DATA_SNAPSHOT:
+            recover(static_cast<const RetransmitMessage&>(msg), conn);
+            break;
+        default:
+            break;
     }
 }
 
-// Fix: Add (void) to suppress unused parameter warnings
 void MarketDataService::on_connection_established(Connection& conn) {
-    (void)conn; // Suppress unused parameter warning
-    // Send initial market data snapshot
-    std::cout << "Market data connection established" << std::endl;
+    (void)conn; // Nothing to send yet: each subscription starts with its own snapshot
 }
 
-// Fix: Add (void) to suppress unused parameter warnings
 void MarketDataService::on_connection_closed(Connection& conn) {
-    (void)conn; // Suppress unused parameter warning
-    std::cout << "Market data connection closed" << std::endl;
+    // Called before the connection is freed; no update may reach it afterwards
+    std::lock_guard<std::mutex> lock(channels_mutex_);
+    auto it = subscriptions_.find(&conn);
+    if (it == subscriptions_.end()) {
+        return;
+    }
+    for (Channel* channel : it->second) {
+        std::lock_guard<std::mutex> channel_lock(channel->mutex);
+        channel->remove(&conn);
+    }
+    subscriptions_.erase(it);
+}
+
+bool MarketDataService::latest(InstrumentId instrument, MarketDataMessage& data) {
+    Channel* channel = instrument != INVALID_INSTRUMENT ? find_channel(instrument, false) : nullptr;
+    if (!channel) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(channel->mutex);
+    data = channel->last;
+    return channel->snapshot != nullptr;
+}
+
+size_t MarketDataService::restore(const std::vector<MarketDataMessage>& latest) {
+    InstrumentRegistry& registry = InstrumentRegistry::get_instance();
+    size_t restored = 0;
+    for (const MarketDataMessage& data : latest) {
+        InstrumentId instrument = registry.intern(data.symbol);
+        if (instrument == INVALID_INSTRUMENT) {
+            continue;
+        }
+        Channel* channel = find_channel(instrument, true);
+        std::lock_guard<std::mutex> lock(channel->mutex);
+        channel->last = data;
+        channel->last.instrument_id = instrument;
+        channel->sequence = data.sequence_number;
+        if (channel->snapshot) {
+            channel->snapshot->release();
+        }
+        channel->snapshot = SharedFrame::create(channel->last, 1);
+        ++restored;
+    }
+    return restored;
+}
+
+bool MarketDataService::enable_multicast(const MulticastConfig& config) {
+    if (!multicast_.open(config)) {
+        return false;
+    }
+    std::cout << "Multicast market data: " << config.group << ":" << config.port << " on " << config.interface
+              << ", " << config.retransmit_frames << " frames kept for gap fill" << std::endl;
+    return true;
+}
+
+void MarketDataService::Channel::remove(Connection* conn) {
+    auto it = std::find_if(subscribers.begin(), subscribers.end(),
+                           [conn](const Subscriber& subscriber) { return subscriber.conn == conn; });
+    if (it != subscribers.end()) {
+        *it = subscribers.back();
+        subscribers.pop_back();
+    }
+}
+
+MarketDataService::Channel* MarketDataService::find_channel(InstrumentId instrument, bool create) {
+    Channel* channel = channels_[instrument].load(std::memory_order_acquire);
+    if (channel || !create) {
+        return channel;
+    }
+    
+    std::lock_guard<std::mutex> lock(channels_mutex_);
+    channel = channels_[instrument].load(std::memory_order_relaxed);
+    if (!channel) {
+        channel = new Channel();
+        channels_[instrument].store(channel, std::memory_order_release);
+    }
+    return channel;
+}
+
+void MarketDataService::subscribe(const MarketDataMessage& request, Connection& conn) {
+    if (request.instrument_id == INVALID_INSTRUMENT) {
+        send_ack(request, false, conn);
+        return;
+    }
+    
+    Channel* channel = find_channel(request.instrument_id, true);
+    std::lock_guard<std::mutex> lock(channels_mutex_);
+    auto& subscribed = subscriptions_[&conn];
+    bool added = std::find(subscribed.begin(), subscribed.end(), channel) == subscribed.end();
+    if (added) {
+        subscribed.push_back(channel);
+    }
+    
+    // Under the channel lock so no incremental overtakes the ack and snapshot
+    std::lock_guard<std::mutex> channel_lock(channel->mutex);
+    send_ack(request, true, conn);
+    if (!added) {
+        return;
+    }
+    Channel::Subscriber subscriber{&conn, OutboundQueue::NO_POSITION};
+    if (channel->snapshot) {
+        channel->snapshot->retain();
+        HFTServer::get_instance().send_shared(conn, channel->snapshot, &subscriber.position);
+    }
+    channel->subscribers.push_back(subscriber);
+    
+    HFT_LOG_DEBUG("Connection fd {} subscribed to {}", conn.fd, request.symbol);
 }
 
-void MarketDataService::broadcast_market_data(const MarketDataMessage& data) {
-    // Broadcast market data to all connected clients
-    // In real implementation, you'd maintain a list of market data subscribers
-    std::cout << "Broadcasting market data for " << data.symbol.data() << std::endl;
+void MarketDataService::unsubscribe(const MarketDataMessage& request, Connection& conn) {
+    Channel* channel = request.instrument_id != INVALID_INSTRUMENT ? find_channel(request.instrument_id, false)
+                                                                   : nullptr;
+    if (channel) {
+        std::lock_guard<std::mutex> lock(channels_mutex_);
+        auto it = subscriptions_.find(&conn);
+        if (it != subscriptions_.end()) {
+            auto& subscribed = it->second;
+            auto pos = std::find(subscribed.begin(), subscribed.end(), channel);
+            if (pos != subscribed.end()) {
+                subscribed.erase(pos);
+                std::lock_guard<std::mutex> channel_lock(channel->mutex);
+                channel->remove(&conn);
+            }
+        }
+    }
+    send_ack(request, request.instrument_id != INVALID_INSTRUMENT, conn);
+}
+
+void MarketDataService::send_ack(const MarketDataMessage& request, bool accepted, Connection& conn) {
+    MarketDataMessage response = request;
+    response.status = accepted ? MessageStatus::PROCESSED : MessageStatus::FAILED;
+    response.update_timestamp();
+    
+    HFTServer::get_instance().send_response(conn, response);
+}
+
+void MarketDataService::broadcast_market_data(const MarketDataMessage& data, Connection& conn) {
+    if (data.instrument_id == INVALID_INSTRUMENT) {
+        return;
+    }
+    // Created on the first update so later subscribers get a snapshot
+    Channel* channel = find_channel(data.instrument_id, true);
+    
+    std::lock_guard<std::mutex> lock(channel->mutex);
+    channel->last = data;
+    channel->last.sequence_number = ++channel->sequence;
+    journal(JournalEntry::INBOUND, conn, channel->last);
+    
+    // Encode once; the cache and each subscriber's queue take one of the references
+    size_t count = channel->subscribers.size();
+    if (channel->snapshot) {
+        channel->snapshot->release();
+    }
+    channel->snapshot = SharedFrame::create(channel->last, static_cast<uint32_t>(count + 1));
+    
+    HFTServer& server = HFTServer::get_instance();
+    for (auto& subscriber : channel->subscribers) {
+        server.send_shared(*subscriber.conn, channel->snapshot, &subscriber.position);
+    }
+    
+    // Under the channel lock, so the feed carries an instrument's updates in order
+    if (multicast_.enabled()) {
+        multicast_.publish(data.instrument_id, channel->snapshot);
+    }
+    
+    HFT_LOG_DEBUG("Broadcast market data for {} to {} subscribers", data.symbol, count);
+}
+
+void MarketDataService::recover(const RetransmitMessage& request, Connection& conn) {
+    RetransmitMessage reply = request;
+    reply.count = 0;
+    reply.status = MessageStatus::FAILED;
+    
+    std::vector<SharedFrame*> frames;
+    if (multicast_.enabled()) {
+        if (request.message_type == MessageType::MARKET_DATA_SNAPSHOT) {
+            reply.first_sequence = multicast_.snapshot(frames);
+            reply.status = MessageStatus::PROCESSED;
+        } else {
+            // Too old: the reply names the oldest frame still kept, and the receiver falls back to a snapshot
+            uint64_t oldest = 0;
+            bool kept = multicast_.retransmit(request.first_sequence, std::min(request.count, MAX_RETRANSMIT),
+                                              frames, oldest);
+            reply.status = kept ? MessageStatus::PROCESSED : MessageStatus::FAILED;
+            reply.first_sequence = kept ? request.first_sequence : oldest;
+        }
+    }
+    
+    // The frames go first, each consuming the reference taken for it; the reply closes the batch
+    HFTServer& server = HFTServer::get_instance();
+    for (SharedFrame* frame : frames) {
+        server.send_shared(conn, frame);
+    }
+    reply.count = static_cast<uint32_t>(frames.size());
+    reply.update_timestamp();
+    server.send_response(conn, reply);
+    
+    HFT_LOG_DEBUG("Feed recovery for fd {}: {} frames from sequence {}", conn.fd, reply.count,
+                  reply.first_sequence);
 }
 
 } // namespace hft
@@ -1,5 +1,8 @@
 #include "hft_tcp_client.h"
 #include <errno.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 #include <algorithm>
 #include <numeric>
 #include <cmath>
@@ -11,13 +14,11 @@ HFTTCPClient::HFTTCPClient(const std::string& server_ip, uint16_t server_port, u
       gen_(rd_()), message_id_dist_(1, UINT64_MAX), quantity_dist_(100, 10000),
       price_dist_(100000, 200000) {
     
+    send_ring_ = std::make_unique<SendRing<wire::Frame>>();
+    
     // Initialize test symbols
     test_symbols_ = {"AAPL", "GOOGL", "MSFT", "TSLA", "AMZN", "NVDA", "META", "NFLX", "BABA", "NIO"};
     
-    // Initialize buffers
-    recv_buffer_.resize(BUFFER_SIZE);
-    send_buffer_.resize(BUFFER_SIZE);
-    
     // Initialize statistics
     stats_.start_time = std::chrono::steady_clock::now();
     stats_.last_message_time = stats_.start_time;
@@ -35,6 +36,36 @@ bool HFTTCPClient::connect(uint32_t timeout_ms) {
     
     connection_state_.store(ConnectionState::CONNECTING);
     
+    if (!shm_name_.empty()) {
+        return connect_shared_memory(timeout_ms);
+    }
+    
+    if (!begin_connect()) {
+        return false;
+    }
+    
+    // Wait for connection to complete
+    fd_set write_fds;
+    FD_ZERO(&write_fds);
+    FD_SET(socket_fd_, &write_fds);
+    
+    timeval timeout{};
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_usec = (timeout_ms % 1000) * 1000;
+    
+    int select_result = select(socket_fd_ + 1, nullptr, &write_fds, nullptr, &timeout);
+    if (select_result <= 0) {
+        std::cerr << "Connection timeout after " << timeout_ms << "ms" << std::endl;
+        close(socket_fd_);
+        socket_fd_ = -1;
+        connection_state_.store(ConnectionState::ERROR);
+        return false;
+    }
+    
+    return finish_connect();
+}
+
+bool HFTTCPClient::begin_connect() {
     // Create socket
     socket_fd_ = socket(AF_INET, SOCK_STREAM, 0);
     if (socket_fd_ == -1) {
@@ -70,24 +101,10 @@ bool HFTTCPClient::connect(uint32_t timeout_ms) {
         }
     }
     
-    // Wait for connection to complete
-    fd_set write_fds;
-    FD_ZERO(&write_fds);
-    FD_SET(socket_fd_, &write_fds);
-    
-    timeval timeout{};
-    timeout.tv_sec = timeout_ms / 1000;
-    timeout.tv_usec = (timeout_ms % 1000) * 1000;
-    
-    int select_result = select(socket_fd_ + 1, nullptr, &write_fds, nullptr, &timeout);
-    if (select_result <= 0) {
-        std::cerr << "Connection timeout after " << timeout_ms << "ms" << std::endl;
-        close(socket_fd_);
-        socket_fd_ = -1;
-        connection_state_.store(ConnectionState::ERROR);
-        return false;
-    }
-    
+    return true;
+}
+
+bool HFTTCPClient::finish_connect() {
     int error = 0;
     socklen_t len = sizeof(error);
     if (getsockopt(socket_fd_, SOL_SOCKET, SO_ERROR, &error, &len) == -1 || error != 0) {
@@ -98,6 +115,7 @@ bool HFTTCPClient::connect(uint32_t timeout_ms) {
         return false;
     }
     
+    next_heartbeat_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(heartbeat_interval_ms_.load());
     connection_state_.store(ConnectionState::CONNECTED);
     
     {
@@ -116,6 +134,10 @@ void HFTTCPClient::disconnect() {
     
     connection_state_.store(ConnectionState::DISCONNECTED);
     
+    if (shm_slot_ != -1) {
+        release_shared_memory();
+    }
+    
     if (socket_fd_ != -1) {
         close(socket_fd_);
         socket_fd_ = -1;
@@ -134,55 +156,88 @@ bool HFTTCPClient::is_connected() const {
 }
 
 bool HFTTCPClient::send_message(const Message& msg) {
-    if (connection_state_.load() != ConnectionState::CONNECTED) {
-        return false;
-    }
-    
-    {
-        std::lock_guard<std::mutex> lock(send_queue_mutex_);
-        send_queue_.push(msg);
+    return enqueue_message(msg);
+}
+
+bool HFTTCPClient::send_order(const OrderMessage& order) {
+    OrderMessage msg = order;
+    msg.message_id = message_id_dist_(gen_);
+    msg.update_timestamp();
+    if (msg.message_type != MessageType::ORDER_CANCEL &&
+        msg.message_type != MessageType::ORDER_REPLACE) {
+        msg.message_type = MessageType::ORDER_NEW;
     }
-    send_queue_cv_.notify_one();
+    msg.status = MessageStatus::PENDING;
+    msg.source_id = client_id_;
+    msg.destination_id = 0;
     
-    {
-        std::lock_guard<std::mutex> lock(stats_mutex_);
-        stats_.messages_sent++;
-        stats_.bytes_sent += sizeof(Message);
+    // Recorded before queueing, since the response can beat the return from enqueue_message
+    requests_.record(msg.message_id, {Clock::monotonic_ns(), msg.timestamp});
+    if (!enqueue_message(msg)) {
+        LatencyStamp unsent;
+        requests_.take(msg.message_id, unsent);
+        return false;
     }
-    
     return true;
 }
 
-bool HFTTCPClient::send_order(const OrderMessage& order) {
-    Message msg;
+bool HFTTCPClient::send_market_data(const MarketDataMessage& market_data) {
+    MarketDataMessage msg = market_data;
     msg.message_id = message_id_dist_(gen_);
     msg.update_timestamp();
-    msg.message_type = MessageType::ORDER_NEW;
+    msg.message_type = MessageType::MARKET_DATA;
     msg.status = MessageStatus::PENDING;
     msg.source_id = client_id_;
     msg.destination_id = 0;
-    msg.payload_size = sizeof(OrderMessage);
     
-    // Copy order to payload
-    std::memcpy(msg.payload.data(), &order, sizeof(order));
-    
-    return send_message(msg);
+    return enqueue_message(msg);
 }
 
-bool HFTTCPClient::send_market_data(const MarketDataMessage& market_data) {
-    Message msg;
+bool HFTTCPClient::subscribe_market_data(const std::string& symbol) {
+    return send_subscription(MessageType::MARKET_DATA_SUBSCRIBE, symbol);
+}
+
+bool HFTTCPClient::unsubscribe_market_data(const std::string& symbol) {
+    return send_subscription(MessageType::MARKET_DATA_UNSUBSCRIBE, symbol);
+}
+
+bool HFTTCPClient::send_subscription(MessageType type, const std::string& symbol) {
+    MarketDataMessage msg;
     msg.message_id = message_id_dist_(gen_);
     msg.update_timestamp();
-    msg.message_type = MessageType::MARKET_DATA;
+    msg.message_type = type;
     msg.status = MessageStatus::PENDING;
     msg.source_id = client_id_;
     msg.destination_id = 0;
-    msg.payload_size = sizeof(MarketDataMessage);
+    std::memcpy(msg.symbol.data(), symbol.data(), std::min(symbol.size(), msg.symbol.size()));
     
-    // Copy market data to payload
-    std::memcpy(msg.payload.data(), &market_data, sizeof(market_data));
+    return enqueue_message(msg);
+}
+
+template <typename T>
+bool HFTTCPClient::enqueue_message(const T& msg) {
+    if (connection_state_.load() != ConnectionState::CONNECTED) {
+        return false;
+    }
     
-    return send_message(msg);
+    if (inline_send_.load(std::memory_order_relaxed) && shm_name_.empty() &&
+        send_ring_->mode() == ProducerMode::SINGLE) {
+        wire::Frame frame;
+        frame.length = static_cast<uint16_t>(wire::encode(msg, frame.data.data()));
+        return send_inline(frame.data.data(), frame.length);
+    }
+    
+    // Encoded in place; the send thread counts it once it reaches the socket
+    uint64_t ticket;
+    wire::Frame* frame = send_ring_->claim(ticket);
+    if (!frame) {
+        return false;
+    }
+    frame->length = static_cast<uint16_t>(wire::encode(msg, frame->data.data()));
+    send_ring_->publish(ticket);
+    wake_sender();
+    
+    return true;
 }
 
 bool HFTTCPClient::send_heartbeat() {
@@ -210,6 +265,10 @@ void HFTTCPClient::set_market_data_handler(MarketDataHandler handler) {
     market_data_handler_ = handler;
 }
 
+void HFTTCPClient::set_fill_handler(FillHandler handler) {
+    fill_handler_ = handler;
+}
+
 void HFTTCPClient::start() {
     if (running_.load()) {
         return;
@@ -217,13 +276,24 @@ void HFTTCPClient::start() {
     
     running_.store(true);
     
-    // Start background threads
-    receive_thread_ = std::thread(&HFTTCPClient::receive_thread_func, this);
-    send_thread_ = std::thread(&HFTTCPClient::send_thread_func, this);
-    heartbeat_thread_ = std::thread(&HFTTCPClient::heartbeat_thread_func, this);
-    epoll_thread_ = std::thread(&HFTTCPClient::epoll_thread_func, this);
+    event_loop_ = threading_ != ClientThreading::THREADS && shm_name_.empty();
+    if (event_loop_) {
+        wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (threading_ == ClientThreading::EVENT_LOOP) {
+            event_loop_thread_ = std::thread(&HFTTCPClient::event_loop_func, this);
+        }
+    } else {
+        // Start background threads
+        receive_thread_ = std::thread(&HFTTCPClient::receive_thread_func, this);
+        send_thread_ = std::thread(&HFTTCPClient::send_thread_func, this);
+        heartbeat_thread_ = std::thread(&HFTTCPClient::heartbeat_thread_func, this);
+        epoll_thread_ = std::thread(&HFTTCPClient::epoll_thread_func, this);
+    }
+    if (multicast_enabled_) {
+        multicast_thread_ = std::thread(&HFTTCPClient::multicast_thread_func, this);
+    }
     
-    std::cout << "HFT TCP Client started with background threads" << std::endl;
+    std::cout << "HFT TCP Client started " << (event_loop_ ? "on an event loop" : "with background threads") << std::endl;
 }
 
 void HFTTCPClient::stop() {
@@ -233,8 +303,8 @@ void HFTTCPClient::stop() {
     
     running_.store(false);
     
-    // Notify all threads to stop
-    send_queue_cv_.notify_all();
+    // Wake the send thread or the event loop to see running_ cleared
+    wake_sender();
     
     // Join threads
     if (receive_thread_.joinable()) {
@@ -249,13 +319,29 @@ void HFTTCPClient::stop() {
     if (epoll_thread_.joinable()) {
         epoll_thread_.join();
     }
+    if (multicast_thread_.joinable()) {
+        multicast_thread_.join();
+    }
+    if (event_loop_thread_.joinable()) {
+        event_loop_thread_.join();
+    }
+    if (wake_fd_ != -1) {
+        close(wake_fd_);
+        wake_fd_ = -1;
+    }
     
     std::cout << "HFT TCP Client stopped" << std::endl;
 }
 
 ClientStats HFTTCPClient::get_stats() const {
     std::lock_guard<std::mutex> lock(stats_mutex_);
-    return stats_;
+    ClientStats stats = stats_;
+    HistogramSnapshot round_trips;
+    round_trips.merge(round_trip_histogram_);
+    stats.p50_latency_us = round_trips.value_at_percentile(50.0) / 1000.0;
+    stats.p99_latency_us = round_trips.value_at_percentile(99.0) / 1000.0;
+    stats.p99_9_latency_us = round_trips.value_at_percentile(99.9) / 1000.0;
+    return stats;
 }
 
 void HFTTCPClient::print_stats() const {
@@ -274,12 +360,48 @@ void HFTTCPClient::print_stats() const {
     std::cout << "Reconnection Attempts: " << stats.reconnection_attempts << std::endl;
     std::cout << "Errors: " << stats.errors << std::endl;
     
-    if (stats.messages_received > 0) {
-        std::cout << "\n--- Latency Statistics ---" << std::endl;
+    if (multicast_enabled_) {
+        std::cout << "\n--- Multicast Feed ---" << std::endl;
+        std::cout << "Packets: " << stats.multicast_packets << std::endl;
+        std::cout << "Gaps: " << stats.multicast_gaps << std::endl;
+        std::cout << "Retransmitted Frames: " << stats.multicast_retransmitted << std::endl;
+        std::cout << "Snapshots: " << stats.multicast_snapshots << std::endl;
+        std::cout << "Lost Frames: " << stats.multicast_lost << std::endl;
+    }
+    
+    if (stats.round_trips > 0) {
+        HistogramSnapshot outbound;
+        HistogramSnapshot inbound;
+        HistogramSnapshot fills;
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            outbound.merge(outbound_histogram_);
+            inbound.merge(inbound_histogram_);
+            fills.merge(fill_histogram_);
+        }
+        
+        std::cout << "\n--- Latency Statistics (round trip) ---" << std::endl;
+        std::cout << "Matched Responses: " << stats.round_trips << std::endl;
+        std::cout << "Unmatched Responses: " << stats.unmatched_responses << std::endl;
         std::cout << "Average Latency: " << std::fixed << std::setprecision(2) 
                   << stats.avg_latency_us << " μs" << std::endl;
         std::cout << "Min Latency: " << stats.min_latency_ns / 1000.0 << " μs" << std::endl;
         std::cout << "Max Latency: " << stats.max_latency_ns / 1000.0 << " μs" << std::endl;
+        std::cout << "P50/P99/P99.9 Latency: " << stats.p50_latency_us << " / " << stats.p99_latency_us
+                  << " / " << stats.p99_9_latency_us << " μs" << std::endl;
+        
+        // Legs compare wall clocks across hosts, so they are only as good as clock sync
+        if (outbound.count() > 0) {
+            std::cout << "Outbound Leg (avg/p99): " << outbound.mean() / 1000.0 << " / "
+                      << outbound.value_at_percentile(99.0) / 1000.0 << " μs" << std::endl;
+            std::cout << "Inbound Leg (avg/p99): " << inbound.mean() / 1000.0 << " / "
+                      << inbound.value_at_percentile(99.0) / 1000.0 << " μs" << std::endl;
+        }
+        if (fills.count() > 0) {
+            std::cout << "Order to First Fill (avg/p99): " << fills.mean() / 1000.0 << " / "
+                      << fills.value_at_percentile(99.0) / 1000.0 << " μs over " << fills.count()
+                      << " orders" << std::endl;
+        }
     }
     
     std::cout << "===============================" << std::endl;
@@ -290,11 +412,10 @@ void HFTTCPClient::reset_stats() {
     stats_ = ClientStats{};
     stats_.start_time = std::chrono::steady_clock::now();
     stats_.last_message_time = stats_.start_time;
-    
-    {
-        std::lock_guard<std::mutex> latency_lock(latency_mutex_);
-        latency_measurements_.clear();
-    }
+    round_trip_histogram_.reset();
+    outbound_histogram_.reset();
+    inbound_histogram_.reset();
+    fill_histogram_.reset();
 }
 
 void HFTTCPClient::set_auto_reconnect(bool enable, uint32_t reconnect_interval_ms) {
@@ -306,6 +427,30 @@ void HFTTCPClient::set_heartbeat_interval(uint32_t interval_ms) {
     heartbeat_interval_ms_.store(interval_ms);
 }
 
+void HFTTCPClient::set_spin_mode(bool enable) {
+    spin_.store(enable);
+}
+
+void HFTTCPClient::set_inline_send(bool enable) {
+    inline_send_.store(enable);
+}
+
+void HFTTCPClient::set_send_queue(size_t capacity, ProducerMode mode) {
+    if (running_.load()) {
+        return;
+    }
+    send_ring_ = std::make_unique<SendRing<wire::Frame>>(capacity, mode);
+}
+
+void HFTTCPClient::set_shared_memory(const std::string& name) {
+    shm_name_ = name;
+}
+
+void HFTTCPClient::enable_multicast(const MulticastConfig& config) {
+    multicast_ = config;
+    multicast_enabled_ = true;
+}
+
 OrderMessage HFTTCPClient::create_test_order(const std::string& symbol, OrderSide side, 
                                            uint32_t quantity, uint64_t price) {
     OrderMessage order;
@@ -357,7 +502,13 @@ void HFTTCPClient::receive_thread_func() {
             continue;
         }
         
-        ssize_t bytes_received = recv(socket_fd_, recv_buffer_.data(), recv_buffer_.size(), MSG_DONTWAIT);
+        if (!shm_name_.empty()) {
+            receive_shared_memory();
+            continue;
+        }
+        
+        recv_buffer_.compact(wire::MAX_FRAME_SIZE);
+        ssize_t bytes_received = recv(socket_fd_, recv_buffer_.write_ptr(), recv_buffer_.writable(), MSG_DONTWAIT);
         
         if (bytes_received > 0) {
             {
@@ -366,7 +517,8 @@ void HFTTCPClient::receive_thread_func() {
                 stats_.last_message_time = std::chrono::steady_clock::now();
             }
             
-            process_received_data(recv_buffer_.data(), bytes_received);
+            recv_buffer_.commit(static_cast<size_t>(bytes_received));
+            process_received_data();
         } else if (bytes_received == 0) {
             // Server disconnected
             std::cout << "Server disconnected" << std::endl;
@@ -380,7 +532,9 @@ void HFTTCPClient::receive_thread_func() {
             handle_disconnection();
         }
         
-        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        if (bytes_received <= 0 && !spin_.load(std::memory_order_relaxed)) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
     }
     
     std::cout << "Receive thread stopped" << std::endl;
@@ -390,45 +544,167 @@ void HFTTCPClient::send_thread_func() {
     std::cout << "Send thread started" << std::endl;
     
     while (running_.load()) {
-        std::unique_lock<std::mutex> lock(send_queue_mutex_);
-        send_queue_cv_.wait(lock, [this] { return !send_queue_.empty() || !running_.load(); });
+        if (connection_state_.load() != ConnectionState::CONNECTED) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
         
-        if (!running_.load()) {
-            break;
+        wire::Frame* frame = send_ring_->front();
+        if (frame) {
+            transmit_frame(frame->data.data(), frame->length);
+            send_ring_->pop();
+            continue;
         }
         
-        while (!send_queue_.empty() && connection_state_.load() == ConnectionState::CONNECTED) {
-            Message msg = send_queue_.front();
-            send_queue_.pop();
-            lock.unlock();
-            
-            if (send_data(&msg, sizeof(msg))) {
-                {
-                    std::lock_guard<std::mutex> stats_lock(stats_mutex_);
-                    stats_.messages_sent++;
-                    stats_.bytes_sent += sizeof(msg);
-                }
-            } else {
-                {
-                    std::lock_guard<std::mutex> stats_lock(stats_mutex_);
-                    stats_.errors++;
-                }
-                handle_disconnection();
+        // Built here rather than queued, so the ring only ever has the application's producers
+        if (heartbeat_due_.exchange(false, std::memory_order_relaxed)) {
+            Message heartbeat;
+            heartbeat.message_id = message_id_dist_(gen_);
+            heartbeat.update_timestamp();
+            heartbeat.message_type = MessageType::HEARTBEAT;
+            heartbeat.status = MessageStatus::PENDING;
+            heartbeat.source_id = client_id_;
+            heartbeat.destination_id = 0;
+            heartbeat.payload_size = 0;
+            wire::Frame heartbeat_frame = wire::make_frame(heartbeat);
+            if (!transmit_frame(heartbeat_frame.data.data(), heartbeat_frame.length, true)) {
+                heartbeat_due_.store(true, std::memory_order_relaxed);
             }
-            
-            lock.lock();
+            continue;
+        }
+        
+        if (!spin_.load(std::memory_order_relaxed)) {
+            send_event_.wait([this] {
+                return send_ring_->front() || heartbeat_due_.load(std::memory_order_relaxed) || !running_.load();
+            }, 1000);
         }
     }
     
     std::cout << "Send thread stopped" << std::endl;
 }
 
+bool HFTTCPClient::transmit_frame(const uint8_t* data, size_t length, bool unless_queued) {
+    while (socket_busy_.exchange(true, std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+    // The rest of a frame an inline send only partly wrote may have been queued since the caller looked
+    if (unless_queued && send_ring_->front()) {
+        socket_busy_.store(false, std::memory_order_release);
+        return false;
+    }
+    if (remainder_ && data == remainder_->data.data()) {
+        // Half a frame is only worth sending on the connection that has the first half
+        bool stale = remainder_stale_;
+        remainder_ = nullptr;
+        remainder_stale_ = false;
+        if (stale) {
+            socket_busy_.store(false, std::memory_order_release);
+            return true;
+        }
+    }
+    bool sent = send_data(data, length);
+    socket_busy_.store(false, std::memory_order_release);
+    
+    if (sent) {
+        std::lock_guard<std::mutex> stats_lock(stats_mutex_);
+        stats_.messages_sent++;
+        stats_.bytes_sent += length;
+    } else {
+        {
+            std::lock_guard<std::mutex> stats_lock(stats_mutex_);
+            stats_.errors++;
+        }
+        handle_disconnection();
+    }
+    return true;
+}
+
+bool HFTTCPClient::send_inline(const uint8_t* data, size_t length) {
+    // Queued frames, and whatever the send thread is writing, go first
+    if (!send_ring_->drained() || socket_busy_.exchange(true, std::memory_order_acquire)) {
+        return queue_bytes(data, length);
+    }
+    if (heartbeat_pending_.load(std::memory_order_relaxed)) {
+        socket_busy_.store(false, std::memory_order_release);
+        return queue_bytes(data, length);
+    }
+    
+    ssize_t sent = send(socket_fd_, data, length, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (sent == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        socket_busy_.store(false, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            stats_.errors++;
+        }
+        // An event loop owns the socket: it sees the failure on its next turn
+        if (!event_loop_) {
+            handle_disconnection();
+        }
+        return false;
+    }
+    
+    // The socket would block: the rest is queued before the socket is let go, so nothing overtakes it
+    size_t written = sent > 0 ? static_cast<size_t>(sent) : 0;
+    bool queued = written == length ||
+                  queue_bytes(data + written, length - written, written > 0 ? &remainder_ : nullptr);
+    socket_busy_.store(false, std::memory_order_release);
+    
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.bytes_sent += written;
+        if (written == length) {
+            stats_.messages_sent++;
+        }
+    }
+    if (!queued && written > 0) {
+        // Unreachable with one producer, as the ring was empty; a torn frame would desynchronize the stream
+        if (event_loop_) {
+            shutdown(socket_fd_, SHUT_RDWR);
+        } else {
+            handle_disconnection();
+        }
+    }
+    return queued;
+}
+
+bool HFTTCPClient::queue_bytes(const uint8_t* data, size_t length, wire::Frame** queued) {
+    uint64_t ticket;
+    wire::Frame* frame = send_ring_->claim(ticket);
+    if (!frame) {
+        return false;
+    }
+    std::memcpy(frame->data.data(), data, length);
+    frame->length = static_cast<uint16_t>(length);
+    if (queued) {
+        *queued = frame;
+    }
+    send_ring_->publish(ticket);
+    wake_sender();
+    return true;
+}
+
+void HFTTCPClient::wake_sender() {
+    if (wake_fd_ == -1) {
+        send_event_.notify();
+        return;
+    }
+    
+    // As ShmEvent: a system call only when the loop is asleep in poll()
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (loop_sleeping_.load(std::memory_order_relaxed)) {
+        uint64_t one = 1;
+        ssize_t written = write(wake_fd_, &one, sizeof(one));
+        (void)written;
+    }
+}
+
 void HFTTCPClient::heartbeat_thread_func() {
     std::cout << "Heartbeat thread started" << std::endl;
     
     while (running_.load()) {
         if (connection_state_.load() == ConnectionState::CONNECTED) {
-            send_heartbeat();
+            heartbeat_due_.store(true, std::memory_order_relaxed);
+            send_event_.notify();
         }
         
         std::this_thread::sleep_for(std::chrono::milliseconds(heartbeat_interval_ms_.load()));
@@ -463,28 +739,33 @@ void HFTTCPClient::epoll_thread_func() {
             }
         }
         
-        int nfds = epoll_wait(epoll_fd_, events.data(), events.size(), 100); // 100ms timeout
+        int timeout_ms = spin_.load(std::memory_order_relaxed) ? 0 : 100;
+        int nfds = epoll_wait(epoll_fd_, events.data(), events.size(), timeout_ms);
         
         if (nfds > 0) {
             for (int i = 0; i < nfds; ++i) {
                 if (events[i].data.fd == socket_fd_) {
                     if (events[i].events & EPOLLIN) {
                         // Data available for reading
-                        ssize_t bytes_received = recv(socket_fd_, recv_buffer_.data(), recv_buffer_.size(), MSG_DONTWAIT);
+                        recv_buffer_.compact(wire::MAX_FRAME_SIZE);
+                        ssize_t bytes_received = recv(socket_fd_, recv_buffer_.write_ptr(), recv_buffer_.writable(), MSG_DONTWAIT);
                         if (bytes_received > 0) {
                             {
                                 std::lock_guard<std::mutex> lock(stats_mutex_);
                                 stats_.bytes_received += bytes_received;
                                 stats_.last_message_time = std::chrono::steady_clock::now();
                             }
-                            process_received_data(recv_buffer_.data(), bytes_received);
+                            recv_buffer_.commit(static_cast<size_t>(bytes_received));
+                            process_received_data();
                         }
                     }
                 }
             }
         }
         
-        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        if (nfds <= 0 && !spin_.load(std::memory_order_relaxed)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
     }
     
     if (epoll_fd_ != -1) {
@@ -495,6 +776,277 @@ void HFTTCPClient::epoll_thread_func() {
     std::cout << "Epoll thread stopped" << std::endl;
 }
 
+void HFTTCPClient::set_threading(ClientThreading threading) {
+    if (running_.load()) {
+        return;
+    }
+    threading_ = threading;
+}
+
+void HFTTCPClient::event_loop_func() {
+    std::cout << "Event loop started" << std::endl;
+    
+    while (running_.load()) {
+        poll(spin_.load(std::memory_order_relaxed) ? 0 : 100);
+    }
+    
+    std::cout << "Event loop stopped" << std::endl;
+}
+
+int HFTTCPClient::poll(int timeout_ms) {
+    if (!event_loop_ || !running_.load()) {
+        return 0;
+    }
+    
+    auto now = std::chrono::steady_clock::now();
+    ConnectionState state = connection_state_.load();
+    if (state == ConnectionState::RECONNECTING && !loop_connecting_ && now >= reconnect_at_) {
+        reconnect_step(now, 0);
+        state = connection_state_.load();
+    }
+    
+    pollfd fds[2];
+    nfds_t count = 0;
+    fds[count++] = {wake_fd_, POLLIN, 0};
+    if (state == ConnectionState::CONNECTED && socket_fd_ != -1) {
+        bool output = send_ring_->front() || heartbeat_pending_.load(std::memory_order_relaxed);
+        fds[count++] = {socket_fd_, static_cast<short>(output ? POLLIN | POLLOUT : POLLIN), 0};
+    } else if (loop_connecting_) {
+        fds[count++] = {socket_fd_, POLLOUT, 0};
+    }
+    
+    // Sleep no further than the next timer; a producer that finds the loop asleep writes wake_fd_
+    auto deadline = now + std::chrono::milliseconds(timeout_ms);
+    if (state == ConnectionState::CONNECTED) {
+        deadline = std::min(deadline, next_heartbeat_);
+    } else if (state == ConnectionState::RECONNECTING) {
+        deadline = std::min(deadline, reconnect_at_);
+    }
+    int wait_ms = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count());
+    loop_sleeping_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (state == ConnectionState::CONNECTED && send_ring_->front()) {
+        wait_ms = 0;
+    }
+    int ready = ::poll(fds, count, std::max(wait_ms, 0));
+    loop_sleeping_.store(false, std::memory_order_relaxed);
+    if (ready == -1 && errno != EINTR) {
+        std::cerr << "Event loop poll failed: " << strerror(errno) << std::endl;
+        return 0;
+    }
+    
+    if (fds[0].revents & POLLIN) {
+        uint64_t wakeups;
+        ssize_t drained = read(wake_fd_, &wakeups, sizeof(wakeups));
+        (void)drained;
+    }
+    now = std::chrono::steady_clock::now();
+    short revents = count > 1 ? fds[1].revents : 0;
+    
+    if (loop_connecting_) {
+        reconnect_step(now, revents);
+        return 0;
+    }
+    if (state != ConnectionState::CONNECTED || connection_state_.load() != ConnectionState::CONNECTED) {
+        return 0;
+    }
+    
+    int handled = 0;
+    if (revents & (POLLIN | POLLERR | POLLHUP)) {
+        handled += read_socket();
+    }
+    if (connection_state_.load() == ConnectionState::CONNECTED) {
+        handled += flush_output();
+    }
+    if (connection_state_.load() == ConnectionState::CONNECTED && now >= next_heartbeat_) {
+        next_heartbeat_ = now + std::chrono::milliseconds(heartbeat_interval_ms_.load());
+        send_loop_heartbeat();
+    }
+    return handled;
+}
+
+int HFTTCPClient::read_socket() {
+    // Bounded, so a busy socket cannot starve the writes and timers
+    for (int reads = 0; reads < 16; ++reads) {
+        recv_buffer_.compact(wire::MAX_FRAME_SIZE);
+        ssize_t bytes_received = recv(socket_fd_, recv_buffer_.write_ptr(), recv_buffer_.writable(), MSG_DONTWAIT);
+        if (bytes_received > 0) {
+            {
+                std::lock_guard<std::mutex> lock(stats_mutex_);
+                stats_.bytes_received += bytes_received;
+                stats_.last_message_time = std::chrono::steady_clock::now();
+            }
+            recv_buffer_.commit(static_cast<size_t>(bytes_received));
+            process_received_data();
+            continue;
+        }
+        
+        if (bytes_received == 0) {
+            std::cout << "Server disconnected" << std::endl;
+            handle_disconnection();
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            std::cerr << "Receive error: " << strerror(errno) << std::endl;
+            {
+                std::lock_guard<std::mutex> lock(stats_mutex_);
+                stats_.errors++;
+            }
+            handle_disconnection();
+        }
+        return reads;
+    }
+    return 16;
+}
+
+int HFTTCPClient::flush_output() {
+    static constexpr int MAX_BATCH = 64;
+    
+    while (socket_busy_.exchange(true, std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+    
+    size_t frames_sent = 0;
+    size_t bytes_sent = 0;
+    bool failed = false;
+    
+    // A heartbeat is only started with nothing queued, so its rest goes before the ring
+    if (heartbeat_pending_.load(std::memory_order_relaxed)) {
+        iovec iov{heartbeat_out_.data.data() + heartbeat_offset_, heartbeat_out_.length - heartbeat_offset_};
+        ssize_t sent = write_some(&iov, 1);
+        failed = sent == -1;
+        if (sent > 0) {
+            heartbeat_offset_ += static_cast<size_t>(sent);
+            bytes_sent += static_cast<size_t>(sent);
+            if (heartbeat_offset_ == heartbeat_out_.length) {
+                heartbeat_pending_.store(false, std::memory_order_relaxed);
+                ++frames_sent;
+            }
+        }
+    }
+    
+    // Every published frame in one sendmsg, the first from where the last write stopped
+    if (!failed && !heartbeat_pending_.load(std::memory_order_relaxed)) {
+        iovec iov[MAX_BATCH];
+        int count = 0;
+        for (wire::Frame* frame; count < MAX_BATCH && (frame = send_ring_->at(count)) != nullptr; ++count) {
+            size_t skip = count == 0 ? front_offset_ : 0;
+            iov[count] = {frame->data.data() + skip, frame->length - skip};
+        }
+        ssize_t sent = count > 0 ? write_some(iov, count) : 0;
+        failed = sent == -1;
+        if (sent > 0) {
+            size_t remaining = static_cast<size_t>(sent);
+            size_t done = 0;
+            while (done < static_cast<size_t>(count) && remaining >= iov[done].iov_len) {
+                remaining -= iov[done].iov_len;
+                ++done;
+            }
+            front_offset_ = done == 0 ? front_offset_ + remaining : remaining;
+            if (done > 0 && send_ring_->front() == remainder_) {
+                remainder_ = nullptr;
+            }
+            send_ring_->pop(done);
+            frames_sent += done;
+            bytes_sent += static_cast<size_t>(sent);
+        }
+    }
+    socket_busy_.store(false, std::memory_order_release);
+    
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.messages_sent += frames_sent;
+        stats_.bytes_sent += bytes_sent;
+        if (failed) {
+            stats_.errors++;
+        }
+    }
+    if (failed) {
+        std::cerr << "Send error: " << strerror(errno) << std::endl;
+        handle_disconnection();
+    }
+    return static_cast<int>(frames_sent);
+}
+
+void HFTTCPClient::send_loop_heartbeat() {
+    while (socket_busy_.exchange(true, std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+    
+    // Queued frames already show the server the session is alive
+    if (send_ring_->front() || heartbeat_pending_.load(std::memory_order_relaxed)) {
+        socket_busy_.store(false, std::memory_order_release);
+        return;
+    }
+    
+    Message heartbeat;
+    heartbeat.message_id = message_id_dist_(gen_);
+    heartbeat.update_timestamp();
+    heartbeat.message_type = MessageType::HEARTBEAT;
+    heartbeat.status = MessageStatus::PENDING;
+    heartbeat.source_id = client_id_;
+    heartbeat.destination_id = 0;
+    heartbeat.payload_size = 0;
+    heartbeat_out_.length = static_cast<uint16_t>(wire::encode(heartbeat, heartbeat_out_.data.data()));
+    heartbeat_offset_ = 0;
+    
+    // Whatever the socket does not take now is written by flush_output(), ahead of later sends
+    heartbeat_pending_.store(true, std::memory_order_relaxed);
+    socket_busy_.store(false, std::memory_order_release);
+    flush_output();
+}
+
+void HFTTCPClient::reconnect_step(std::chrono::steady_clock::time_point now, short revents) {
+    auto retry_later = [&] {
+        if (socket_fd_ != -1) {
+            close(socket_fd_);
+            socket_fd_ = -1;
+        }
+        loop_connecting_ = false;
+        reconnect_at_ = now + std::chrono::milliseconds(reconnect_interval_ms_.load());
+        connection_state_.store(ConnectionState::RECONNECTING);
+        std::cout << "Reconnection failed, will retry in " << reconnect_interval_ms_.load() << "ms" << std::endl;
+    };
+    
+    if (!loop_connecting_) {
+        std::cout << "Attempting reconnection..." << std::endl;
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            stats_.reconnection_attempts++;
+        }
+        if (!begin_connect()) {
+            retry_later();
+            return;
+        }
+        // Same budget as the threaded client's blocking connect
+        loop_connecting_ = true;
+        reconnect_at_ = now + std::chrono::milliseconds(5000);
+        connection_state_.store(ConnectionState::RECONNECTING);
+        return;
+    }
+    
+    if (revents & (POLLOUT | POLLERR | POLLHUP)) {
+        loop_connecting_ = false;
+        if (finish_connect()) {
+            std::cout << "Reconnection successful" << std::endl;
+        } else {
+            retry_later();
+        }
+    } else if (now >= reconnect_at_) {
+        std::cerr << "Connection timeout after 5000ms" << std::endl;
+        retry_later();
+    }
+}
+
+ssize_t HFTTCPClient::write_some(const iovec* iov, int count) {
+    msghdr msg{};
+    msg.msg_iov = const_cast<iovec*>(iov);
+    msg.msg_iovlen = static_cast<size_t>(count);
+    ssize_t sent = sendmsg(socket_fd_, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return 0;
+    }
+    return sent;
+}
+
 void HFTTCPClient::handle_disconnection() {
     if (connection_state_.load() == ConnectionState::DISCONNECTED) {
         return;
@@ -502,11 +1054,42 @@ void HFTTCPClient::handle_disconnection() {
     
     connection_state_.store(ConnectionState::DISCONNECTED);
     
+    if (shm_slot_ != -1) {
+        release_shared_memory();
+    }
+    
     if (socket_fd_ != -1) {
         close(socket_fd_);
         socket_fd_ = -1;
     }
     
+    // The rest of a partly written frame would corrupt the next connection's stream
+    while (socket_busy_.exchange(true, std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+    if (event_loop_) {
+        // The loop is the ring's consumer: drop it here, whether the loop or an inline send wrote the start
+        if (front_offset_ > 0 || (remainder_ && send_ring_->front() == remainder_)) {
+            send_ring_->pop();
+            front_offset_ = 0;
+        }
+        remainder_ = nullptr;
+    } else if (remainder_) {
+        remainder_stale_ = true; // The send thread drops it when it comes up
+    }
+    socket_busy_.store(false, std::memory_order_release);
+    
+    if (event_loop_) {
+        heartbeat_pending_.store(false, std::memory_order_relaxed);
+        
+        // The loop reconnects without blocking, from its next turn
+        if (auto_reconnect_.load()) {
+            reconnect_at_ = std::chrono::steady_clock::now();
+            connection_state_.store(ConnectionState::RECONNECTING);
+        }
+        return;
+    }
+    
     if (auto_reconnect_.load()) {
         connection_state_.store(ConnectionState::RECONNECTING);
         attempt_reconnection();
@@ -533,58 +1116,420 @@ void HFTTCPClient::attempt_reconnection() {
     }
 }
 
-void HFTTCPClient::process_received_data(const char* data, size_t size) {
-    size_t offset = 0;
+bool HFTTCPClient::connect_shared_memory(uint32_t timeout_ms) {
+    // Attach afresh every time: a restarted server replaces the segment, and the old mapping goes
+    lock_shared_memory();
+    bool attached = shm_.attach(shm_name_);
+    socket_busy_.store(false, std::memory_order_release);
+    if (!attached || shm_.header().server_pid.load(std::memory_order_acquire) == 0 ||
+        ShmSegment::process_gone(shm_.header().server_pid.load(std::memory_order_acquire))) {
+        std::cerr << "No HFT server shared memory named " << shm_name_ << std::endl;
+        connection_state_.store(ConnectionState::ERROR);
+        return false;
+    }
+    int slot = shm_.claim();
+    if (slot == -1) {
+        std::cerr << "All shared-memory sessions of " << shm_name_ << " are in use" << std::endl;
+        connection_state_.store(ConnectionState::ERROR);
+        return false;
+    }
     
-    while (offset + sizeof(Message) <= size) {
-        const Message* msg = reinterpret_cast<const Message*>(data + offset);
-        
-        // Calculate latency if this is a response
-        auto receive_time = std::chrono::high_resolution_clock::now();
-        auto receive_ns = receive_time.time_since_epoch().count();
-        
-        // Simple latency calculation (in real implementation, you'd match with send time)
-        uint64_t latency_ns = 0;
-        if (msg->timestamp > 0) {
-            latency_ns = receive_ns - msg->timestamp;
-            update_latency_stats(latency_ns);
+    // Wait for the server to accept the session
+    ShmSlotHeader& control = shm_.slot(static_cast<size_t>(slot));
+    auto opening = [&control] {
+        return control.state.load(std::memory_order_acquire) == ShmSlotState::OPENING;
+    };
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (opening() && std::chrono::steady_clock::now() < deadline) {
+        control.client_event.wait([&] { return !opening(); }, 1000);
+    }
+    if (control.state.load(std::memory_order_acquire) != ShmSlotState::OPEN) {
+        std::cerr << "Shared-memory session not accepted after " << timeout_ms << "ms" << std::endl;
+        shm_.release(static_cast<size_t>(slot));
+        connection_state_.store(ConnectionState::ERROR);
+        return false;
+    }
+    
+    shm_inbound_ = shm_.inbound(static_cast<size_t>(slot));
+    shm_outbound_ = shm_.outbound(static_cast<size_t>(slot));
+    shm_slot_.store(slot);
+    shm_liveness_check_ = std::chrono::steady_clock::now();
+    connection_state_.store(ConnectionState::CONNECTED);
+    
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.connection_attempts++;
+    }
+    
+    std::cout << "Connected to HFT server through shared memory " << shm_name_
+              << " (slot " << slot << ")" << std::endl;
+    return true;
+}
+
+void HFTTCPClient::lock_shared_memory() {
+    // Callers have left CONNECTED, so neither side enters the mapping again until the next connect
+    while (socket_busy_.exchange(true, std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+    while (shm_reading_.load()) {
+        std::this_thread::yield();
+    }
+}
+
+void HFTTCPClient::release_shared_memory() {
+    // Once released the server may give the slot to another client, so both threads must be out of
+    // its rings first; wake them in case they wait on it
+    int slot = shm_slot_.load();
+    if (slot == -1) {
+        return;
+    }
+    shm_.slot(static_cast<size_t>(slot)).client_event.notify();
+    lock_shared_memory();
+    slot = shm_slot_.exchange(-1);
+    if (slot != -1) {
+        shm_.release(static_cast<size_t>(slot));
+    }
+    socket_busy_.store(false, std::memory_order_release);
+}
+
+void HFTTCPClient::receive_shared_memory() {
+    // Flagged while in the mapping; checked after, so a release either waits or is seen here
+    shm_reading_.store(true);
+    int slot = shm_slot_.load();
+    if (slot == -1 || connection_state_.load() != ConnectionState::CONNECTED) {
+        shm_reading_.store(false, std::memory_order_release);
+        return;
+    }
+    
+    recv_buffer_.compact(wire::MAX_FRAME_SIZE);
+    size_t bytes_received = shm_outbound_.read(recv_buffer_.write_ptr(), recv_buffer_.writable());
+    if (bytes_received > 0) {
+        // Out before the callbacks, which may disconnect
+        shm_reading_.store(false, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            stats_.bytes_received += bytes_received;
+            stats_.last_message_time = std::chrono::steady_clock::now();
+        }
+        recv_buffer_.commit(bytes_received);
+        process_received_data();
+        return;
+    }
+    
+    ShmSlotHeader& control = shm_.slot(static_cast<size_t>(slot));
+    auto now = std::chrono::steady_clock::now();
+    bool server_gone = false;
+    if (now - shm_liveness_check_ >= std::chrono::seconds(1)) {
+        // A server that crashed never marks the session closed
+        int32_t server_pid = shm_.header().server_pid.load(std::memory_order_acquire);
+        server_gone = server_pid == 0 || ShmSegment::process_gone(server_pid);
+        shm_liveness_check_ = now;
+    }
+    if (server_gone || control.state.load(std::memory_order_acquire) != ShmSlotState::OPEN) {
+        shm_reading_.store(false, std::memory_order_release);
+        std::cout << "Server disconnected" << std::endl;
+        handle_disconnection();
+        return;
+    }
+    
+    if (!spin_.load(std::memory_order_relaxed)) {
+        control.client_event.wait([&] {
+            return shm_outbound_.readable() > 0 ||
+                   control.state.load(std::memory_order_acquire) != ShmSlotState::OPEN ||
+                   connection_state_.load() != ConnectionState::CONNECTED;
+        }, 100000);
+    }
+    shm_reading_.store(false, std::memory_order_release);
+}
+
+bool HFTTCPClient::send_shared_memory(const void* data, size_t size) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    size_t sent = 0;
+    while (true) {
+        sent += shm_inbound_.write(bytes + sent, size - sent);
+        if (sent == size) {
+            return true;
         }
         
-        process_message(*msg);
+        // Ring full: wait for the server to drain it, as a blocking send would
+        int slot = shm_slot_;
+        if (slot == -1 || connection_state_.load() != ConnectionState::CONNECTED) {
+            return false;
+        }
+        ShmSlotHeader& control = shm_.slot(static_cast<size_t>(slot));
+        if (control.state.load(std::memory_order_acquire) != ShmSlotState::OPEN) {
+            return false;
+        }
+        if (!spin_.load(std::memory_order_relaxed)) {
+            control.client_event.wait([&] { return shm_inbound_.writable() > 0; }, 1000);
+        }
+    }
+}
+
+void HFTTCPClient::multicast_thread_func() {
+    MulticastReceiver receiver;
+    if (!receiver.open(multicast_)) {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.errors++;
+        return;
+    }
+    std::cout << "Multicast thread joined " << multicast_.group << ":" << multicast_.port << std::endl;
+    
+    std::vector<uint8_t> packet(MulticastReceiver::MAX_DATAGRAM);
+    uint64_t session = 0;
+    uint64_t expected = 0;      // Next feed sequence to deliver, 0 until synchronized
+    while (running_.load()) {
+        ssize_t length = receiver.receive(packet.data(), packet.size(), 100);
+        wire::WireFeedHeader header;
+        const uint8_t* frames;
+        size_t frames_length;
+        if (length <= 0 || !parse_feed_packet(packet.data(), static_cast<size_t>(length), header, frames, frames_length)) {
+            if (length < 0) {
+                std::cerr << "Multicast receive error: " << strerror(errno) << std::endl;
+                std::lock_guard<std::mutex> lock(stats_mutex_);
+                stats_.errors++;
+            }
+            continue;
+        }
         
         {
             std::lock_guard<std::mutex> lock(stats_mutex_);
-            stats_.messages_received++;
+            stats_.multicast_packets++;
         }
         
-        offset += sizeof(Message);
+        // First packet, or a restarted publisher: its sequences mean nothing against ours
+        if (header.session != session) {
+            session = header.session;
+            expected = 0;
+        }
+        if (expected == 0 && !resync_feed(expected)) {
+            expected = header.sequence;
+        }
+        
+        // A heartbeat carries the next sequence, so it also reveals lost trailing packets
+        if (header.sequence > expected) {
+            {
+                std::lock_guard<std::mutex> lock(stats_mutex_);
+                stats_.multicast_gaps++;
+            }
+            if (!fill_gap(expected, header.sequence) && !resync_feed(expected)) {
+                std::lock_guard<std::mutex> lock(stats_mutex_);
+                stats_.multicast_lost += header.sequence - expected;
+                expected = header.sequence;
+            }
+        }
+        
+        deliver_feed_frames(frames, frames_length, header.sequence, expected);
     }
+    
+    close_recovery();
+    std::cout << "Multicast thread stopped" << std::endl;
 }
 
-void HFTTCPClient::process_message(const Message& msg) {
-    if (message_handler_) {
-        message_handler_(msg);
+bool HFTTCPClient::fill_gap(uint64_t& expected, uint64_t until) {
+    std::vector<uint8_t> frames;
+    while (expected < until) {
+        RetransmitMessage request;
+        request.first_sequence = expected;
+        request.count = static_cast<uint32_t>(std::min<uint64_t>(until - expected, UINT32_MAX));
+        
+        // The server caps each batch, so a long gap takes several round trips
+        if (!request_recovery(request, frames) || request.count == 0) {
+            return false;
+        }
+        uint64_t before = expected;
+        deliver_feed_frames(frames.data(), frames.size(), request.first_sequence, expected);
+        
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.multicast_retransmitted += expected - before;
+    }
+    return true;
+}
+
+bool HFTTCPClient::resync_feed(uint64_t& expected) {
+    RetransmitMessage request;
+    request.message_type = MessageType::MARKET_DATA_SNAPSHOT;
+    std::vector<uint8_t> frames;
+    if (!request_recovery(request, frames)) {
+        return false;
+    }
+    
+    // Snapshot frames have no feed sequence of their own: deliver them all, then
+    // continue after the last sequence they include
+    uint64_t delivered = 0;
+    deliver_feed_frames(frames.data(), frames.size(), 0, delivered);
+    expected = request.first_sequence + 1;
+    
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.multicast_snapshots++;
+    return true;
+}
+
+void HFTTCPClient::deliver_feed_frames(const uint8_t* frames, size_t length, uint64_t sequence,
+                                       uint64_t& expected) {
+    size_t frame_length;
+    while ((frame_length = wire::frame_length(frames, length)) != 0 && frame_length != wire::INVALID_FRAME) {
+        // Frames already delivered, from a retransmission or a snapshot, are skipped
+        if (sequence >= expected) {
+            process_frame(frames, frame_length);
+            expected = sequence + 1;
+        }
+        frames += frame_length;
+        length -= frame_length;
+        ++sequence;
+    }
+}
+
+bool HFTTCPClient::request_recovery(RetransmitMessage& request, std::vector<uint8_t>& frames) {
+    if (recovery_fd_ == -1 && !connect_recovery()) {
+        return false;
+    }
+    
+    request.message_id = next_recovery_id_++;
+    request.update_timestamp();
+    request.status = MessageStatus::PENDING;
+    request.source_id = client_id_;
+    request.destination_id = 0;
+    wire::Frame frame = wire::make_frame(request);
+    if (send(recovery_fd_, frame.data.data(), frame.length, MSG_NOSIGNAL) != static_cast<ssize_t>(frame.length)) {
+        close_recovery();
+        return false;
+    }
+    
+    // Market data frames until the reply to this request; anything else on the session is ignored
+    frames.clear();
+    uint32_t count = 0;
+    while (true) {
+        size_t length;
+        while ((length = wire::frame_length(recovery_buffer_.read_ptr(), recovery_buffer_.readable())) == 0) {
+            recovery_buffer_.compact(wire::MAX_FRAME_SIZE);
+            ssize_t received = recv(recovery_fd_, recovery_buffer_.write_ptr(), recovery_buffer_.writable(), 0);
+            if (received <= 0) {
+                // Closed, failed or timed out: a late reply must not be taken for the next one's
+                close_recovery();
+                return false;
+            }
+            recovery_buffer_.commit(static_cast<size_t>(received));
+        }
+        if (length == wire::INVALID_FRAME) {
+            close_recovery();
+            return false;
+        }
+        
+        const uint8_t* data = recovery_buffer_.read_ptr();
+        MessageType type = wire::peek_type(data);
+        if (type == MessageType::MARKET_DATA) {
+            frames.insert(frames.end(), data, data + length);
+            ++count;
+        } else if (type == request.message_type) {
+            RetransmitMessage reply;
+            if (wire::decode(data, length, reply) && reply.message_id == request.message_id) {
+                recovery_buffer_.consume(length);
+                request = reply;
+                
+                // A short batch means the server dropped frames for a slow session
+                return reply.status == MessageStatus::PROCESSED && reply.count == count;
+            }
+        }
+        recovery_buffer_.consume(length);
+    }
+}
+
+bool HFTTCPClient::connect_recovery() {
+    sockaddr_in server_addr{};
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(server_port_);
+    if (inet_pton(AF_INET, server_ip_.c_str(), &server_addr.sin_addr) <= 0) {
+        return false;
+    }
+    
+    recovery_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (recovery_fd_ == -1) {
+        std::cerr << "Failed to create recovery socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+    
+    // Blocking, but bounded: a stalled server costs the feed a second, not the thread
+    int nodelay = 1;
+    timeval timeout{1, 0};
+    setsockopt(recovery_fd_, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    setsockopt(recovery_fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(recovery_fd_, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    if (::connect(recovery_fd_, reinterpret_cast<sockaddr*>(&server_addr), sizeof(server_addr)) == -1) {
+        std::cerr << "Failed to connect recovery session: " << strerror(errno) << std::endl;
+        close_recovery();
+        return false;
+    }
+    return true;
+}
+
+void HFTTCPClient::close_recovery() {
+    if (recovery_fd_ != -1) {
+        close(recovery_fd_);
+        recovery_fd_ = -1;
+    }
+    recovery_buffer_.clear();
+}
+
+void HFTTCPClient::process_received_data() {
+    size_t frame_length;
+    while ((frame_length = wire::frame_length(recv_buffer_.read_ptr(), recv_buffer_.readable())) != 0) {
+        if (frame_length == wire::INVALID_FRAME) {
+            std::cerr << "Invalid frame from server, dropping buffered data" << std::endl;
+            {
+                std::lock_guard<std::mutex> lock(stats_mutex_);
+                stats_.errors++;
+            }
+            recv_buffer_.clear();
+            return;
+        }
+        
+        process_frame(recv_buffer_.read_ptr(), frame_length);
+        recv_buffer_.consume(frame_length);
+    }
+}
+
+void HFTTCPClient::process_frame(const uint8_t* frame, size_t length) {
+    Message msg;
+    if (!wire::decode(frame, length, msg)) {
+        return;
     }
     
+    // Stamped before any handler runs, so handlers do not count as latency
+    LatencyStamp received{Clock::monotonic_ns(), Message::get_current_timestamp()};
+    
+    process_message(msg);
+    
     // Process specific message types
     switch (msg.message_type) {
         case MessageType::ORDER_NEW:
         case MessageType::ORDER_CANCEL:
         case MessageType::ORDER_REPLACE:
-        case MessageType::ORDER_FILL:
-        case MessageType::ORDER_REJECT:
-            if (msg.payload_size >= sizeof(OrderMessage)) {
-                const OrderMessage& order = *reinterpret_cast<const OrderMessage*>(msg.payload.data());
+        case MessageType::ORDER_REJECT: {
+            OrderMessage order;
+            if (wire::decode(frame, length, order)) {
+                correlate_order_response(order, received);
                 process_order_message(order);
             }
             break;
+        }
+            
+        case MessageType::ORDER_FILL: {
+            FillMessage fill;
+            if (wire::decode(frame, length, fill)) {
+                correlate_fill(fill, received);
+                process_fill_message(fill);
+            }
+            break;
+        }
             
-        case MessageType::MARKET_DATA:
-            if (msg.payload_size >= sizeof(MarketDataMessage)) {
-                const MarketDataMessage& market_data = *reinterpret_cast<const MarketDataMessage*>(msg.payload.data());
+        case MessageType::MARKET_DATA: {
+            MarketDataMessage market_data;
+            if (wire::decode(frame, length, market_data)) {
                 process_market_data_message(market_data);
             }
             break;
+        }
             
         case MessageType::HEARTBEAT:
             // Heartbeat received
@@ -593,6 +1538,17 @@ void HFTTCPClient::process_message(const Message& msg) {
         default:
             break;
     }
+    
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.messages_received++;
+    }
+}
+
+void HFTTCPClient::process_message(const Message& msg) {
+    if (message_handler_) {
+        message_handler_(msg);
+    }
 }
 
 void HFTTCPClient::process_order_message(const OrderMessage& order) {
@@ -605,6 +1561,15 @@ void HFTTCPClient::process_order_message(const OrderMessage& order) {
               << " " << order.quantity << " @ " << order.price << std::endl;
 }
 
+void HFTTCPClient::process_fill_message(const FillMessage& fill) {
+    if (fill_handler_) {
+        fill_handler_(fill);
+    }
+    
+    std::cout << "Fill received: order " << fill.order_id
+              << " " << fill.fill_quantity << " @ " << fill.fill_price << std::endl;
+}
+
 void HFTTCPClient::process_market_data_message(const MarketDataMessage& market_data) {
     if (market_data_handler_) {
         market_data_handler_(market_data);
@@ -637,6 +1602,10 @@ void HFTTCPClient::set_non_blocking(int sock_fd) {
 }
 
 bool HFTTCPClient::send_data(const void* data, size_t size) {
+    if (!shm_name_.empty()) {
+        return connection_state_.load() == ConnectionState::CONNECTED && send_shared_memory(data, size);
+    }
+    
     if (socket_fd_ == -1 || connection_state_.load() != ConnectionState::CONNECTED) {
         return false;
     }
@@ -645,36 +1614,69 @@ bool HFTTCPClient::send_data(const void* data, size_t size) {
     return bytes_sent == static_cast<ssize_t>(size);
 }
 
-void HFTTCPClient::update_latency_stats(uint64_t latency_ns) {
-    {
-        std::lock_guard<std::mutex> lock(latency_mutex_);
-        latency_measurements_.push_back(latency_ns);
-        
-        // Keep only last 10000 measurements
-        if (latency_measurements_.size() > 10000) {
-            latency_measurements_.erase(latency_measurements_.begin());
-        }
+void HFTTCPClient::correlate_order_response(const OrderMessage& order, const LatencyStamp& received) {
+    // Acks echo the request's message_id; their timestamp is the server's clock when it answered
+    LatencyStamp sent;
+    if (!requests_.take(order.message_id, sent)) {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.unmatched_responses++;
+        return;
     }
+    update_latency_stats(sent, received, order.timestamp);
     
-    {
+    // The ack names the server order id that fills will carry; fills sent before it were held
+    if (order.message_type != MessageType::ORDER_NEW || order.order_id == 0) {
+        return;
+    }
+    LatencyStamp filled;
+    if (early_fills_.take(order.order_id, filled)) {
         std::lock_guard<std::mutex> lock(stats_mutex_);
-        stats_.total_latency_ns += latency_ns;
-        
-        if (latency_ns < stats_.min_latency_ns) {
-            stats_.min_latency_ns = latency_ns;
-        }
-        
-        if (latency_ns > stats_.max_latency_ns) {
-            stats_.max_latency_ns = latency_ns;
-        }
-        
-        calculate_average_latency();
+        fill_histogram_.record(filled.monotonic_ns - sent.monotonic_ns);
+    } else if (order.status == MessageStatus::PROCESSED) {
+        open_orders_.record(order.order_id, sent);
     }
 }
 
+void HFTTCPClient::correlate_fill(const FillMessage& fill, const LatencyStamp& received) {
+    LatencyStamp sent;
+    if (open_orders_.take(fill.order_id, sent)) {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        fill_histogram_.record(received.monotonic_ns - sent.monotonic_ns);
+    } else if (!early_fills_.find(fill.order_id, sent)) {
+        // A taker's fills go out before its ack; keep the first until the ack arrives
+        early_fills_.record(fill.order_id, received);
+    }
+}
+
+void HFTTCPClient::update_latency_stats(const LatencyStamp& sent, const LatencyStamp& received, uint64_t server_ns) {
+    uint64_t latency_ns = received.monotonic_ns - sent.monotonic_ns;
+    
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.round_trips++;
+    stats_.total_latency_ns += latency_ns;
+    
+    if (latency_ns < stats_.min_latency_ns) {
+        stats_.min_latency_ns = latency_ns;
+    }
+    
+    if (latency_ns > stats_.max_latency_ns) {
+        stats_.max_latency_ns = latency_ns;
+    }
+    
+    round_trip_histogram_.record(latency_ns);
+    
+    // Legs only when the three wall-clock readings are in order; otherwise the clocks disagree
+    if (sent.wall_ns <= server_ns && server_ns <= received.wall_ns) {
+        outbound_histogram_.record(server_ns - sent.wall_ns);
+        inbound_histogram_.record(received.wall_ns - server_ns);
+    }
+    
+    calculate_average_latency();
+}
+
 void HFTTCPClient::calculate_average_latency() {
-    if (stats_.messages_received > 0) {
-        stats_.avg_latency_us = (stats_.total_latency_ns / 1000.0) / stats_.messages_received;
+    if (stats_.round_trips > 0) {
+        stats_.avg_latency_us = (stats_.total_latency_ns / 1000.0) / stats_.round_trips;
     }
 }
 
@@ -18,8 +18,6 @@ public:
           price_dist_(100000, 200000) {
         
         test_symbols_ = {"AAPL", "GOOGL", "MSFT", "TSLA", "AMZN", "NVDA", "META", "NFLX"};
-        recv_buffer_.resize(65536);
-        send_buffer_.resize(65536);
         
         stats_.start_time = std::chrono::steady_clock::now();
         stats_.last_message_time = stats_.start_time;
@@ -122,36 +120,35 @@ public:
     }
     
     bool send_message(const Message& msg) {
-        if (connection_state_.load() != ConnectionState::CONNECTED) {
-            return false;
-        }
-        
-        ssize_t bytes_sent = send(socket_fd_, &msg, sizeof(msg), MSG_NOSIGNAL);
-        if (bytes_sent == sizeof(msg)) {
-            stats_.messages_sent++;
-            stats_.bytes_sent += sizeof(msg);
-            return true;
-        } else {
-            stats_.errors++;
-            return false;
-        }
+        return send_frame(wire::make_frame(msg));
     }
     
     bool send_order(const OrderMessage& order) {
-        Message msg;
+        OrderMessage msg = order;
         msg.message_id = message_id_dist_(gen_);
         msg.update_timestamp();
         msg.message_type = MessageType::ORDER_NEW;
         msg.status = MessageStatus::PENDING;
         msg.source_id = client_id_;
         msg.destination_id = 0;
-        msg.payload_size = sizeof(OrderMessage);
         
-        // Copy order to payload (truncated to fit)
-        size_t copy_size = std::min(sizeof(order), msg.payload.size());
-        std::memcpy(msg.payload.data(), &order, copy_size);
+        return send_frame(wire::make_frame(msg));
+    }
+    
+    bool send_frame(const wire::Frame& frame) {
+        if (connection_state_.load() != ConnectionState::CONNECTED) {
+            return false;
+        }
         
-        return send_message(msg);
+        ssize_t bytes_sent = send(socket_fd_, frame.data.data(), frame.length, MSG_NOSIGNAL);
+        if (bytes_sent == frame.length) {
+            stats_.messages_sent++;
+            stats_.bytes_sent += frame.length;
+            return true;
+        } else {
+            stats_.errors++;
+            return false;
+        }
     }
     
     bool send_heartbeat() {
@@ -169,32 +166,40 @@ public:
     
     void receive_messages() {
         while (connection_state_.load() == ConnectionState::CONNECTED) {
-            ssize_t bytes_received = recv(socket_fd_, recv_buffer_.data(), recv_buffer_.size(), MSG_DONTWAIT);
+            recv_buffer_.compact(wire::MAX_FRAME_SIZE);
+            ssize_t bytes_received = recv(socket_fd_, recv_buffer_.write_ptr(), recv_buffer_.writable(), MSG_DONTWAIT);
             
             if (bytes_received > 0) {
                 stats_.bytes_received += bytes_received;
                 stats_.last_message_time = std::chrono::steady_clock::now();
+                recv_buffer_.commit(static_cast<size_t>(bytes_received));
                 
-                // Process received data
-                size_t offset = 0;
-                while (offset + sizeof(Message) <= static_cast<size_t>(bytes_received)) {
-                    const Message* msg = reinterpret_cast<const Message*>(recv_buffer_.data() + offset);
+                // Process every complete frame
+                size_t frame_length;
+                while ((frame_length = wire::frame_length(recv_buffer_.read_ptr(), recv_buffer_.readable())) != 0) {
+                    if (frame_length == wire::INVALID_FRAME) {
+                        stats_.errors++;
+                        recv_buffer_.clear();
+                        break;
+                    }
+                    
+                    Message msg;
+                    wire::decode(recv_buffer_.read_ptr(), frame_length, msg);
                     
                     stats_.messages_received++;
                     
-                    // Calculate latency
-                    auto receive_time = std::chrono::high_resolution_clock::now();
-                    auto receive_ns = receive_time.time_since_epoch().count();
+                    // One-way against the server's wall-clock timestamp
+                    uint64_t receive_ns = Message::get_current_timestamp();
                     
-                    if (msg->timestamp > 0) {
-                        uint64_t latency_ns = receive_ns - msg->timestamp;
+                    if (msg.timestamp > 0) {
+                        uint64_t latency_ns = receive_ns - msg.timestamp;
                         update_latency_stats(latency_ns);
                     }
                     
                     // Process message
-                    process_message(*msg);
+                    process_message(recv_buffer_.read_ptr(), frame_length, msg);
                     
-                    offset += sizeof(Message);
+                    recv_buffer_.consume(frame_length);
                 }
             } else if (bytes_received == 0) {
                 std::cout << "Server disconnected" << std::endl;
@@ -209,7 +214,7 @@ public:
         }
     }
     
-    void process_message(const Message& msg) {
+    void process_message(const uint8_t* frame, size_t length, const Message& msg) {
         std::cout << "Message received: Type=" << static_cast<int>(msg.message_type) 
                   << " ID=" << msg.message_id << " Size=" << msg.payload_size << std::endl;
         
@@ -217,23 +222,33 @@ public:
             case MessageType::ORDER_NEW:
             case MessageType::ORDER_CANCEL:
             case MessageType::ORDER_REPLACE:
-            case MessageType::ORDER_FILL:
-            case MessageType::ORDER_REJECT:
-                if (msg.payload_size >= sizeof(OrderMessage)) {
-                    const OrderMessage& order = *reinterpret_cast<const OrderMessage*>(msg.payload.data());
+            case MessageType::ORDER_REJECT: {
+                OrderMessage order;
+                if (wire::decode(frame, length, order)) {
                     std::cout << "Order received: " << order.symbol.data() 
                               << " " << (order.side == OrderSide::BUY ? "BUY" : "SELL")
                               << " " << order.quantity << " @ " << order.price << std::endl;
                 }
                 break;
+            }
                 
-            case MessageType::MARKET_DATA:
-                if (msg.payload_size >= sizeof(MarketDataMessage)) {
-                    const MarketDataMessage& market_data = *reinterpret_cast<const MarketDataMessage*>(msg.payload.data());
+            case MessageType::ORDER_FILL: {
+                FillMessage fill;
+                if (wire::decode(frame, length, fill)) {
+                    std::cout << "Fill received: order " << fill.order_id
+                              << " " << fill.fill_quantity << " @ " << fill.fill_price << std::endl;
+                }
+                break;
+            }
+                
+            case MessageType::MARKET_DATA: {
+                MarketDataMessage market_data;
+                if (wire::decode(frame, length, market_data)) {
                     std::cout << "Market data received: " << market_data.symbol.data()
                               << " Bid: " << market_data.bid_price << " Ask: " << market_data.ask_price << std::endl;
                 }
                 break;
+            }
                 
             case MessageType::HEARTBEAT:
                 std::cout << "Heartbeat received" << std::endl;
@@ -351,8 +366,7 @@ private:
     int socket_fd_{-1};
     
     ClientStats stats_;
-    std::vector<char> recv_buffer_;
-    std::vector<char> send_buffer_;
+    ReceiveBuffer recv_buffer_;
     
     std::random_device rd_;
     std::mt19937 gen_;
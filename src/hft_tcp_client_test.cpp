@@ -33,6 +33,13 @@ int main(int argc, char* argv[]) {
     uint32_t message_interval_ms = 1;
     uint32_t test_duration_seconds = 60;
     uint32_t messages_per_second = 100;
+    std::string shm_name;
+    size_t send_queue = 1024;
+    ProducerMode producer_mode = ProducerMode::SINGLE;
+    bool inline_send = false;
+    ClientThreading threading = ClientThreading::THREADS;
+    MulticastConfig multicast;
+    bool multicast_enabled = false;
     
     // Parse command line arguments
     for (int i = 1; i < argc; ++i) {
@@ -53,6 +60,34 @@ int main(int argc, char* argv[]) {
             test_duration_seconds = std::stoul(argv[++i]);
         } else if (arg == "--rate" && i + 1 < argc) {
             messages_per_second = std::stoul(argv[++i]);
+        } else if (arg == "--shm" && i + 1 < argc) {
+            shm_name = argv[++i];
+        } else if (arg == "--send-queue" && i + 1 < argc) {
+            send_queue = std::stoul(argv[++i]);
+        } else if (arg == "--multi-producer") {
+            producer_mode = ProducerMode::MULTI;
+        } else if (arg == "--threading" && i + 1 < argc) {
+            std::string model = argv[++i];
+            if (model == "loop") {
+                threading = ClientThreading::EVENT_LOOP;
+            } else if (model == "app") {
+                threading = ClientThreading::APPLICATION;
+            } else if (model != "threads") {
+                std::cerr << "Unknown threading: " << model << std::endl;
+                return 1;
+            }
+        } else if (arg == "--inline-send") {
+            inline_send = true;
+        } else if (arg == "--multicast" && i + 1 < argc) {
+            std::string endpoint = argv[++i];
+            size_t colon = endpoint.find(':');
+            multicast.group = endpoint.substr(0, colon);
+            if (colon != std::string::npos) {
+                multicast.port = static_cast<uint16_t>(std::stoi(endpoint.substr(colon + 1)));
+            }
+            multicast_enabled = true;
+        } else if (arg == "--multicast-if" && i + 1 < argc) {
+            multicast.interface = argv[++i];
         } else if (arg == "--help") {
             std::cout << "HFT TCP Client Test\n"
                       << "Usage: " << argv[0] << " [options]\n\n"
@@ -60,17 +95,26 @@ int main(int argc, char* argv[]) {
                       << "  --ip <ip>              Server IP address (default: 127.0.0.1)\n"
                       << "  --port <port>          Server port (default: 8888)\n"
                       << "  --client-id <id>       Client ID (default: 1)\n"
-                      << "  --mode <mode>          Test mode: interactive, latency, burst, sustained (default: interactive)\n"
+                      << "  --mode <mode>          Test mode: interactive, latency, burst, sustained, feed (default: interactive)\n"
                       << "  --messages <n>         Number of messages for latency test (default: 1000)\n"
                       << "  --interval <ms>        Message interval in ms (default: 1)\n"
                       << "  --duration <s>         Duration for sustained test (default: 60)\n"
                       << "  --rate <msg/s>         Messages per second for sustained test (default: 100)\n"
+                      << "  --shm <name>           Connect through the server's shared memory instead of TCP\n"
+                      << "  --send-queue <n>       Send ring slots (default: 1024)\n"
+                      << "  --multi-producer       Let several threads share the send ring\n"
+                      << "  --threading <t>        threads, loop (one event loop thread) or app (this\n"
+                      << "                         thread polls; not in interactive mode) (default: threads)\n"
+                      << "  --inline-send          Write orders on the calling thread, not the send thread\n"
+                      << "  --multicast <group[:port]> Also receive the server's multicast market data feed\n"
+                      << "  --multicast-if <ip>    Interface address to join on (default: 127.0.0.1)\n"
                       << "  --help                 Show this help message\n\n"
                       << "Examples:\n"
                       << "  " << argv[0] << " --mode interactive\n"
                       << "  " << argv[0] << " --mode latency --messages 5000 --interval 0\n"
                       << "  " << argv[0] << " --mode burst --messages 100 --interval 0\n"
-                      << "  " << argv[0] << " --mode sustained --duration 120 --rate 200\n";
+                      << "  " << argv[0] << " --mode sustained --duration 120 --rate 200\n"
+                      << "  " << argv[0] << " --mode feed --multicast 239.255.0.1:30001 --duration 30\n";
             return 0;
         }
     }
@@ -84,6 +128,13 @@ int main(int argc, char* argv[]) {
     // Create client
     HFTTCPClient client(server_ip, server_port, client_id);
     g_client = &client;
+    client.set_shared_memory(shm_name);
+    client.set_send_queue(send_queue, producer_mode);
+    client.set_inline_send(inline_send);
+    client.set_threading(threading);
+    if (multicast_enabled) {
+        client.enable_multicast(multicast);
+    }
     
     // Set up signal handling
     signal(SIGINT, signal_handler);
@@ -115,11 +166,42 @@ int main(int argc, char* argv[]) {
     // Start client
     client.start();
     
+    // With ClientThreading::APPLICATION nothing else drives the client, so this thread polls while it waits
+    bool polled = threading == ClientThreading::APPLICATION;
+    auto wait_for = [&client, polled](std::chrono::microseconds duration) {
+        if (!polled) {
+            std::this_thread::sleep_for(duration);
+            return;
+        }
+        auto deadline = std::chrono::steady_clock::now() + duration;
+        for (auto now = std::chrono::steady_clock::now(); now < deadline; now = std::chrono::steady_clock::now()) {
+            client.poll(static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count()));
+        }
+    };
+    
+    // A full send ring refuses an order; the load modes wait for it to drain
+    auto send_order = [&client, polled](const OrderMessage& order) {
+        while (!client.send_order(order) && client.is_connected()) {
+            if (polled) {
+                client.poll();
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        if (polled) {
+            client.poll();
+        }
+    };
+    
     // Wait a moment for connection to stabilize
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    wait_for(std::chrono::milliseconds(100));
     
     try {
         if (test_mode == "interactive") {
+            if (polled) {
+                std::cerr << "Interactive mode reads stdin; use --threading loop" << std::endl;
+                return 1;
+            }
             std::cout << "\n=== Interactive Mode ===" << std::endl;
             std::cout << "Commands:" << std::endl;
             std::cout << "  o <symbol> <side> <quantity> <price> - Send order" << std::endl;
@@ -191,15 +273,15 @@ int main(int argc, char* argv[]) {
             
             for (size_t i = 0; i < num_messages; ++i) {
                 OrderMessage order = client.create_test_order("AAPL", OrderSide::BUY, 100, 150000 + i);
-                client.send_order(order);
+                send_order(order);
                 
                 if (message_interval_ms > 0) {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(message_interval_ms));
+                    wait_for(std::chrono::milliseconds(message_interval_ms));
                 }
             }
             
             // Wait for responses
-            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+            wait_for(std::chrono::milliseconds(1000));
             client.print_stats();
             
         } else if (test_mode == "burst") {
@@ -212,11 +294,11 @@ int main(int argc, char* argv[]) {
             // Send all messages as fast as possible
             for (size_t i = 0; i < num_messages; ++i) {
                 OrderMessage order = client.create_test_order("AAPL", OrderSide::BUY, 100, 150000 + i);
-                client.send_order(order);
+                send_order(order);
             }
             
             // Wait for responses
-            std::this_thread::sleep_for(std::chrono::milliseconds(2000));
+            wait_for(std::chrono::milliseconds(2000));
             client.print_stats();
             
         } else if (test_mode == "sustained") {
@@ -235,19 +317,28 @@ int main(int argc, char* argv[]) {
             
             while (std::chrono::steady_clock::now() < end_time) {
                 OrderMessage order = client.create_test_order("AAPL", OrderSide::BUY, 100, 150000 + message_count);
-                client.send_order(order);
+                send_order(order);
                 message_count++;
                 
-                std::this_thread::sleep_for(std::chrono::microseconds(message_interval_us));
+                wait_for(std::chrono::microseconds(message_interval_us));
             }
             
             // Wait for final responses
-            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+            wait_for(std::chrono::milliseconds(1000));
+            client.print_stats();
+            
+        } else if (test_mode == "feed") {
+            std::cout << "\n=== Market Data Feed ===" << std::endl;
+            std::cout << "Duration: " << test_duration_seconds << " seconds" << std::endl;
+            std::cout << "========================" << std::endl;
+            
+            // Updates arrive on the multicast thread; this one only waits
+            wait_for(std::chrono::seconds(test_duration_seconds));
             client.print_stats();
             
         } else {
             std::cerr << "Unknown test mode: " << test_mode << std::endl;
-            std::cerr << "Valid modes: interactive, latency, burst, sustained" << std::endl;
+            std::cerr << "Valid modes: interactive, latency, burst, sustained, feed" << std::endl;
             return 1;
         }
     } catch (const std::exception& e) {
@@ -0,0 +1,232 @@
+#include "instrument_registry.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+namespace hft {
+
+namespace {
+
+constexpr uint32_t MAX_SEED_ATTEMPTS = 1 << 20;
+
+uint64_t mix(uint64_t x) {
+    // splitmix64 finalizer
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+size_t round_up(size_t count) {
+    size_t size = 1;
+    while (size < count) {
+        size <<= 1;
+    }
+    return size;
+}
+
+} // namespace
+
+InstrumentRegistry& InstrumentRegistry::get_instance() {
+    static InstrumentRegistry instance;
+    return instance;
+}
+
+InstrumentRegistry::InstrumentRegistry()
+    : symbols_(new Symbol[MAX_INSTRUMENTS]), interned_(new std::atomic<InstrumentId>[INTERN_SLOTS]) {
+    for (size_t i = 0; i < INTERN_SLOTS; ++i) {
+        interned_[i].store(INVALID_INSTRUMENT, std::memory_order_relaxed);
+    }
+}
+
+uint64_t InstrumentRegistry::hash(const Symbol& symbol) {
+    uint64_t low;
+    uint64_t high;
+    std::memcpy(&low, symbol.data(), sizeof(low));
+    std::memcpy(&high, symbol.data() + sizeof(low), sizeof(high));
+    return mix(low ^ mix(high + 0x9e3779b97f4a7c15ULL));
+}
+
+uint64_t InstrumentRegistry::place(uint64_t hash, uint32_t seed) {
+    return mix(hash ^ (seed * 0x9e3779b97f4a7c15ULL));
+}
+
+bool InstrumentRegistry::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Cannot open instrument file " << path << std::endl;
+        return false;
+    }
+
+    std::vector<Symbol> symbols;
+    std::string line;
+    for (size_t line_number = 1; std::getline(file, line); ++line_number) {
+        line = line.substr(0, line.find('#'));
+        size_t begin = line.find_first_not_of(" \t\r");
+        if (begin == std::string::npos) {
+            continue;
+        }
+        size_t end = line.find_last_not_of(" \t\r") + 1;
+        if (end - begin > Symbol().size()) {
+            std::cerr << path << ":" << line_number << ": symbol longer than "
+                      << Symbol().size() << " characters" << std::endl;
+            return false;
+        }
+        Symbol symbol{};
+        std::memcpy(symbol.data(), line.data() + begin, end - begin);
+        symbols.push_back(symbol);
+    }
+
+    if (!assign(symbols)) {
+        std::cerr << path << ": duplicate symbol or more than " << MAX_INSTRUMENTS
+                  << " instruments" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool InstrumentRegistry::assign(const std::vector<Symbol>& symbols) {
+    if (symbols.size() > MAX_INSTRUMENTS) {
+        return false;
+    }
+
+    // Equal symbols share every hash, so the build below would never separate them
+    std::vector<Symbol> sorted = symbols;
+    std::sort(sorted.begin(), sorted.end());
+    if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end()) {
+        return false;
+    }
+
+    // Aim for a 0.8 load factor; a sparser table only helps if seeding fails
+    size_t slot_count = round_up(symbols.size() + symbols.size() / 4);
+    while (!build(symbols, slot_count)) {
+        slot_count *= 2;
+    }
+
+    for (size_t id = 0; id < symbols.size(); ++id) {
+        symbols_[id] = symbols[id];
+    }
+    count_.store(symbols.size(), std::memory_order_release);
+    fixed_ = true;
+    return true;
+}
+
+bool InstrumentRegistry::build(const std::vector<Symbol>& symbols, size_t slot_count) {
+    // About two symbols per bucket
+    size_t bucket_count = round_up(std::max<size_t>(1, symbols.size() / 2));
+    bucket_mask_ = bucket_count - 1;
+    slot_mask_ = slot_count - 1;
+    seeds_.assign(bucket_count, 0);
+    slots_.assign(slot_count, Slot{});
+
+    std::vector<uint64_t> hashes(symbols.size());
+    std::vector<std::vector<uint32_t>> buckets(bucket_count);
+    for (size_t i = 0; i < symbols.size(); ++i) {
+        hashes[i] = hash(symbols[i]);
+        buckets[(hashes[i] >> 32) & bucket_mask_].push_back(static_cast<uint32_t>(i));
+    }
+
+    // Place the largest buckets first, while most slots are still free
+    std::vector<uint32_t> order(bucket_count);
+    for (uint32_t b = 0; b < bucket_count; ++b) {
+        order[b] = b;
+    }
+    std::stable_sort(order.begin(), order.end(), [&buckets](uint32_t a, uint32_t b) {
+        return buckets[a].size() > buckets[b].size();
+    });
+
+    std::vector<size_t> positions;
+    for (uint32_t b : order) {
+        const auto& bucket = buckets[b];
+        if (bucket.empty()) {
+            break;
+        }
+
+        // Find a seed sending every member of the bucket to a distinct free slot
+        bool placed = false;
+        for (uint32_t seed = 0; seed < MAX_SEED_ATTEMPTS && !placed; ++seed) {
+            positions.clear();
+            placed = true;
+            for (uint32_t i : bucket) {
+                size_t pos = place(hashes[i], seed) & slot_mask_;
+                if (slots_[pos].id != INVALID_INSTRUMENT ||
+                    std::find(positions.begin(), positions.end(), pos) != positions.end()) {
+                    placed = false;
+                    break;
+                }
+                positions.push_back(pos);
+            }
+            if (placed) {
+                seeds_[b] = seed;
+                for (size_t k = 0; k < bucket.size(); ++k) {
+                    slots_[positions[k]].symbol = symbols[bucket[k]];
+                    slots_[positions[k]].id = static_cast<InstrumentId>(bucket[k]);
+                }
+            }
+        }
+        if (!placed) {
+            return false;
+        }
+    }
+    return true;
+}
+
+InstrumentId InstrumentRegistry::find(const Symbol& symbol) const {
+    uint64_t h = hash(symbol);
+    if (!fixed_) {
+        return find_interned(symbol, h);
+    }
+
+    const Slot& slot = slots_[place(h, seeds_[(h >> 32) & bucket_mask_]) & slot_mask_];
+    if (slot.id != INVALID_INSTRUMENT && std::memcmp(slot.symbol.data(), symbol.data(), symbol.size()) == 0) {
+        return slot.id;
+    }
+    return INVALID_INSTRUMENT;
+}
+
+InstrumentId InstrumentRegistry::find_interned(const Symbol& symbol, uint64_t hash) const {
+    for (size_t pos = hash & (INTERN_SLOTS - 1); ; pos = (pos + 1) & (INTERN_SLOTS - 1)) {
+        InstrumentId id = interned_[pos].load(std::memory_order_acquire);
+        if (id == INVALID_INSTRUMENT) {
+            return INVALID_INSTRUMENT;
+        }
+        if (std::memcmp(symbols_[id].data(), symbol.data(), symbol.size()) == 0) {
+            return id;
+        }
+    }
+}
+
+InstrumentId InstrumentRegistry::intern(const Symbol& symbol) {
+    InstrumentId id = find(symbol);
+    if (id != INVALID_INSTRUMENT || fixed_) {
+        return id;
+    }
+
+    std::lock_guard<std::mutex> lock(intern_mutex_);
+    size_t count = count_.load(std::memory_order_relaxed);
+    uint64_t h = hash(symbol);
+    size_t pos = h & (INTERN_SLOTS - 1);
+    for (; ; pos = (pos + 1) & (INTERN_SLOTS - 1)) {
+        id = interned_[pos].load(std::memory_order_relaxed);
+        if (id == INVALID_INSTRUMENT) {
+            break;
+        }
+        if (std::memcmp(symbols_[id].data(), symbol.data(), symbol.size()) == 0) {
+            return id; // Interned by another thread since find()
+        }
+    }
+    if (count >= intern_limit_) {
+        return INVALID_INSTRUMENT;
+    }
+
+    // Symbol first, then the slot and count that make it reachable
+    symbols_[count] = symbol;
+    interned_[pos].store(static_cast<InstrumentId>(count), std::memory_order_release);
+    count_.store(count + 1, std::memory_order_release);
+    return static_cast<InstrumentId>(count);
+}
+
+} // namespace hft
@@ -0,0 +1,327 @@
+#include "journal.h"
+#include "logger.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace hft {
+
+namespace {
+
+constexpr char SEGMENT_MAGIC[8] = {'H', 'F', 'T', 'J', 'R', 'N', 'L', '1'};
+constexpr uint32_t SEGMENT_VERSION = 1;
+
+size_t record_span(size_t length) {
+    return (length + 7) & ~size_t(7);
+}
+
+std::string segment_path(const std::string& directory, uint64_t index) {
+    char name[32];
+    snprintf(name, sizeof(name), "journal-%06llu.seg", static_cast<unsigned long long>(index));
+    return directory + "/" + name;
+}
+
+} // namespace
+
+// JournalReader implementation
+std::vector<std::string> JournalReader::segments(const std::string& directory) {
+    std::vector<std::pair<uint64_t, std::string>> found;
+    if (DIR* dir = opendir(directory.c_str())) {
+        while (dirent* entry = readdir(dir)) {
+            unsigned long long index = 0;
+            char suffix[8] = {};
+            if (sscanf(entry->d_name, "journal-%llu.%7s", &index, suffix) == 2 &&
+                std::strcmp(suffix, "seg") == 0) {
+                found.emplace_back(index, directory + "/" + entry->d_name);
+            }
+        }
+        closedir(dir);
+    }
+    std::sort(found.begin(), found.end());
+
+    std::vector<std::string> paths;
+    for (auto& [index, path] : found) {
+        paths.push_back(std::move(path));
+    }
+    return paths;
+}
+
+bool JournalReader::open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(JournalSegmentHeader)) {
+        ::close(fd);
+        return false;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    void* map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    data_ = static_cast<const uint8_t*>(map);
+    size_ = size;
+    std::memcpy(&header_, data_, sizeof(header_));
+    if (std::memcmp(header_.magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC)) != 0 ||
+        header_.header_size < sizeof(header_) || header_.header_size > size_) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void JournalReader::close() {
+    if (data_) {
+        munmap(const_cast<uint8_t*>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+    header_ = JournalSegmentHeader{};
+}
+
+// Journal implementation
+Journal& Journal::get_instance() {
+    // Construct the logger first so it outlives the journal
+    Logger::get_instance();
+    static Journal instance;
+    return instance;
+}
+
+Journal::~Journal() {
+    close();
+}
+
+bool Journal::open(const JournalConfig& config) {
+    if (running_.load(std::memory_order_relaxed)) {
+        std::cerr << "Journal is already open" << std::endl;
+        return false;
+    }
+    size_t minimum = sizeof(JournalSegmentHeader) + record_span(sizeof(JournalRecordHeader) + wire::MAX_FRAME_SIZE);
+    if (config.segment_bytes < minimum) {
+        std::cerr << "Journal segments must be at least " << minimum << " bytes" << std::endl;
+        return false;
+    }
+    config_ = config;
+
+    if (mkdir(config_.directory.c_str(), 0755) < 0 && errno != EEXIST) {
+        std::cerr << "Cannot create journal directory " << config_.directory << ": "
+                  << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // Never append to an old segment; its tail may be torn
+    segment_index_ = 0;
+    first_sequence_ = 1;
+    std::vector<std::string> segments = JournalReader::segments(config_.directory);
+    if (!segments.empty()) {
+        JournalReader last;
+        if (!last.open(segments.back())) {
+            std::cerr << "Cannot read journal segment " << segments.back() << std::endl;
+            return false;
+        }
+        segment_index_ = last.header().index;
+        first_sequence_ = last.header().first_sequence;
+        last.for_each([this](const JournalRecordHeader& record, const uint8_t*) {
+            first_sequence_ = record.sequence + 1;
+        });
+    }
+
+    slots_.reset(new Slot[RING_CAPACITY]);
+    for (size_t i = 0; i < RING_CAPACITY; ++i) {
+        slots_[i].turn.store(i, std::memory_order_relaxed);
+    }
+    tail_.store(0, std::memory_order_relaxed);
+    written_.store(0, std::memory_order_relaxed);
+    synced_sequence_.store(first_sequence_ - 1, std::memory_order_relaxed);
+    head_ = 0;
+
+    if (!open_segment()) {
+        std::cerr << "Cannot create journal segment in " << config_.directory << std::endl;
+        return false;
+    }
+
+    running_.store(true, std::memory_order_release);
+    writer_ = std::thread(&Journal::writer_thread, this);
+    enabled_.store(true, std::memory_order_release);
+    return true;
+}
+
+void Journal::close() {
+    if (!running_.load(std::memory_order_acquire)) {
+        return;
+    }
+    enabled_.store(false, std::memory_order_release);
+    running_.store(false, std::memory_order_release);
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+    close_segment();
+}
+
+void Journal::flush() {
+    uint64_t target = tail_.load(std::memory_order_acquire);
+    while (written_.load(std::memory_order_acquire) < target && running_.load(std::memory_order_acquire)) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+}
+
+void Journal::wait_for_slot(Slot& slot, uint64_t position) {
+    // The ring is full: the writer is a whole ring behind
+    stalls_.fetch_add(1, std::memory_order_relaxed);
+    while (slot.turn.load(std::memory_order_acquire) != position) {
+        std::this_thread::yield();
+    }
+}
+
+void Journal::writer_thread() {
+    while (running_.load(std::memory_order_acquire)) {
+        bool busy = drain();
+        maybe_sync(false);
+        if (!busy) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+
+    // Write whatever was appended before shutdown
+    drain();
+    maybe_sync(true);
+}
+
+bool Journal::drain() {
+    uint64_t start = head_;
+    for (;;) {
+        Slot& slot = slots_[head_ & (RING_CAPACITY - 1)];
+        if (slot.turn.load(std::memory_order_acquire) != head_ + 1) {
+            break; // Not published yet; later records wait so the journal stays in order
+        }
+        write_record(slot);
+        slot.turn.store(head_ + RING_CAPACITY, std::memory_order_release);
+        ++head_;
+    }
+    if (head_ == start) {
+        return false;
+    }
+    written_.store(head_, std::memory_order_release);
+    return true;
+}
+
+void Journal::write_record(const Slot& slot) {
+    size_t span = record_span(slot.header.length);
+    if (map_ && offset_ + span > config_.segment_bytes) {
+        close_segment();
+        open_segment();
+    }
+    if (!map_) {
+        return; // Segment creation failed and was logged; the record is lost
+    }
+
+    // Frame before header, so a record with a length is complete
+    uint8_t* out = map_ + offset_;
+    std::memcpy(out + sizeof(JournalRecordHeader), slot.frame, slot.header.length - sizeof(JournalRecordHeader));
+    std::memcpy(out, &slot.header, sizeof(JournalRecordHeader));
+    offset_ += span;
+
+    if (unsynced_records_++ == 0) {
+        first_unsynced_ = std::chrono::steady_clock::now();
+    }
+}
+
+void Journal::maybe_sync(bool force) {
+    if (unsynced_records_ == 0) {
+        return;
+    }
+    if (config_.sync != JournalSync::NONE && !force && unsynced_records_ < config_.sync_batch &&
+        std::chrono::steady_clock::now() - first_unsynced_ < std::chrono::microseconds(config_.sync_interval_us)) {
+        return;
+    }
+
+    if (map_) {
+        if (config_.sync == JournalSync::MSYNC) {
+            size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            size_t start = synced_offset_ & ~(page - 1);
+            if (msync(map_ + start, offset_ - start, MS_SYNC) < 0) {
+                HFT_LOG_ERROR("Journal msync failed: {}", LogErrno{errno});
+            }
+        } else if (config_.sync == JournalSync::FDATASYNC) {
+            if (fdatasync(fd_) < 0) {
+                HFT_LOG_ERROR("Journal fdatasync failed: {}", LogErrno{errno});
+            }
+        }
+    }
+    synced_offset_ = offset_;
+    unsynced_records_ = 0;
+    synced_sequence_.store(first_sequence_ + head_ - 1, std::memory_order_release);
+}
+
+bool Journal::open_segment() {
+    std::string path = segment_path(config_.directory, segment_index_ + 1);
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        HFT_LOG_ERROR("Cannot create journal segment {}: {}", segment_index_ + 1, LogErrno{errno});
+        return false;
+    }
+
+    // Allocate every block now so appends never extend the file
+    int error = posix_fallocate(fd, 0, static_cast<off_t>(config_.segment_bytes));
+    if (error != 0) {
+        HFT_LOG_ERROR("Cannot preallocate journal segment {}: {}", segment_index_ + 1, LogErrno{error});
+        ::close(fd);
+        unlink(path.c_str());
+        return false;
+    }
+    void* map = mmap(nullptr, config_.segment_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    if (map == MAP_FAILED) {
+        HFT_LOG_ERROR("Cannot map journal segment {}: {}", segment_index_ + 1, LogErrno{errno});
+        ::close(fd);
+        unlink(path.c_str());
+        return false;
+    }
+
+    ++segment_index_;
+    fd_ = fd;
+    map_ = static_cast<uint8_t*>(map);
+
+    JournalSegmentHeader header{};
+    std::memcpy(header.magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC));
+    header.version = SEGMENT_VERSION;
+    header.header_size = sizeof(header);
+    header.index = segment_index_;
+    header.first_sequence = first_sequence_ + head_;
+    std::memcpy(map_, &header, sizeof(header));
+    offset_ = sizeof(header);
+    synced_offset_ = 0;
+    return true;
+}
+
+void Journal::close_segment() {
+    if (!map_) {
+        return;
+    }
+    maybe_sync(true);
+    munmap(map_, config_.segment_bytes);
+    map_ = nullptr;
+
+    // Give back the unused preallocation; readers stop at the end of the file
+    if (ftruncate(fd_, static_cast<off_t>(offset_)) < 0) {
+        HFT_LOG_WARN("Cannot truncate journal segment {}: {}", segment_index_, LogErrno{errno});
+    }
+    ::close(fd_);
+    fd_ = -1;
+}
+
+} // namespace hft
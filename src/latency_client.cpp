@@ -113,22 +113,14 @@ void LatencyTestClient::run_latency_test(size_t num_messages, uint32_t message_i
     
     reset_stats();
     
-    auto start_time = std::chrono::high_resolution_clock::now();
+    uint64_t start_ns = Clock::monotonic_ns();
     
     for (size_t i = 0; i < num_messages; ++i) {
-        Message msg = create_test_message();
+        OrderMessage msg = create_test_message();
         msg.message_id = message_id_dist_(gen_);
         msg.update_timestamp();
         
-        auto send_time = std::chrono::high_resolution_clock::now();
         send_message(msg);
-        
-        // Store send time for latency calculation
-        {
-            std::lock_guard<std::mutex> lock(latency_mutex_);
-            latency_measurements_.push_back(send_time.time_since_epoch().count());
-        }
-        
         messages_sent_++;
         
         if (message_interval_ms > 0) {
@@ -136,13 +128,12 @@ void LatencyTestClient::run_latency_test(size_t num_messages, uint32_t message_i
         }
     }
     
-    auto end_time = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+    uint64_t duration_ms = (Clock::monotonic_ns() - start_ns) / 1000000;
     
     // Wait for responses
     std::this_thread::sleep_for(std::chrono::milliseconds(1000));
     
-    std::cout << "\nTest completed in " << duration.count() << "ms" << std::endl;
+    std::cout << "\nTest completed in " << duration_ms << "ms" << std::endl;
     print_stats();
 }
 
@@ -160,23 +151,16 @@ void LatencyTestClient::run_burst_test(size_t burst_size, size_t num_bursts, uin
     
     reset_stats();
     
-    auto start_time = std::chrono::high_resolution_clock::now();
+    uint64_t start_ns = Clock::monotonic_ns();
     
     for (size_t burst = 0; burst < num_bursts; ++burst) {
         // Send burst
         for (size_t i = 0; i < burst_size; ++i) {
-            Message msg = create_test_message();
+            OrderMessage msg = create_test_message();
             msg.message_id = message_id_dist_(gen_);
             msg.update_timestamp();
             
-            auto send_time = std::chrono::high_resolution_clock::now();
             send_message(msg);
-            
-            {
-                std::lock_guard<std::mutex> lock(latency_mutex_);
-                latency_measurements_.push_back(send_time.time_since_epoch().count());
-            }
-            
             messages_sent_++;
         }
         
@@ -185,13 +169,12 @@ void LatencyTestClient::run_burst_test(size_t burst_size, size_t num_bursts, uin
         }
     }
     
-    auto end_time = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+    uint64_t duration_ms = (Clock::monotonic_ns() - start_ns) / 1000000;
     
     // Wait for responses
     std::this_thread::sleep_for(std::chrono::milliseconds(1000));
     
-    std::cout << "\nBurst test completed in " << duration.count() << "ms" << std::endl;
+    std::cout << "\nBurst test completed in " << duration_ms << "ms" << std::endl;
     print_stats();
 }
 
@@ -208,43 +191,40 @@ void LatencyTestClient::run_sustained_test(uint32_t duration_seconds, uint32_t m
     
     reset_stats();
     
-    auto start_time = std::chrono::high_resolution_clock::now();
-    auto end_time = start_time + std::chrono::seconds(duration_seconds);
+    uint64_t start_ns = Clock::monotonic_ns();
+    uint64_t end_ns = start_ns + static_cast<uint64_t>(duration_seconds) * 1000000000ULL;
     
     uint32_t message_interval_us = 1000000 / messages_per_second; // microseconds between messages
     
-    while (std::chrono::high_resolution_clock::now() < end_time) {
-        Message msg = create_test_message();
+    while (Clock::monotonic_ns() < end_ns) {
+        OrderMessage msg = create_test_message();
         msg.message_id = message_id_dist_(gen_);
         msg.update_timestamp();
         
-        auto send_time = std::chrono::high_resolution_clock::now();
         send_message(msg);
-        
-        {
-            std::lock_guard<std::mutex> lock(latency_mutex_);
-            latency_measurements_.push_back(send_time.time_since_epoch().count());
-        }
-        
         messages_sent_++;
         
         std::this_thread::sleep_for(std::chrono::microseconds(message_interval_us));
     }
     
-    auto actual_end_time = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(actual_end_time - start_time);
+    uint64_t duration_ms = (Clock::monotonic_ns() - start_ns) / 1000000;
     
     // Wait for responses
     std::this_thread::sleep_for(std::chrono::milliseconds(1000));
     
-    std::cout << "\nSustained test completed in " << duration.count() << "ms" << std::endl;
+    std::cout << "\nSustained test completed in " << duration_ms << "ms" << std::endl;
     print_stats();
 }
 
-void LatencyTestClient::send_message(const Message& msg) {
+void LatencyTestClient::send_message(const OrderMessage& msg) {
     if (!connected_) return;
     
-    ssize_t bytes_sent = send(socket_fd_, &msg, sizeof(msg), MSG_NOSIGNAL);
+    uint8_t frame[wire::MAX_FRAME_SIZE];
+    size_t length = wire::encode(msg, frame);
+    
+    // Recorded first: the response can arrive before send() returns
+    requests_.record(msg.message_id, {Clock::monotonic_ns(), msg.timestamp});
+    ssize_t bytes_sent = send(socket_fd_, frame, length, MSG_NOSIGNAL);
     if (bytes_sent == -1) {
         errors_++;
         std::cerr << "Send failed: " << strerror(errno) << std::endl;
@@ -252,35 +232,41 @@ void LatencyTestClient::send_message(const Message& msg) {
 }
 
 void LatencyTestClient::receive_responses() {
-    char buffer[4096];
+    ReceiveBuffer buffer;
     
     while (!stop_receiver_) {
-        ssize_t bytes_received = recv(socket_fd_, buffer, sizeof(buffer), MSG_DONTWAIT);
+        buffer.compact(wire::MAX_FRAME_SIZE);
+        ssize_t bytes_received = recv(socket_fd_, buffer.write_ptr(), buffer.writable(), MSG_DONTWAIT);
         
         if (bytes_received > 0) {
-                // Process received messages
-                size_t offset = 0;
-                while (offset + sizeof(Message) <= static_cast<size_t>(bytes_received)) {
-                    // const Message* msg = reinterpret_cast<const Message*>(buffer + offset);
+                buffer.commit(static_cast<size_t>(bytes_received));
                 
-                // Calculate latency
-                auto receive_time = std::chrono::high_resolution_clock::now();
-                auto receive_ns = receive_time.time_since_epoch().count();
+                // Process every complete frame, keeping any partial tail
+                size_t frame_length;
+                while ((frame_length = wire::frame_length(buffer.read_ptr(), buffer.readable())) != 0) {
+                    if (frame_length == wire::INVALID_FRAME) {
+                        errors_++;
+                        buffer.clear();
+                        break;
+                    }
                 
-                // Find matching send time
-                {
-                    std::lock_guard<std::mutex> lock(latency_mutex_);
-                    if (!latency_measurements_.empty()) {
-                        auto send_ns = latency_measurements_.front();
-                        latency_measurements_.erase(latency_measurements_.begin());
-                        
-                        uint64_t latency_ns = receive_ns - send_ns;
-                        update_latency_stats(latency_ns);
+                // Acks echo the request's message_id; fills and market data are not timed
+                LatencyStamp received{Clock::monotonic_ns(), Message::get_current_timestamp()};
+                Message response;
+                if (wire::decode(buffer.read_ptr(), frame_length, response) &&
+                    (response.message_type == MessageType::ORDER_NEW ||
+                     response.message_type == MessageType::ORDER_REJECT)) {
+                    LatencyStamp sent;
+                    if (requests_.take(response.message_id, sent)) {
+                        update_latency_stats(sent, received, response.timestamp);
+                    } else {
+                        unmatched_++;
                     }
                 }
                 
                 messages_received_++;
-                offset += sizeof(Message);
+                last_response_ns_.store(received.monotonic_ns, std::memory_order_relaxed);
+                buffer.consume(frame_length);
             }
         } else if (bytes_received == 0) {
             // Server disconnected
@@ -290,13 +276,25 @@ void LatencyTestClient::receive_responses() {
             break;
         }
         
-        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        if (bytes_received < 0 && !spin_.load(std::memory_order_relaxed)) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
     }
 }
 
-void LatencyTestClient::update_latency_stats(uint64_t latency_ns) {
+void LatencyTestClient::update_latency_stats(const LatencyStamp& sent, const LatencyStamp& received,
+                                             uint64_t server_ns) {
+    uint64_t latency_ns = received.monotonic_ns - sent.monotonic_ns;
+    round_trip_histogram_.record(latency_ns);
+    round_trips_++;
     total_latency_ns_ += latency_ns;
     
+    // The server's timestamp splits the round trip only if all three clocks agree on the order
+    if (sent.wall_ns <= server_ns && server_ns <= received.wall_ns) {
+        outbound_histogram_.record(server_ns - sent.wall_ns);
+        inbound_histogram_.record(received.wall_ns - server_ns);
+    }
+    
     uint64_t current_min = min_latency_ns_.load();
     while (latency_ns < current_min && !min_latency_ns_.compare_exchange_weak(current_min, latency_ns)) {
         // Retry if another thread updated min_latency_ns_
@@ -309,32 +307,21 @@ void LatencyTestClient::update_latency_stats(uint64_t latency_ns) {
 }
 
 void LatencyTestClient::calculate_percentiles() const {
-    std::lock_guard<std::mutex> lock(latency_mutex_);
-    
-    if (latency_measurements_.empty()) return;
-    
-    std::vector<uint64_t> sorted_measurements = latency_measurements_;
-    std::sort(sorted_measurements.begin(), sorted_measurements.end());
+    HistogramSnapshot snapshot;
+    snapshot.merge(round_trip_histogram_);
     
-    size_t size = sorted_measurements.size();
-    if (size > 0) {
-        p50_latency_us = sorted_measurements[size * 0.5] / 1000.0;
-        p95_latency_us = sorted_measurements[size * 0.95] / 1000.0;
-        p99_latency_us = sorted_measurements[size * 0.99] / 1000.0;
-        p99_9_latency_us = sorted_measurements[size * 0.999] / 1000.0;
-    }
+    p50_latency_us = snapshot.value_at_percentile(50.0) / 1000.0;
+    p95_latency_us = snapshot.value_at_percentile(95.0) / 1000.0;
+    p99_latency_us = snapshot.value_at_percentile(99.0) / 1000.0;
+    p99_9_latency_us = snapshot.value_at_percentile(99.9) / 1000.0;
 }
 
-Message LatencyTestClient::create_test_message() {
-    Message msg;
-    msg.message_type = MessageType::ORDER_NEW;
-    msg.status = MessageStatus::PENDING;
-    msg.source_id = 1;
-    msg.destination_id = 0;
-    msg.payload_size = sizeof(OrderMessage);
-    
-    // Create order message in payload
+OrderMessage LatencyTestClient::create_test_message() {
     OrderMessage order;
+    order.message_type = MessageType::ORDER_NEW;
+    order.status = MessageStatus::PENDING;
+    order.source_id = 1;
+    order.destination_id = 0;
     order.side = OrderSide::BUY;
     order.order_type = OrderType::LIMIT;
     order.time_in_force = TimeInForce::DAY;
@@ -346,10 +333,7 @@ Message LatencyTestClient::create_test_message() {
     std::strncpy(order.symbol.data(), symbol.c_str(), order.symbol.size() - 1);
     order.symbol[order.symbol.size() - 1] = '\0';
     
-    // Copy order to message payload
-    std::memcpy(msg.payload.data(), &order, sizeof(order));
-    
-    return msg;
+    return order;
 }
 
 void LatencyTestClient::setup_socket_options(int sock_fd) {
@@ -377,21 +361,31 @@ LatencyTestClient::TestStats LatencyTestClient::get_stats() const {
     TestStats stats{};
     stats.total_messages_sent = messages_sent_.load();
     stats.total_messages_received = messages_received_.load();
+    stats.round_trips = round_trips_.load();
+    stats.unmatched_responses = unmatched_.load();
     stats.total_latency_ns = total_latency_ns_.load();
     stats.min_latency_ns = min_latency_ns_.load();
     stats.max_latency_ns = max_latency_ns_.load();
-    stats.avg_latency_us = (messages_received_.load() > 0) ? 
-                          (total_latency_ns_.load() / 1000.0) / messages_received_.load() : 0.0;
+    stats.avg_latency_us = (stats.round_trips > 0) ? 
+                          (total_latency_ns_.load() / 1000.0) / stats.round_trips : 0.0;
     stats.p50_latency_us = p50_latency_us;
     stats.p95_latency_us = p95_latency_us;
     stats.p99_latency_us = p99_latency_us;
     stats.p99_9_latency_us = p99_9_latency_us;
+    
+    HistogramSnapshot outbound;
+    HistogramSnapshot inbound;
+    outbound.merge(outbound_histogram_);
+    inbound.merge(inbound_histogram_);
+    stats.avg_outbound_us = outbound.mean() / 1000.0;
+    stats.avg_inbound_us = inbound.mean() / 1000.0;
     stats.errors = errors_.load();
     
-    // Calculate throughput
-    auto now = std::chrono::high_resolution_clock::now();
-    stats.throughput_mps = (messages_received_.load() > 0) ? 
-                          messages_received_.load() / 1.0 : 0.0; // Simplified for now
+    // Responses per second, from the start of the test to the last response
+    uint64_t start_ns = test_start_ns_.load(std::memory_order_relaxed);
+    uint64_t last_ns = last_response_ns_.load(std::memory_order_relaxed);
+    stats.throughput_mps = (last_ns > start_ns) ?
+                          stats.total_messages_received * 1e9 / (last_ns - start_ns) : 0.0;
     
     return stats;
 }
@@ -408,8 +402,12 @@ void LatencyTestClient::print_stats() const {
                   (double)stats.total_messages_received / stats.total_messages_sent * 100.0 : 0.0) 
               << "%" << std::endl;
     
-    if (stats.total_messages_received > 0) {
-        std::cout << "\n--- Latency Statistics ---" << std::endl;
+    if (stats.round_trips > 0) {
+        std::cout << "\n--- Latency Statistics (round trip) ---" << std::endl;
+        std::cout << "Matched responses: " << stats.round_trips << std::endl;
+        std::cout << "Unmatched responses: " << stats.unmatched_responses << std::endl;
+        std::cout << "Throughput: " << std::fixed << std::setprecision(2)
+                  << stats.throughput_mps << " msg/s" << std::endl;
         std::cout << "Average latency: " << std::fixed << std::setprecision(2) 
                   << stats.avg_latency_us << " μs" << std::endl;
         std::cout << "Minimum latency: " << stats.min_latency_ns / 1000.0 << " μs" << std::endl;
@@ -422,6 +420,10 @@ void LatencyTestClient::print_stats() const {
                   << stats.p99_latency_us << " μs" << std::endl;
         std::cout << "P99.9 latency: " << std::fixed << std::setprecision(2) 
                   << stats.p99_9_latency_us << " μs" << std::endl;
+        if (stats.avg_outbound_us > 0.0 || stats.avg_inbound_us > 0.0) {
+            std::cout << "Average outbound leg: " << stats.avg_outbound_us << " μs" << std::endl;
+            std::cout << "Average inbound leg: " << stats.avg_inbound_us << " μs" << std::endl;
+        }
         
         // Performance assessment
         std::cout << "\n--- Performance Assessment ---" << std::endl;
@@ -442,15 +444,19 @@ void LatencyTestClient::print_stats() const {
 void LatencyTestClient::reset_stats() {
     messages_sent_ = 0;
     messages_received_ = 0;
+    round_trips_ = 0;
+    unmatched_ = 0;
     total_latency_ns_ = 0;
     min_latency_ns_ = UINT64_MAX;
     max_latency_ns_ = 0;
     errors_ = 0;
+    last_response_ns_ = 0;
+    test_start_ns_ = Clock::monotonic_ns();
     
-    {
-        std::lock_guard<std::mutex> lock(latency_mutex_);
-        latency_measurements_.clear();
-    }
+    // Called between tests, while the receiver has nothing left to record
+    round_trip_histogram_.reset();
+    outbound_histogram_.reset();
+    inbound_histogram_.reset();
 }
 
 } // namespace hft
@@ -33,6 +33,7 @@ int main(int argc, char* argv[]) {
     uint32_t burst_interval_ms = 100;
     uint32_t duration_seconds = 60;
     uint32_t messages_per_second = 1000;
+    bool spin = false;
     
     // Parse command line arguments
     for (int i = 1; i < argc; ++i) {
@@ -57,6 +58,8 @@ int main(int argc, char* argv[]) {
             duration_seconds = std::stoul(argv[++i]);
         } else if (arg == "--rate" && i + 1 < argc) {
             messages_per_second = std::stoul(argv[++i]);
+        } else if (arg == "--spin") {
+            spin = true;
         } else if (arg == "--help") {
             std::cout << "HFT Latency Test Client\n"
                       << "Usage: " << argv[0] << " [options]\n\n"
@@ -71,6 +74,7 @@ int main(int argc, char* argv[]) {
                       << "  --burst-interval <ms>  Interval between bursts (default: 100)\n"
                       << "  --duration <s>         Duration for sustained test (default: 60)\n"
                       << "  --rate <msg/s>         Messages per second for sustained test (default: 1000)\n"
+                      << "  --spin                 Busy-poll for responses instead of sleeping\n"
                       << "  --help                 Show this help message\n\n"
                       << "Examples:\n"
                       << "  " << argv[0] << " --test latency --messages 5000 --interval 0\n"
@@ -87,6 +91,7 @@ int main(int argc, char* argv[]) {
     
     // Create client
     LatencyTestClient client(server_ip, server_port);
+    client.set_spin_mode(spin);
     g_client = &client;
     
     // Set up signal handling
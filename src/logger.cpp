@@ -0,0 +1,218 @@
+#include "logger.h"
+
+#include <ctime>
+
+namespace hft {
+
+namespace {
+
+const char* level_name(LogLevel level) {
+    switch (level) {
+        case LogLevel::TRACE: return "TRACE";
+        case LogLevel::DEBUG: return "DEBUG";
+        case LogLevel::INFO:  return "INFO ";
+        case LogLevel::WARN:  return "WARN ";
+        case LogLevel::ERROR: return "ERROR";
+        default:              return "?????";
+    }
+}
+
+/**
+ * @brief Hands the thread's ring back to the logger when the thread exits
+ */
+struct ThreadRing {
+    LogRing* ring{nullptr};
+
+    ~ThreadRing() {
+        if (ring) {
+            ring->in_use.store(false, std::memory_order_release);
+        }
+    }
+};
+
+thread_local ThreadRing t_ring;
+
+} // namespace
+
+Logger& Logger::get_instance() {
+    static Logger instance;
+    return instance;
+}
+
+Logger::Logger() {
+    pending_.reserve(LogRing::CAPACITY);
+    order_.reserve(LogRing::CAPACITY);
+    output_buffer_.reserve(1 << 16);
+    writer_ = std::thread(&Logger::writer_thread, this);
+}
+
+Logger::~Logger() {
+    running_.store(false, std::memory_order_release);
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+}
+
+bool Logger::parse_level(const std::string& name, LogLevel& level) {
+    static const std::pair<const char*, LogLevel> names[] = {
+        {"trace", LogLevel::TRACE}, {"debug", LogLevel::DEBUG}, {"info", LogLevel::INFO},
+        {"warn", LogLevel::WARN}, {"error", LogLevel::ERROR}, {"off", LogLevel::OFF}
+    };
+    for (const auto& [text, value] : names) {
+        if (name == text) {
+            level = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+LogRing* Logger::thread_ring() {
+    if (!t_ring.ring) {
+        t_ring.ring = acquire_ring();
+    }
+    return t_ring.ring;
+}
+
+LogRing* Logger::acquire_ring() {
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+
+    // Reuse the ring of a thread that has exited
+    size_t count = ring_count_.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < count; ++i) {
+        bool expected = false;
+        if (rings_[i]->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            return rings_[i].get();
+        }
+    }
+
+    if (count == MAX_RINGS) {
+        return nullptr; // Records from this thread are discarded
+    }
+
+    rings_[count] = std::make_unique<LogRing>(static_cast<uint32_t>(count));
+    ring_count_.store(count + 1, std::memory_order_release);
+    return rings_[count].get();
+}
+
+void Logger::flush() {
+    size_t count = ring_count_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t target = rings_[i]->published();
+        while (rings_[i]->written() < target && writer_.joinable()) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+}
+
+void Logger::writer_thread() {
+    while (running_.load(std::memory_order_acquire)) {
+        if (!drain()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    // Write whatever was logged before shutdown
+    drain();
+}
+
+bool Logger::drain() {
+    pending_.clear();
+    output_buffer_.clear();
+
+    size_t count = ring_count_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; ++i) {
+        drained_[i] = rings_[i]->drain(pending_);
+    }
+
+    // Interleave threads by capture time; sort keys rather than the aligned records
+    order_.clear();
+    for (size_t i = 0; i < pending_.size(); ++i) {
+        order_.emplace_back(pending_[i].second.timestamp, static_cast<uint32_t>(i));
+    }
+    std::sort(order_.begin(), order_.end());
+    for (const auto& [timestamp, index] : order_) {
+        format_record(pending_[index].first, pending_[index].second);
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t dropped = rings_[i]->dropped();
+        if (dropped != reported_drops_[i]) {
+            output_buffer_ += "Logger: thread " + std::to_string(i) + " dropped " +
+                              std::to_string(dropped - reported_drops_[i]) + " records\n";
+            reported_drops_[i] = dropped;
+        }
+    }
+
+    if (!output_buffer_.empty()) {
+        fwrite(output_buffer_.data(), 1, output_buffer_.size(), output_);
+        fflush(output_);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        rings_[i]->mark_written(drained_[i]);
+    }
+
+    return !pending_.empty();
+}
+
+void Logger::format_timestamp(uint64_t timestamp) {
+    // localtime_r() is slow; redo it only when the second changes
+    uint64_t second = timestamp / 1000000000ULL;
+    if (second != cached_second_) {
+        time_t seconds = static_cast<time_t>(second);
+        tm local{};
+        localtime_r(&seconds, &local);
+        strftime(cached_time_, sizeof(cached_time_), "%Y-%m-%d %H:%M:%S", &local);
+        cached_second_ = second;
+    }
+
+    char micros[16];
+    snprintf(micros, sizeof(micros), ".%06llu ",
+             static_cast<unsigned long long>(timestamp % 1000000000ULL / 1000));
+    output_buffer_ += cached_time_;
+    output_buffer_ += micros;
+}
+
+void Logger::format_record(uint32_t ring_id, const LogRecord& record) {
+    format_timestamp(record.timestamp);
+    output_buffer_ += level_name(record.level);
+    output_buffer_ += " [";
+    output_buffer_ += std::to_string(ring_id);
+    output_buffer_ += "] ";
+
+    size_t arg = 0;
+    char number[32];
+    for (const char* p = record.format; *p; ++p) {
+        if (p[0] != '{' || p[1] != '}' || arg >= record.arg_count) {
+            output_buffer_ += *p;
+            continue;
+        }
+
+        const LogArg& value = record.args[arg];
+        switch (record.types[arg]) {
+            case LogArg::Type::INT:
+                snprintf(number, sizeof(number), "%lld", static_cast<long long>(value.i));
+                output_buffer_ += number;
+                break;
+            case LogArg::Type::UINT:
+                snprintf(number, sizeof(number), "%llu", static_cast<unsigned long long>(value.u));
+                output_buffer_ += number;
+                break;
+            case LogArg::Type::DOUBLE:
+                snprintf(number, sizeof(number), "%.3f", value.d);
+                output_buffer_ += number;
+                break;
+            case LogArg::Type::STRING:
+                output_buffer_.append(value.str, strnlen(value.str, LogArg::INLINE_STRING));
+                break;
+            case LogArg::Type::ERRNO:
+                output_buffer_ += strerror(value.err);
+                break;
+        }
+        ++arg;
+        ++p;
+    }
+    output_buffer_ += '\n';
+}
+
+} // namespace hft
@@ -1,9 +1,17 @@
 #include "hft_server.h"
+#include "instrument_registry.h"
+#include "journal.h"
+#include "logger.h"
+#include "recovery.h"
 #include <iostream>
 #include <csignal>
 #include <memory>
 #include <chrono>
 #include <thread>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
 
 namespace hft {
 
@@ -18,6 +26,31 @@ void signal_handler(int signal) {
     }
 }
 
+/**
+ * @brief Parse a CPU list such as "2,3,6-9"
+ * @return false on malformed input
+ */
+bool parse_cpu_list(const std::string& list, std::vector<int>& cpus) {
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        size_t dash = item.find('-');
+        try {
+            int first = std::stoi(item.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+            if (first < 0 || last < first) {
+                return false;
+            }
+            for (int cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+    return !cpus.empty();
+}
+
 } // namespace hft
 
 int main(int argc, char* argv[]) {
@@ -27,6 +60,18 @@ int main(int argc, char* argv[]) {
     std::string server_ip = "127.0.0.1";
     uint16_t server_port = 8888;
     size_t thread_count = 4;
+    bool sharded = false;
+    IoBackend backend = IoBackend::EPOLL;
+    HFTServer::PollingConfig polling;
+    HFTServer::OutboundConfig outbound;
+    LogLevel log_level = LogLevel::INFO;
+    std::string instrument_file;
+    JournalConfig journal_config;
+    size_t recovery_threads = 4;
+    HFTServer::SharedMemoryConfig shm_config;
+    UnixSocketConfig local;
+    MulticastConfig multicast;
+    bool multicast_enabled = false;
     
     // Parse command line arguments
     for (int i = 1; i < argc; ++i) {
@@ -37,12 +82,124 @@ int main(int argc, char* argv[]) {
             server_port = static_cast<uint16_t>(std::stoi(argv[++i]));
         } else if (arg == "--threads" && i + 1 < argc) {
             thread_count = std::stoul(argv[++i]);
+        } else if (arg == "--sharded") {
+            sharded = true;
+        } else if (arg == "--io-uring") {
+            backend = IoBackend::IO_URING;
+        } else if (arg == "--spin") {
+            polling.spin = true;
+        } else if (arg == "--busy-poll" && i + 1 < argc) {
+            polling.busy_poll_us = std::stoi(argv[++i]);
+        } else if (arg == "--cpus" && i + 1 < argc) {
+            if (!parse_cpu_list(argv[++i], polling.cpus)) {
+                std::cerr << "Invalid CPU list: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--outbound-kb" && i + 1 < argc) {
+            outbound.queue_bytes = std::stoul(argv[++i]) * 1024;
+        } else if (arg == "--slow-consumer" && i + 1 < argc) {
+            std::string policy = argv[++i];
+            if (policy == "disconnect") {
+                outbound.policy = SlowConsumerPolicy::DISCONNECT;
+            } else if (policy == "conflate") {
+                outbound.policy = SlowConsumerPolicy::CONFLATE;
+            } else if (policy == "drop") {
+                outbound.policy = SlowConsumerPolicy::DROP;
+            } else {
+                std::cerr << "Unknown slow-consumer policy: " << policy << std::endl;
+                return 1;
+            }
+        } else if (arg == "--instruments" && i + 1 < argc) {
+            instrument_file = argv[++i];
+        } else if (arg == "--max-symbols" && i + 1 < argc) {
+            InstrumentRegistry::get_instance().set_intern_limit(std::stoul(argv[++i]));
+        } else if (arg == "--journal" && i + 1 < argc) {
+            journal_config.directory = argv[++i];
+        } else if (arg == "--journal-sync" && i + 1 < argc) {
+            std::string mode = argv[++i];
+            if (mode == "none") {
+                journal_config.sync = JournalSync::NONE;
+            } else if (mode == "msync") {
+                journal_config.sync = JournalSync::MSYNC;
+            } else if (mode == "fdatasync") {
+                journal_config.sync = JournalSync::FDATASYNC;
+            } else {
+                std::cerr << "Unknown journal sync mode: " << mode << std::endl;
+                return 1;
+            }
+        } else if (arg == "--journal-batch" && i + 1 < argc) {
+            journal_config.sync_batch = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--journal-sync-us" && i + 1 < argc) {
+            journal_config.sync_interval_us = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--journal-mb" && i + 1 < argc) {
+            journal_config.segment_bytes = std::stoul(argv[++i]) << 20;
+        } else if (arg == "--recovery-threads" && i + 1 < argc) {
+            recovery_threads = std::stoul(argv[++i]);
+        } else if (arg == "--shm" && i + 1 < argc) {
+            shm_config.name = argv[++i];
+        } else if (arg == "--shm-sessions" && i + 1 < argc) {
+            shm_config.sessions = std::stoul(argv[++i]);
+        } else if (arg == "--shm-ring-kb" && i + 1 < argc) {
+            shm_config.ring_bytes = std::stoul(argv[++i]) * 1024;
+        } else if (arg == "--unix" && i + 1 < argc) {
+            local.path = argv[++i];
+        } else if (arg == "--unix-seqpacket") {
+            local.seqpacket = true;
+        } else if (arg == "--multicast" && i + 1 < argc) {
+            std::string endpoint = argv[++i];
+            size_t colon = endpoint.rfind(':');
+            multicast.group = endpoint.substr(0, colon);
+            if (colon != std::string::npos) {
+                multicast.port = static_cast<uint16_t>(std::stoi(endpoint.substr(colon + 1)));
+            }
+            multicast_enabled = true;
+        } else if (arg == "--multicast-if" && i + 1 < argc) {
+            multicast.interface = argv[++i];
+        } else if (arg == "--multicast-ttl" && i + 1 < argc) {
+            multicast.ttl = std::stoi(argv[++i]);
+        } else if (arg == "--retransmit-frames" && i + 1 < argc) {
+            multicast.retransmit_frames = std::stoul(argv[++i]);
+        } else if (arg == "--log-level" && i + 1 < argc) {
+            if (!Logger::parse_level(argv[++i], log_level)) {
+                std::cerr << "Unknown log level: " << argv[i] << std::endl;
+                return 1;
+            }
         } else if (arg == "--help") {
             std::cout << "Usage: " << argv[0] << " [options]\n"
                       << "Options:\n"
                       << "  --ip <ip>        Server IP address (default: 127.0.0.1)\n"
                       << "  --port <port>    Server port (default: 8888)\n"
                       << "  --threads <n>    Number of worker threads (default: 4)\n"
+                      << "  --sharded        One SO_REUSEPORT listener and epoll per worker\n"
+                      << "  --io-uring       Use the io_uring I/O backend instead of epoll\n"
+                      << "  --spin           Busy-poll in workers instead of sleeping in the kernel\n"
+                      << "  --busy-poll <us> Set SO_BUSY_POLL on client sockets\n"
+                      << "  --cpus <list>    Pin workers to CPUs, e.g. 2,3,6-9\n"
+                      << "  --outbound-kb <n> Per-connection outbound queue size (default: 64)\n"
+                      << "  --slow-consumer <p> disconnect|conflate|drop market data for full\n"
+                      << "                   queues (default: disconnect)\n"
+                      << "  --instruments <file> Fixed instrument table, one symbol per line\n"
+                      << "                   (default: intern symbols on first use)\n"
+                      << "  --max-symbols <n> Symbols taken on first use without --instruments\n"
+                      << "                   (default: 1024)\n"
+                      << "  --journal <dir>  Journal orders, fills and market data to <dir>\n"
+                      << "  --journal-sync <m> none|msync|fdatasync (default: none)\n"
+                      << "  --journal-batch <n> Sync after n records (default: 256)\n"
+                      << "  --journal-sync-us <us> Or once a record waited this long (default: 1000)\n"
+                      << "  --journal-mb <n> Journal segment size, and snapshot interval (default: 64)\n"
+                      << "  --recovery-threads <n> Instrument shards replayed in parallel at\n"
+                      << "                   startup (default: 4)\n"
+                      << "  --shm <name>     Also serve local clients through /dev/shm/<name>\n"
+                      << "  --shm-sessions <n> Shared-memory session slots (default: 16)\n"
+                      << "  --shm-ring-kb <n> Ring size per direction and session (default: 1024)\n"
+                      << "  --unix <path>    Also listen on a Unix-domain socket for local tools\n"
+                      << "  --unix-seqpacket Use SOCK_SEQPACKET there: one frame per record\n"
+                      << "  --multicast <group[:port]> Also publish market data to a multicast\n"
+                      << "                   group (default port: 30001), gap fill over TCP\n"
+                      << "  --multicast-if <ip> Interface address to publish on (default: 127.0.0.1)\n"
+                      << "  --multicast-ttl <n> Multicast hops (default: 1)\n"
+                      << "  --retransmit-frames <n> Feed history kept for gap fill (default: 65536)\n"
+                      << "  --log-level <l>  trace|debug|info|warn|error|off (default: info)\n"
                       << "  --help           Show this help message\n";
             return 0;
         }
@@ -52,9 +209,36 @@ int main(int argc, char* argv[]) {
     std::cout << "Server IP: " << server_ip << std::endl;
     std::cout << "Server Port: " << server_port << std::endl;
     std::cout << "Worker Threads: " << thread_count << std::endl;
+    std::cout << "Reactor Mode: " << (sharded ? "sharded" : "shared") << std::endl;
+    std::cout << "I/O Backend: " << (backend == IoBackend::IO_URING ? "io_uring" : "epoll") << std::endl;
+    std::cout << "Polling: " << (polling.spin ? "spin" : "blocking");
+    if (polling.busy_poll_us > 0) {
+        std::cout << ", SO_BUSY_POLL " << polling.busy_poll_us << "us";
+    }
+    if (!polling.cpus.empty()) {
+        std::cout << ", CPUs";
+        for (int cpu : polling.cpus) {
+            std::cout << " " << cpu;
+        }
+    }
+    std::cout << std::endl;
+    if (!instrument_file.empty()) {
+        if (!InstrumentRegistry::get_instance().load(instrument_file)) {
+            return 1;
+        }
+        std::cout << "Instruments: " << InstrumentRegistry::get_instance().size() << " from "
+                  << instrument_file << std::endl;
+    }
+    if (!journal_config.directory.empty()) {
+        static const char* sync_names[] = {"none", "msync", "fdatasync"};
+        std::cout << "Journal: " << journal_config.directory << ", sync "
+                  << sync_names[static_cast<int>(journal_config.sync)] << std::endl;
+    }
     std::cout << "Target Latency: < 20μs" << std::endl;
     std::cout << "==========================" << std::endl;
     
+    Logger::get_instance().set_level(log_level);
+    
     // Get server instance
     HFTServer& server = HFTServer::get_instance();
     g_server = &server;
@@ -64,19 +248,58 @@ int main(int argc, char* argv[]) {
     signal(SIGTERM, signal_handler);
     
     // Initialize server
-    if (!server.initialize(server_ip, server_port, thread_count)) {
+    if (!server.initialize(server_ip, server_port, thread_count, sharded, backend, local)) {
         std::cerr << "Failed to initialize HFT server" << std::endl;
         return 1;
     }
     
+    if (!shm_config.name.empty() && !server.enable_shared_memory(shm_config)) {
+        return 1;
+    }
+    
+    server.set_polling(polling);
+    server.set_outbound(outbound);
+    
     // Create and register services
     auto order_service = std::make_shared<OrderService>();
     auto market_data_service = std::make_shared<MarketDataService>();
     
+    // Rebuild sequence numbers and market data from the journal before taking traffic
+    Checkpointer checkpointer;
+    if (!journal_config.directory.empty()) {
+        auto recovery_start = std::chrono::steady_clock::now();
+        JournalState state(recovery_threads);
+        if (!state.recover(journal_config.directory)) {
+            return 1;
+        }
+        
+        // Open first: the orders of sessions cut off by the stop are cancelled through the journal
+        if (!Journal::get_instance().open(journal_config)) {
+            return 1;
+        }
+        size_t orders = order_service->restore(state.orders(), state.last_fill_id());
+        size_t instruments = market_data_service->restore(state.market_data());
+        auto recovery_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - recovery_start).count();
+        std::cout << "Recovered " << instruments << " instruments at sequence " << state.sequence()
+                  << ", cancelling " << orders << " orders of disconnected sessions ("
+                  << state.replayed() << " records replayed) in " << recovery_us / 1000.0 << " ms" << std::endl;
+        checkpointer.start(journal_config.directory, std::move(state));
+    }
+    
+    // After recovery: the feed starts a new session, so receivers resynchronize from a snapshot
+    if (multicast_enabled && !market_data_service->enable_multicast(multicast)) {
+        return 1;
+    }
+    
     server.register_service(MessageType::ORDER_NEW, order_service);
     server.register_service(MessageType::ORDER_CANCEL, order_service);
     server.register_service(MessageType::ORDER_REPLACE, order_service);
     server.register_service(MessageType::MARKET_DATA, market_data_service);
+    server.register_service(MessageType::MARKET_DATA_SUBSCRIBE, market_data_service);
+    server.register_service(MessageType::MARKET_DATA_UNSUBSCRIBE, market_data_service);
+    server.register_service(MessageType::MARKET_DATA_RETRANSMIT, market_data_service);
+    server.register_service(MessageType::MARKET_DATA_SNAPSHOT, market_data_service);
     
     std::cout << "Services registered successfully" << std::endl;
     
@@ -98,14 +321,48 @@ int main(int argc, char* argv[]) {
             std::cout << "Total Messages: " << stats.total_messages_processed << std::endl;
             std::cout << "Active Connections: " << stats.total_connections << std::endl;
             std::cout << "Peak Connections: " << stats.peak_connections << std::endl;
-            //std::cout << "Average Latency: " << std::fixed << std::setprecision(2) 
-            //< stats.avg_latency_us << " μs" << std::endl;
+            if (stats.frames_dropped + stats.frames_conflated + stats.slow_consumer_disconnects > 0) {
+                std::cout << "Slow Consumers: " << stats.frames_dropped << " dropped, "
+                          << stats.frames_conflated << " conflated, "
+                          << stats.slow_consumer_disconnects << " disconnected" << std::endl;
+            }
+            if (Journal::get_instance().enabled()) {
+                const Journal& journal = Journal::get_instance();
+                std::cout << "Journal: sequence " << journal.last_sequence() << ", synced "
+                          << journal.synced_sequence() << ", " << journal.stalls()
+                          << " stalls" << std::endl;
+            }
+            if (multicast_enabled) {
+                const MulticastPublisher& feed = market_data_service->multicast();
+                std::cout << "Multicast: " << feed.frames_published() << " frames, "
+                          << feed.send_errors() << " send errors" << std::endl;
+            }
+            
+            // Processing latency percentiles, overall and per message class
+            std::cout << std::fixed << std::setprecision(2);
+            std::cout << std::left << std::setw(14) << "Latency (μs)" << std::right
+                      << std::setw(10) << "count" << std::setw(9) << "p50"
+                      << std::setw(9) << "p99" << std::setw(9) << "p99.9"
+                      << std::setw(9) << "p99.99" << std::setw(9) << "max" << std::endl;
+            auto print_latency = [](const char* name, const HFTServer::LatencySummary& latency) {
+                std::cout << std::left << std::setw(13) << name << std::right
+                          << std::setw(10) << latency.count << std::setw(9) << latency.p50_us
+                          << std::setw(9) << latency.p99_us << std::setw(9) << latency.p999_us
+                          << std::setw(9) << latency.p9999_us << std::setw(9) << latency.max_us
+                          << std::endl;
+            };
+            for (size_t type = 0; type < HFTServer::STATS_TYPE_COUNT; ++type) {
+                if (stats.latency_by_type[type].count > 0) {
+                    print_latency(HFTServer::stats_type_name(type), stats.latency_by_type[type]);
+                }
+            }
+            print_latency("ALL", stats.latency);
             
-            // Check if we're meeting latency requirements
-            if (stats.avg_latency_us < 20.0) {
-                std::cout << "✓ Latency target met (< 20μs)" << std::endl;
+            // Check the latency target against the tail, not the average
+            if (stats.latency.p99_us < 20.0) {
+                std::cout << "✓ Latency target met (p99 < 20μs)" << std::endl;
             } else {
-                std::cout << "⚠ Latency target exceeded: " << stats.avg_latency_us << "μs" << std::endl;
+                std::cout << "⚠ Latency target exceeded: p99 " << stats.latency.p99_us << "μs" << std::endl;
             }
             std::cout << "========================" << std::endl;
             
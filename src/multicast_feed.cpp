@@ -0,0 +1,255 @@
+#include "multicast_feed.h"
+
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+namespace hft {
+
+namespace {
+
+constexpr int SOCKET_BUFFER_BYTES = 4 * 1024 * 1024;
+
+bool parse_address(const std::string& text, in_addr& addr, const char* what) {
+    if (inet_pton(AF_INET, text.c_str(), &addr) != 1) {
+        std::cerr << "Invalid multicast " << what << ": " << text << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool parse_group(const MulticastConfig& config, sockaddr_in& group) {
+    group = sockaddr_in{};
+    group.sin_family = AF_INET;
+    group.sin_port = htons(config.port);
+    if (!parse_address(config.group, group.sin_addr, "group")) {
+        return false;
+    }
+    if (!IN_MULTICAST(ntohl(group.sin_addr.s_addr))) {
+        std::cerr << "Not a multicast group: " << config.group << std::endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+// MulticastPublisher implementation
+bool MulticastPublisher::open(const MulticastConfig& config) {
+    close();
+    in_addr interface{};
+    if (!parse_group(config, group_) || !parse_address(config.interface, interface, "interface")) {
+        return false;
+    }
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd == -1) {
+        std::cerr << "Failed to create multicast socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+    int ttl = config.ttl;
+    int loopback = config.loopback ? 1 : 0;
+    int buffer = SOCKET_BUFFER_BYTES;
+    if (setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &interface, sizeof(interface)) == -1 ||
+        setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) == -1 ||
+        setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loopback, sizeof(loopback)) == -1) {
+        std::cerr << "Failed to configure multicast on " << config.interface << ": " << strerror(errno) << std::endl;
+        ::close(fd);
+        return false;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buffer, sizeof(buffer));
+
+    size_t capacity = 1;
+    while (capacity < config.retransmit_frames) {
+        capacity <<= 1;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    fd_ = fd;
+    session_ = Message::get_current_timestamp();
+    heartbeat_ms_ = config.heartbeat_ms;
+    next_sequence_ = 1;
+    history_.assign(capacity, nullptr);
+    history_mask_ = capacity - 1;
+    last_send_ = std::chrono::steady_clock::now();
+    stopping_ = false;
+    if (heartbeat_ms_ > 0) {
+        heartbeat_thread_ = std::thread(&MulticastPublisher::heartbeat_thread_func, this);
+    }
+    return true;
+}
+
+void MulticastPublisher::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    heartbeat_cv_.notify_all();
+    if (heartbeat_thread_.joinable()) {
+        heartbeat_thread_.join();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (fd_ != -1) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    for (auto* frames : {&history_, &latest_}) {
+        for (SharedFrame* frame : *frames) {
+            if (frame) {
+                frame->release();
+            }
+        }
+        frames->clear();
+    }
+}
+
+void MulticastPublisher::publish(InstrumentId instrument, SharedFrame* frame) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (fd_ == -1) {
+        return;
+    }
+
+    // The history and the latest-value table each hold a reference
+    SharedFrame*& slot = history_[next_sequence_ & history_mask_];
+    if (slot) {
+        slot->release();
+    }
+    frame->retain();
+    slot = frame;
+    if (instrument >= latest_.size()) {
+        latest_.resize(static_cast<size_t>(instrument) + 1, nullptr);
+    }
+    if (latest_[instrument]) {
+        latest_[instrument]->release();
+    }
+    frame->retain();
+    latest_[instrument] = frame;
+
+    send_locked(frame);
+    ++next_sequence_;
+    published_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MulticastPublisher::send_locked(SharedFrame* frame) {
+    wire::WireFeedHeader header;
+    header.session = session_;
+    header.sequence = next_sequence_;
+    header.count = frame ? 1 : 0;
+
+    iovec iov[2];
+    iov[0] = {&header, sizeof(header)};
+    if (frame) {
+        iov[1] = {const_cast<uint8_t*>(frame->data()), frame->length()};
+    }
+    msghdr msg{};
+    msg.msg_name = &group_;
+    msg.msg_namelen = sizeof(group_);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = frame ? 2 : 1;
+
+    // Never wait on a full socket: a lost datagram is a gap receivers fill over TCP
+    if (sendmsg(fd_, &msg, MSG_DONTWAIT) == -1) {
+        send_errors_.fetch_add(1, std::memory_order_relaxed);
+    }
+    last_send_ = std::chrono::steady_clock::now();
+}
+
+bool MulticastPublisher::retransmit(uint64_t first, uint32_t count, std::vector<SharedFrame*>& out,
+                                    uint64_t& oldest) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    oldest = next_sequence_ > history_.size() ? next_sequence_ - history_.size() : 1;
+    if (first < oldest) {
+        return false;
+    }
+    for (uint64_t sequence = first; sequence < next_sequence_ && out.size() < count; ++sequence) {
+        SharedFrame* frame = history_[sequence & history_mask_];
+        frame->retain();
+        out.push_back(frame);
+    }
+    return true;
+}
+
+uint64_t MulticastPublisher::snapshot(std::vector<SharedFrame*>& out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (SharedFrame* frame : latest_) {
+        if (frame) {
+            frame->retain();
+            out.push_back(frame);
+        }
+    }
+    return next_sequence_ - 1;
+}
+
+void MulticastPublisher::heartbeat_thread_func() {
+    auto interval = std::chrono::milliseconds(heartbeat_ms_);
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        heartbeat_cv_.wait_until(lock, last_send_ + interval, [this] { return stopping_; });
+        if (!stopping_ && std::chrono::steady_clock::now() >= last_send_ + interval) {
+            send_locked(nullptr);
+        }
+    }
+}
+
+// MulticastReceiver implementation
+bool MulticastReceiver::open(const MulticastConfig& config) {
+    close();
+    sockaddr_in group{};
+    ip_mreq membership{};
+    if (!parse_group(config, group) || !parse_address(config.interface, membership.imr_interface, "interface")) {
+        return false;
+    }
+    membership.imr_multiaddr = group.sin_addr;
+
+    fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd_ == -1) {
+        std::cerr << "Failed to create multicast socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // Several receivers on one host share the port; binding the group filters out other feeds on it
+    int opt = 1;
+    int buffer = SOCKET_BUFFER_BYTES;
+    setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+    if (bind(fd_, reinterpret_cast<sockaddr*>(&group), sizeof(group)) == -1) {
+        std::cerr << "Failed to bind multicast port " << config.port << ": " << strerror(errno) << std::endl;
+        close();
+        return false;
+    }
+    if (setsockopt(fd_, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) == -1) {
+        std::cerr << "Failed to join " << config.group << " on " << config.interface << ": "
+                  << strerror(errno) << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MulticastReceiver::close() {
+    if (fd_ != -1) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+ssize_t MulticastReceiver::receive(uint8_t* buffer, size_t size, int timeout_ms) {
+    pollfd pfd{fd_, POLLIN, 0};
+    int ready = poll(&pfd, 1, timeout_ms);
+    if (ready <= 0) {
+        return ready == 0 || errno == EINTR ? 0 : -1;
+    }
+    ssize_t length = recv(fd_, buffer, size, MSG_DONTWAIT);
+    if (length == -1) {
+        return errno == EAGAIN || errno == EINTR ? 0 : -1;
+    }
+    return length;
+}
+
+} // namespace hft
@@ -0,0 +1,474 @@
+#include "order_book.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace hft {
+
+// OrderPool implementation
+OrderPool::OrderPool(size_t capacity) : nodes_(capacity), free_head_(OrderNode::NIL) {
+    // Thread every node onto the free list
+    for (size_t i = capacity; i > 0; --i) {
+        nodes_[i - 1].next = free_head_;
+        free_head_ = static_cast<uint32_t>(i - 1);
+    }
+}
+
+uint32_t OrderPool::allocate() {
+    uint32_t index = free_head_;
+    if (index != OrderNode::NIL) {
+        free_head_ = nodes_[index].next;
+        nodes_[index].prev = OrderNode::NIL;
+        nodes_[index].next = OrderNode::NIL;
+        nodes_[index].active = true;
+        // Generation 0 is never handed out, so no live order id is 0
+        if (++nodes_[index].generation == 0) {
+            nodes_[index].generation = 1;
+        }
+    }
+    return index;
+}
+
+void OrderPool::release(uint32_t index) {
+    OrderNode& node = nodes_[index];
+    if (node.owner_listed) {
+        unlink_owner(node);
+    }
+    node.active = false;
+    node.owner = nullptr;
+    node.book = nullptr;
+    node.prev = OrderNode::NIL;
+    node.next = free_head_;
+    free_head_ = index;
+}
+
+void OrderPool::link_owner(uint32_t index) {
+    OrderNode& node = nodes_[index];
+    uint32_t& head = owner_heads_.emplace(node.owner, OrderNode::NIL).first->second;
+    node.owner_prev = OrderNode::NIL;
+    node.owner_next = head;
+    if (head != OrderNode::NIL) {
+        nodes_[head].owner_prev = index;
+    }
+    head = index;
+    node.owner_listed = true;
+}
+
+void OrderPool::unlink_owner(OrderNode& node) {
+    if (node.owner_prev == OrderNode::NIL) {
+        owner_heads_.find(node.owner)->second = node.owner_next;
+    } else {
+        nodes_[node.owner_prev].owner_next = node.owner_next;
+    }
+    if (node.owner_next != OrderNode::NIL) {
+        nodes_[node.owner_next].owner_prev = node.owner_prev;
+    }
+    node.owner_prev = OrderNode::NIL;
+    node.owner_next = OrderNode::NIL;
+    node.owner_listed = false;
+}
+
+std::vector<uint32_t> OrderPool::restore(const std::vector<uint64_t>& order_ids) {
+    std::vector<uint32_t> indices;
+    indices.reserve(order_ids.size());
+    for (uint64_t order_id : order_ids) {
+        uint32_t index = static_cast<uint32_t>(order_id);
+        uint32_t generation = static_cast<uint32_t>(order_id >> 32);
+        if (index >= nodes_.size() || generation == 0 || nodes_[index].active) {
+            indices.push_back(OrderNode::NIL);
+            continue;
+        }
+        nodes_[index].active = true;
+        nodes_[index].generation = generation;
+        indices.push_back(index);
+    }
+
+    // Rethread the free list through the nodes left over
+    free_head_ = OrderNode::NIL;
+    for (size_t i = nodes_.size(); i > 0; --i) {
+        if (!nodes_[i - 1].active) {
+            nodes_[i - 1].next = free_head_;
+            free_head_ = static_cast<uint32_t>(i - 1);
+        }
+    }
+    return indices;
+}
+
+// OrderBook implementation
+OrderBook::OrderBook(OrderPool& pool, uint64_t base_price, size_t price_levels)
+    : pool_(pool), base_price_(base_price), price_levels_(price_levels),
+      bids_((price_levels + PAGE_LEVELS - 1) / PAGE_LEVELS), asks_(bids_.size()) {}
+
+MatchResult OrderBook::submit(const OrderMessage& order, Connection* owner, TradeSink& sink) {
+    MatchResult result;
+    result.remaining_quantity = order.quantity;
+
+    bool is_market = order.order_type == OrderType::MARKET;
+    if ((!is_market && order.order_type != OrderType::LIMIT) || order.quantity == 0 ||
+        (!is_market && !in_band(order.price))) {
+        result.status = MatchStatus::REJECTED;
+        return result;
+    }
+
+    uint32_t index = pool_.allocate();
+    if (index == OrderNode::NIL) {
+        result.status = MatchStatus::REJECTED;
+        return result;
+    }
+    uint64_t order_id = pool_.order_id(index);
+    result.order_id = order_id;
+
+    uint64_t limit_level = is_market ? 0 : order.price - base_price_;
+
+    // Fill or Kill: check liquidity before touching the book
+    if (order.time_in_force == TimeInForce::FOK &&
+        available(order.side, limit_level, is_market, order.quantity) < order.quantity) {
+        pool_.release(index);
+        result.status = MatchStatus::CANCELLED;
+        return result;
+    }
+
+    result.filled_quantity = match(order.side, limit_level, is_market, order.quantity,
+                                   order_id, order.client_order_id, owner, sink);
+    result.remaining_quantity = order.quantity - result.filled_quantity;
+
+    if (result.remaining_quantity == 0) {
+        pool_.release(index);
+        result.status = MatchStatus::FILLED;
+        return result;
+    }
+
+    if (is_market || order.time_in_force == TimeInForce::IOC ||
+        order.time_in_force == TimeInForce::FOK) {
+        pool_.release(index);
+        result.status = MatchStatus::CANCELLED;
+        return result;
+    }
+
+    OrderNode& node = pool_[index];
+    node.order_id = order_id;
+    node.client_order_id = order.client_order_id;
+    node.owner = owner;
+    node.book = this;
+    node.price = order.price;
+    node.remaining = result.remaining_quantity;
+    node.side = order.side;
+    rest(index, static_cast<size_t>(limit_level));
+    pool_.link_owner(index);
+
+    result.status = MatchStatus::RESTING;
+    return result;
+}
+
+uint32_t OrderBook::match(OrderSide side, uint64_t limit_level, bool is_market,
+                          uint32_t quantity, uint64_t taker_id, uint64_t taker_client_id,
+                          Connection* taker, TradeSink& sink) {
+    bool buy = side == OrderSide::BUY;
+    Levels& levels = buy ? asks_ : bids_;
+    size_t& best = buy ? best_ask_ : best_bid_;
+    uint32_t filled = 0;
+
+    Trade trade{};
+    trade.taker_order_id = taker_id;
+    trade.taker_client_order_id = taker_client_id;
+    trade.taker_owner = taker;
+    trade.taker_side = side;
+
+    while (filled < quantity && best != NO_LEVEL &&
+           (is_market || (buy ? best <= limit_level : best >= limit_level))) {
+        PriceLevel& level = level_at(levels, best);
+
+        // Walk the FIFO queue at this level
+        while (filled < quantity && level.head != OrderNode::NIL) {
+            uint32_t index = level.head;
+            OrderNode& maker = pool_[index];
+            uint32_t fill = std::min(quantity - filled, maker.remaining);
+
+            trade.maker_order_id = maker.order_id;
+            trade.maker_client_order_id = maker.client_order_id;
+            trade.maker_owner = maker.owner;
+            trade.price = maker.price;
+            trade.quantity = fill;
+            sink.on_trade(trade);
+
+            filled += fill;
+            maker.remaining -= fill;
+            level.quantity -= fill;
+
+            if (maker.remaining == 0) {
+                level.head = maker.next;
+                if (level.head == OrderNode::NIL) {
+                    level.tail = OrderNode::NIL;
+                } else {
+                    pool_[level.head].prev = OrderNode::NIL;
+                }
+                pool_.release(index);
+            }
+        }
+
+        if (level.head == OrderNode::NIL) {
+            buy ? refresh_best_ask() : refresh_best_bid();
+        }
+    }
+
+    return filled;
+}
+
+uint64_t OrderBook::available(OrderSide side, uint64_t limit_level, bool is_market,
+                              uint32_t wanted) const {
+    uint64_t total = 0;
+    if (side == OrderSide::BUY) {
+        for (size_t level = best_ask_; level != NO_LEVEL && level < price_levels_ &&
+             (is_market || level <= limit_level) && total < wanted; ++level) {
+            if (const PriceLevel* price_level = find_level(asks_, level)) {
+                total += price_level->quantity;
+            }
+        }
+    } else {
+        for (size_t level = best_bid_; level != NO_LEVEL &&
+             (is_market || level >= limit_level) && total < wanted; --level) {
+            if (const PriceLevel* price_level = find_level(bids_, level)) {
+                total += price_level->quantity;
+            }
+            if (level == 0) {
+                break;
+            }
+        }
+    }
+    return total;
+}
+
+void OrderBook::rest(uint32_t index, size_t level_index) {
+    OrderNode& node = pool_[index];
+    bool buy = node.side == OrderSide::BUY;
+    std::unique_ptr<PriceLevel[]>& page = (buy ? bids_ : asks_)[level_index / PAGE_LEVELS];
+    if (!page) {
+        page = std::make_unique<PriceLevel[]>(PAGE_LEVELS);
+    }
+    PriceLevel& level = page[level_index % PAGE_LEVELS];
+
+    node.prev = level.tail;
+    node.next = OrderNode::NIL;
+    if (level.tail == OrderNode::NIL) {
+        level.head = index;
+    } else {
+        pool_[level.tail].next = index;
+    }
+    level.tail = index;
+    level.quantity += node.remaining;
+
+    if (buy) {
+        if (best_bid_ == NO_LEVEL || level_index > best_bid_) {
+            best_bid_ = level_index;
+        }
+    } else {
+        if (best_ask_ == NO_LEVEL || level_index < best_ask_) {
+            best_ask_ = level_index;
+        }
+    }
+}
+
+void OrderBook::unlink(uint32_t index) {
+    OrderNode& node = pool_[index];
+    bool buy = node.side == OrderSide::BUY;
+    size_t level_index = static_cast<size_t>(node.price - base_price_);
+    PriceLevel& level = level_at(buy ? bids_ : asks_, level_index);
+
+    if (node.prev == OrderNode::NIL) {
+        level.head = node.next;
+    } else {
+        pool_[node.prev].next = node.next;
+    }
+    if (node.next == OrderNode::NIL) {
+        level.tail = node.prev;
+    } else {
+        pool_[node.next].prev = node.prev;
+    }
+    node.prev = OrderNode::NIL;
+    node.next = OrderNode::NIL;
+    level.quantity -= node.remaining;
+
+    if (level.head == OrderNode::NIL) {
+        if (buy && level_index == best_bid_) {
+            refresh_best_bid();
+        } else if (!buy && level_index == best_ask_) {
+            refresh_best_ask();
+        }
+    }
+}
+
+void OrderBook::reduce(uint32_t index, uint32_t quantity) {
+    OrderNode& node = pool_[index];
+    size_t level_index = static_cast<size_t>(node.price - base_price_);
+    PriceLevel& level = level_at(node.side == OrderSide::BUY ? bids_ : asks_, level_index);
+    level.quantity -= node.remaining - quantity;
+    node.remaining = quantity;
+}
+
+void OrderBook::refresh_best_bid() {
+    size_t level = best_bid_;
+    while (level != NO_LEVEL) {
+        const PriceLevel* price_level = find_level(bids_, level);
+        if (price_level && price_level->head != OrderNode::NIL) {
+            break;
+        }
+        // An absent page is skipped whole
+        size_t next = price_level ? level : level - level % PAGE_LEVELS;
+        level = (next == 0) ? NO_LEVEL : next - 1;
+    }
+    best_bid_ = level;
+}
+
+void OrderBook::refresh_best_ask() {
+    size_t level = best_ask_;
+    while (level != NO_LEVEL) {
+        const PriceLevel* price_level = find_level(asks_, level);
+        if (price_level && price_level->head != OrderNode::NIL) {
+            break;
+        }
+        size_t next = price_level ? level + 1 : level - level % PAGE_LEVELS + PAGE_LEVELS;
+        level = (next >= price_levels_) ? NO_LEVEL : next;
+    }
+    best_ask_ = level;
+}
+
+uint64_t OrderBook::best_bid() const {
+    return best_bid_ == NO_LEVEL ? 0 : base_price_ + best_bid_;
+}
+
+uint64_t OrderBook::best_ask() const {
+    return best_ask_ == NO_LEVEL ? 0 : base_price_ + best_ask_;
+}
+
+// MatchingEngine implementation
+MatchingEngine::MatchingEngine() : MatchingEngine(Config{}) {}
+
+MatchingEngine::MatchingEngine(const Config& config)
+    : config_(config), pool_(config.max_orders) {}
+
+MatchResult MatchingEngine::submit(const OrderMessage& order, Connection* owner, TradeSink& sink) {
+    if (order.instrument_id == INVALID_INSTRUMENT) {
+        return MatchResult{};
+    }
+    OrderBook& book = book_for(order.instrument_id);
+    return book.submit(order, owner, sink);
+}
+
+MatchResult MatchingEngine::cancel(uint64_t order_id, const Connection* owner) {
+    MatchResult result;
+    result.order_id = order_id;
+    result.status = MatchStatus::NOT_FOUND;
+
+    uint32_t index = pool_.find(order_id);
+    if (index == OrderNode::NIL || pool_[index].owner != owner) {
+        return result;
+    }
+
+    OrderNode& node = pool_[index];
+    result.remaining_quantity = node.remaining;
+    node.book->unlink(index);
+    pool_.release(index);
+    result.status = MatchStatus::CANCELLED;
+    return result;
+}
+
+MatchResult MatchingEngine::replace(uint64_t order_id, uint32_t quantity, uint64_t price,
+                                    Connection* owner, TradeSink& sink) {
+    MatchResult result;
+    result.order_id = order_id;
+    result.status = MatchStatus::NOT_FOUND;
+
+    uint32_t index = pool_.find(order_id);
+    if (index == OrderNode::NIL || pool_[index].owner != owner) {
+        return result;
+    }
+
+    OrderNode& node = pool_[index];
+    OrderBook& book = *node.book;
+
+    if (quantity == 0) {
+        return cancel(order_id, owner);
+    }
+
+    // Same price and smaller size: amend in place and keep queue position
+    if (price == node.price && quantity <= node.remaining) {
+        book.reduce(index, quantity);
+        result.remaining_quantity = quantity;
+        result.status = MatchStatus::RESTING;
+        return result;
+    }
+
+    if (!book.in_band(price)) {
+        result.status = MatchStatus::REJECTED;
+        result.remaining_quantity = node.remaining;
+        return result;
+    }
+
+    OrderMessage amended;
+    amended.side = node.side;
+    amended.order_type = OrderType::LIMIT;
+    amended.time_in_force = TimeInForce::GTC;
+    amended.client_order_id = node.client_order_id;
+    amended.quantity = quantity;
+    amended.price = price;
+
+    book.unlink(index);
+    pool_.release(index);
+    return book.submit(amended, owner, sink);
+}
+
+size_t MatchingEngine::remove_owner(const Connection* owner) {
+    // Releasing a node takes it off the owner's list, so the head advances
+    size_t removed = 0;
+    for (uint32_t index = pool_.first_of(owner); index != OrderNode::NIL; index = pool_.first_of(owner)) {
+        pool_[index].book->unlink(index);
+        pool_.release(index);
+        ++removed;
+    }
+    pool_.forget_owner(owner);
+    return removed;
+}
+
+size_t MatchingEngine::restore(const std::vector<RestingOrder>& orders) {
+    std::vector<uint64_t> order_ids;
+    order_ids.reserve(orders.size());
+    for (const RestingOrder& order : orders) {
+        bool valid = order.instrument != INVALID_INSTRUMENT && order.remaining > 0 &&
+                     book_for(order.instrument).in_band(order.price);
+        order_ids.push_back(valid ? order.order_id : 0);
+    }
+
+    std::vector<uint32_t> indices = pool_.restore(order_ids);
+    size_t restored = 0;
+    for (size_t i = 0; i < orders.size(); ++i) {
+        if (indices[i] == OrderNode::NIL) {
+            continue;
+        }
+        const RestingOrder& order = orders[i];
+        OrderNode& node = pool_[indices[i]];
+        node.order_id = order.order_id;
+        node.client_order_id = order.client_order_id;
+        node.owner = order.owner;
+        node.book = &book_for(order.instrument);
+        node.price = order.price;
+        node.remaining = order.remaining;
+        node.side = order.side;
+        node.book->restore(indices[i]);
+        pool_.link_owner(indices[i]);
+        ++restored;
+    }
+    return restored;
+}
+
+OrderBook& MatchingEngine::book_for(InstrumentId instrument) {
+    if (instrument >= books_.size()) {
+        books_.resize(instrument + 1);
+    }
+    auto& book = books_[instrument];
+    if (!book) {
+        book = std::make_unique<OrderBook>(pool_, config_.base_price, config_.price_levels);
+    }
+    return *book;
+}
+
+} // namespace hft
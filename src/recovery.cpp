@@ -0,0 +1,469 @@
+#include "recovery.h"
+#include "logger.h"
+#include "wire_format.h"
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+
+namespace hft {
+
+namespace {
+
+constexpr char SNAPSHOT_MAGIC[8] = {'H', 'F', 'T', 'S', 'N', 'A', 'P', '1'};
+constexpr uint32_t SNAPSHOT_VERSION = 1;
+constexpr size_t SNAPSHOTS_KEPT = 2;
+
+#pragma pack(push, 1)
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t sequence;              // Last journal record included
+    uint64_t segment;               // Segment holding that record
+    uint64_t last_fill_id;
+    uint64_t order_count;
+    uint64_t market_data_count;
+    uint64_t request_session;       // Order request whose ack is not included yet
+    uint16_t request_length;        // 0 if none
+    uint8_t request[wire::MAX_FRAME_SIZE];
+};
+
+struct SnapshotOrder {
+    uint64_t order_id;
+    uint64_t client_order_id;
+    uint64_t session;
+    uint64_t price;
+    uint64_t priority;
+    uint32_t remaining;
+    uint8_t side;
+    uint8_t reserved[3];
+    std::array<char, 16> symbol;
+};
+
+struct SnapshotFrame {
+    uint16_t length;
+    uint8_t data[wire::MAX_FRAME_SIZE];
+};
+
+#pragma pack(pop)
+
+bool is_order_request(MessageType type) {
+    return type == MessageType::ORDER_NEW || type == MessageType::ORDER_CANCEL ||
+           type == MessageType::ORDER_REPLACE;
+}
+
+/**
+ * @brief Snapshot files in directory as (sequence, path), oldest first
+ */
+std::vector<std::pair<uint64_t, std::string>> list_snapshots(const std::string& directory) {
+    std::vector<std::pair<uint64_t, std::string>> found;
+    if (DIR* dir = opendir(directory.c_str())) {
+        while (dirent* entry = readdir(dir)) {
+            unsigned long long sequence = 0;
+            char suffix[8] = {};
+            if (sscanf(entry->d_name, "snapshot-%llu.%7s", &sequence, suffix) == 2 &&
+                std::strcmp(suffix, "snap") == 0) {
+                found.emplace_back(sequence, directory + "/" + entry->d_name);
+            }
+        }
+        closedir(dir);
+    }
+    std::sort(found.begin(), found.end());
+    return found;
+}
+
+} // namespace
+
+// JournalState implementation
+JournalState::JournalState(size_t shards) : shards_(std::max<size_t>(1, shards)) {}
+
+size_t JournalState::shard_of(const Symbol& symbol) const {
+    size_t length = strnlen(symbol.data(), symbol.size());
+    return std::hash<std::string_view>()(std::string_view(symbol.data(), length)) % shards_.size();
+}
+
+bool JournalState::recover(const std::string& directory) {
+    std::string snapshot = latest_snapshot(directory);
+    if (!snapshot.empty() && !load_snapshot(snapshot)) {
+        std::cerr << "Cannot read snapshot " << snapshot << std::endl;
+        return false;
+    }
+    return replay(JournalReader::segments(directory));
+}
+
+bool JournalState::replay(const std::vector<std::string>& segments) {
+    // Map the segments holding records after sequence_; the rest are skipped unread
+    std::vector<JournalReader> readers;
+    for (const std::string& path : segments) {
+        JournalReader reader;
+        if (!reader.open(path)) {
+            std::cerr << "Cannot read journal segment " << path << std::endl;
+            return false;
+        }
+        if (reader.header().first_sequence <= sequence_ + 1) {
+            readers.clear(); // Everything before this segment is already applied
+        }
+        readers.push_back(std::move(reader));
+    }
+    if (readers.empty()) {
+        return true;
+    }
+
+    uint64_t after = sequence_;
+    uint64_t last = sequence_;
+    uint64_t count = 0;
+    auto replay_shard = [&](size_t index) {
+        Shard& shard = shards_[index];
+        for (const JournalReader& reader : readers) {
+            reader.for_each([&](const JournalRecordHeader& record, const uint8_t* frame) {
+                if (record.sequence <= after) {
+                    return;
+                }
+                apply(shard, index, record, frame);
+                if (index == 0) {
+                    last = record.sequence;
+                    ++count;
+                }
+            });
+        }
+    };
+
+    // One thread per shard; all of them read the same mappings
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < shards_.size(); ++i) {
+        threads.emplace_back(replay_shard, i);
+    }
+    replay_shard(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    sequence_ = last;
+    replayed_ += count;
+    segment_ = readers.back().header().index;
+    return true;
+}
+
+void JournalState::apply(Shard& shard, size_t index, const JournalRecordHeader& record, const uint8_t* frame) {
+    size_t length = record.length - sizeof(JournalRecordHeader);
+    switch (record.entry) {
+        case JournalEntry::INBOUND: {
+            if (length < wire::HEADER_SIZE) {
+                break;
+            }
+            MessageType type = wire::peek_type(frame);
+            if (is_order_request(type)) {
+                shard.pending = wire::decode(frame, length, shard.request);
+                shard.request_session = record.session;
+            } else if (type == MessageType::MARKET_DATA) {
+                MarketDataMessage data;
+                if (wire::decode(frame, length, data) && shard_of(data.symbol) == index) {
+                    shard.market_data[data.symbol] = data;
+                }
+            }
+            break;
+        }
+        case JournalEntry::OUTBOUND: {
+            if (length < wire::HEADER_SIZE) {
+                break;
+            }
+            if (wire::peek_type(frame) == MessageType::ORDER_FILL) {
+                FillMessage fill;
+                if (!wire::decode(frame, length, fill)) {
+                    break;
+                }
+                shard.last_fill_id = std::max(shard.last_fill_id, fill.fill_id);
+
+                // Only resting orders are tracked; the taker's outcome comes with its ack
+                auto it = shard.orders.find(fill.order_id);
+                if (it != shard.orders.end()) {
+                    it->second.remaining -= std::min(it->second.remaining, fill.fill_quantity);
+                    if (it->second.remaining == 0) {
+                        shard.orders.erase(it);
+                    }
+                }
+            } else if (shard.pending) {
+                OrderMessage ack;
+                if (wire::decode(frame, length, ack)) {
+                    apply_ack(shard, index, record, ack);
+                }
+                shard.pending = false;
+            }
+            break;
+        }
+        case JournalEntry::DISCONNECT: {
+            // Cancel on disconnect
+            for (auto it = shard.orders.begin(); it != shard.orders.end(); ) {
+                it = it->second.session == record.session ? shard.orders.erase(it) : std::next(it);
+            }
+            break;
+        }
+    }
+}
+
+void JournalState::apply_ack(Shard& shard, size_t index, const JournalRecordHeader& record, const OrderMessage& ack) {
+    const OrderMessage& request = shard.request;
+    if (ack.message_type != request.message_type) {
+        return; // ORDER_REJECT: nothing changed
+    }
+
+    switch (request.message_type) {
+        case MessageType::ORDER_NEW:
+            if (ack.status == MessageStatus::PROCESSED && shard_of(request.symbol) == index) {
+                RecoveredOrder order{};
+                order.order_id = ack.order_id;
+                order.client_order_id = request.client_order_id;
+                order.session = shard.request_session;
+                order.price = request.price;
+                order.priority = record.sequence;
+                order.remaining = ack.quantity;
+                order.side = request.side;
+                order.symbol = request.symbol;
+                shard.orders[order.order_id] = order;
+            }
+            break;
+        case MessageType::ORDER_CANCEL:
+            if (ack.status == MessageStatus::COMPLETED) {
+                shard.orders.erase(request.order_id);
+            }
+            break;
+        case MessageType::ORDER_REPLACE: {
+            auto it = shard.orders.find(request.order_id);
+            if (it == shard.orders.end()) {
+                break;
+            }
+            RecoveredOrder order = it->second;
+            shard.orders.erase(it);
+            if (ack.status != MessageStatus::PROCESSED) {
+                break; // Cancelled by a zero quantity, or filled at the new price
+            }
+
+            // A smaller size at the same price keeps the id and queue position
+            if (ack.order_id != request.order_id) {
+                order.priority = record.sequence;
+            }
+            order.order_id = ack.order_id;
+            order.price = request.price;
+            order.remaining = ack.quantity;
+            shard.orders[order.order_id] = order;
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+std::vector<RecoveredOrder> JournalState::orders() const {
+    std::vector<RecoveredOrder> orders;
+    for (const Shard& shard : shards_) {
+        for (const auto& [order_id, order] : shard.orders) {
+            orders.push_back(order);
+        }
+    }
+    std::sort(orders.begin(), orders.end(), [](const RecoveredOrder& a, const RecoveredOrder& b) {
+        return a.priority < b.priority;
+    });
+    return orders;
+}
+
+std::vector<MarketDataMessage> JournalState::market_data() const {
+    std::vector<MarketDataMessage> latest;
+    for (const Shard& shard : shards_) {
+        for (const auto& [symbol, data] : shard.market_data) {
+            latest.push_back(data);
+        }
+    }
+    return latest;
+}
+
+uint64_t JournalState::last_fill_id() const {
+    uint64_t last = 0;
+    for (const Shard& shard : shards_) {
+        last = std::max(last, shard.last_fill_id);
+    }
+    return last;
+}
+
+std::string JournalState::latest_snapshot(const std::string& directory) {
+    auto snapshots = list_snapshots(directory);
+    return snapshots.empty() ? std::string() : snapshots.back().second;
+}
+
+bool JournalState::load_snapshot(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+
+    SnapshotHeader header;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+                 std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0 &&
+                 header.version == SNAPSHOT_VERSION && header.request_length <= wire::MAX_FRAME_SIZE;
+    for (Shard& shard : shards_) {
+        shard = Shard();
+    }
+
+    // Shards are re-split by symbol, so the shard count may differ from the writer's
+    for (uint64_t i = 0; valid && i < header.order_count; ++i) {
+        SnapshotOrder saved;
+        valid = fread(&saved, sizeof(saved), 1, file) == 1;
+        if (valid) {
+            RecoveredOrder order{saved.order_id, saved.client_order_id, saved.session, saved.price,
+                                 saved.priority, saved.remaining, static_cast<OrderSide>(saved.side),
+                                 saved.symbol};
+            shards_[shard_of(order.symbol)].orders[order.order_id] = order;
+        }
+    }
+    for (uint64_t i = 0; valid && i < header.market_data_count; ++i) {
+        SnapshotFrame frame;
+        MarketDataMessage data;
+        valid = fread(&frame, sizeof(frame), 1, file) == 1 && wire::decode(frame.data, frame.length, data);
+        if (valid) {
+            shards_[shard_of(data.symbol)].market_data[data.symbol] = data;
+        }
+    }
+    fclose(file);
+    if (!valid) {
+        return false;
+    }
+
+    for (Shard& shard : shards_) {
+        shard.last_fill_id = header.last_fill_id;
+        shard.pending = header.request_length > 0 &&
+                        wire::decode(header.request, header.request_length, shard.request);
+        shard.request_session = header.request_session;
+    }
+    sequence_ = header.sequence;
+    segment_ = header.segment;
+    replayed_ = 0;
+    return true;
+}
+
+bool JournalState::save_snapshot(const std::string& directory) const {
+    char name[48];
+    snprintf(name, sizeof(name), "snapshot-%020llu.snap", static_cast<unsigned long long>(sequence_));
+    std::string path = directory + "/" + name;
+    std::string temporary = path + ".tmp";
+
+    FILE* file = fopen(temporary.c_str(), "wb");
+    if (!file) {
+        HFT_LOG_ERROR("Cannot create snapshot {}: {}", sequence_, LogErrno{errno});
+        return false;
+    }
+
+    std::vector<RecoveredOrder> resting = orders();
+    std::vector<MarketDataMessage> latest = market_data();
+
+    SnapshotHeader header{};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.sequence = sequence_;
+    header.segment = segment_;
+    header.last_fill_id = last_fill_id();
+    header.order_count = resting.size();
+    header.market_data_count = latest.size();
+    const Shard& first = shards_.front();
+    if (first.pending) {
+        header.request_session = first.request_session;
+        header.request_length = static_cast<uint16_t>(wire::encode(first.request, header.request));
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (const RecoveredOrder& order : resting) {
+        SnapshotOrder saved{};
+        saved.order_id = order.order_id;
+        saved.client_order_id = order.client_order_id;
+        saved.session = order.session;
+        saved.price = order.price;
+        saved.priority = order.priority;
+        saved.remaining = order.remaining;
+        saved.side = static_cast<uint8_t>(order.side);
+        saved.symbol = order.symbol;
+        written = written && fwrite(&saved, sizeof(saved), 1, file) == 1;
+    }
+    for (const MarketDataMessage& data : latest) {
+        SnapshotFrame frame{};
+        frame.length = static_cast<uint16_t>(wire::encode(data, frame.data));
+        written = written && fwrite(&frame, sizeof(frame), 1, file) == 1;
+    }
+
+    // Durable before it replaces the previous snapshot
+    written = fflush(file) == 0 && written && fsync(fileno(file)) == 0;
+    fclose(file);
+    if (!written || rename(temporary.c_str(), path.c_str()) < 0) {
+        HFT_LOG_ERROR("Cannot write snapshot {}: {}", sequence_, LogErrno{errno});
+        unlink(temporary.c_str());
+        return false;
+    }
+
+    auto snapshots = list_snapshots(directory);
+    for (size_t i = 0; i + SNAPSHOTS_KEPT < snapshots.size(); ++i) {
+        unlink(snapshots[i].second.c_str());
+    }
+    return true;
+}
+
+// Checkpointer implementation
+void Checkpointer::start(const std::string& directory, JournalState state) {
+    stop();
+    directory_ = directory;
+    state_ = std::move(state);
+    running_.store(true, std::memory_order_release);
+    thread_ = std::thread(&Checkpointer::run, this);
+}
+
+void Checkpointer::stop() {
+    running_.store(false, std::memory_order_release);
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void Checkpointer::run() {
+    // Spare the next restart the replay just done
+    if (state_.replayed() > 0 && state_.save_snapshot(directory_)) {
+        snapshots_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    while (running_.load(std::memory_order_acquire)) {
+        checkpoint();
+        for (int i = 0; i < 10 && running_.load(std::memory_order_acquire); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+}
+
+void Checkpointer::checkpoint() {
+    // The newest segment is still being written
+    std::vector<std::string> segments = JournalReader::segments(directory_);
+    if (segments.size() < 2) {
+        return;
+    }
+    segments.pop_back();
+
+    JournalReader last;
+    if (!last.open(segments.back()) || last.header().index <= state_.segment()) {
+        return;
+    }
+    last.close();
+
+    auto start = std::chrono::steady_clock::now();
+    if (!state_.replay(segments) || !state_.save_snapshot(directory_)) {
+        return;
+    }
+    snapshots_.fetch_add(1, std::memory_order_relaxed);
+    HFT_LOG_INFO("Journal snapshot at sequence {}, {} orders, in {} ms", state_.sequence(),
+                 state_.orders().size(), std::chrono::duration_cast<std::chrono::milliseconds>(
+                     std::chrono::steady_clock::now() - start).count());
+}
+
+} // namespace hft
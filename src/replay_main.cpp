@@ -0,0 +1,361 @@
+#include "hft_server.h"
+#include "instrument_registry.h"
+#include "journal.h"
+#include "latency_histogram.h"
+#include "logger.h"
+#include "wire_format.h"
+#include <sys/stat.h>
+#include <array>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <iomanip>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace hft {
+
+namespace {
+
+/**
+ * @brief Feeds journaled client traffic straight into the services
+ *
+ * Each journal session gets a stand-in Connection that is already closed,
+ * so acks, fills and market data are built and encoded exactly as live but
+ * dropped before any socket. Records are applied on one thread in journal
+ * order, which is the order the engine applied them, so a replay is
+ * deterministic.
+ */
+class JournalReplay {
+public:
+    JournalReplay(OrderService& orders, MarketDataService& market_data)
+        : orders_(orders), market_data_(market_data) {}
+
+    /**
+     * @brief Apply one record; only INBOUND records and disconnects reach the services
+     */
+    void apply(const JournalRecordHeader& record, const uint8_t* frame) {
+        switch (record.entry) {
+            case JournalEntry::INBOUND:
+                dispatch(record, frame);
+                break;
+            case JournalEntry::OUTBOUND:
+                ++outbound_;
+                break;
+            case JournalEntry::DISCONNECT:
+                disconnect(record.session);
+                break;
+        }
+    }
+
+    /**
+     * @brief Close every session still open, as the server does at shutdown
+     */
+    void finish() {
+        while (!sessions_.empty()) {
+            disconnect(sessions_.begin()->first);
+        }
+    }
+
+    const LatencyHistogram& histogram(size_t type) const { return histograms_[type]; }
+    uint64_t inbound() const { return inbound_; }
+    uint64_t outbound() const { return outbound_; }
+    uint64_t disconnects() const { return disconnects_; }
+    uint64_t sessions() const { return session_count_; }
+    uint64_t undecodable() const { return undecodable_; }
+
+private:
+    void dispatch(const JournalRecordHeader& record, const uint8_t* frame) {
+        size_t length = record.length - sizeof(JournalRecordHeader);
+        if (length < wire::HEADER_SIZE) {
+            ++undecodable_;
+            return;
+        }
+        switch (wire::peek_type(frame)) {
+            case MessageType::ORDER_NEW:
+            case MessageType::ORDER_CANCEL:
+            case MessageType::ORDER_REPLACE: {
+                OrderMessage order;
+                if (wire::decode(frame, length, order)) {
+                    InstrumentRegistry::get_instance().resolve(order);
+                    process(orders_, order, session(record.session));
+                    return;
+                }
+                break;
+            }
+            case MessageType::MARKET_DATA: {
+                MarketDataMessage data;
+                if (wire::decode(frame, length, data)) {
+                    InstrumentRegistry::get_instance().resolve(data);
+                    process(market_data_, data, session(record.session));
+                    return;
+                }
+                break;
+            }
+            default:
+                break;
+        }
+        ++undecodable_;
+    }
+
+    void process(IMessageService& service, const Message& msg, Connection& conn) {
+        uint64_t start_ns = Clock::monotonic_ns();
+        service.process_message(msg, conn);
+        histograms_[HFTServer::stats_type(msg.message_type)].record(Clock::monotonic_ns() - start_ns);
+        ++inbound_;
+    }
+
+    Connection& session(uint64_t id) {
+        auto it = sessions_.find(id);
+        if (it != sessions_.end()) {
+            return *it->second;
+        }
+        auto conn = std::make_shared<Connection>();
+        conn->client_id = id;
+        conn->closed = true; // No socket: every frame sent to it is dropped
+        orders_.on_connection_established(*conn);
+        market_data_.on_connection_established(*conn);
+        ++session_count_;
+        return *sessions_.emplace(id, std::move(conn)).first->second;
+    }
+
+    void disconnect(uint64_t id) {
+        ++disconnects_;
+        auto it = sessions_.find(id);
+        if (it == sessions_.end()) {
+            return; // Never sent anything in the replayed range
+        }
+        orders_.on_connection_closed(*it->second);
+        market_data_.on_connection_closed(*it->second);
+        sessions_.erase(it);
+    }
+
+    OrderService& orders_;
+    MarketDataService& market_data_;
+    std::unordered_map<uint64_t, std::shared_ptr<Connection>> sessions_;
+    std::array<LatencyHistogram, HFTServer::STATS_TYPE_COUNT> histograms_;
+    uint64_t inbound_{0};
+    uint64_t outbound_{0};
+    uint64_t disconnects_{0};
+    uint64_t session_count_{0};
+    uint64_t undecodable_{0};
+};
+
+HFTServer::LatencySummary summarize(const HistogramSnapshot& snapshot) {
+    HFTServer::LatencySummary summary{};
+    summary.count = snapshot.count();
+    summary.mean_us = snapshot.mean() / 1000.0;
+    summary.p50_us = snapshot.value_at_percentile(50.0) / 1000.0;
+    summary.p99_us = snapshot.value_at_percentile(99.0) / 1000.0;
+    summary.p999_us = snapshot.value_at_percentile(99.9) / 1000.0;
+    summary.p9999_us = snapshot.value_at_percentile(99.99) / 1000.0;
+    summary.max_us = snapshot.max() / 1000.0;
+    return summary;
+}
+
+/**
+ * @brief Wait until deadline, sleeping while it is far and spinning once it is near
+ */
+void wait_until(std::chrono::steady_clock::time_point deadline) {
+    const auto spin_window = std::chrono::microseconds(200);
+    for (;;) {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+            return;
+        }
+        if (deadline - now > spin_window) {
+            std::this_thread::sleep_for(deadline - now - spin_window);
+        }
+    }
+}
+
+} // namespace
+
+} // namespace hft
+
+int main(int argc, char* argv[]) {
+    using namespace hft;
+
+    // Replay configuration
+    std::string input;
+    std::string instrument_file;
+    bool recorded_timing = false;
+    double speed = 1.0;
+    LogLevel log_level = LogLevel::WARN;
+
+    // Parse command line arguments
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--journal" && i + 1 < argc) {
+            input = argv[++i];
+        } else if (arg == "--timing" && i + 1 < argc) {
+            std::string timing = argv[++i];
+            if (timing == "recorded") {
+                recorded_timing = true;
+            } else if (timing != "fast") {
+                std::cerr << "Unknown timing: " << timing << std::endl;
+                return 1;
+            }
+        } else if (arg == "--speed" && i + 1 < argc) {
+            speed = std::stod(argv[++i]);
+            if (speed <= 0.0) {
+                std::cerr << "Speed must be positive" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--instruments" && i + 1 < argc) {
+            instrument_file = argv[++i];
+        } else if (arg == "--max-symbols" && i + 1 < argc) {
+            InstrumentRegistry::get_instance().set_intern_limit(std::stoul(argv[++i]));
+        } else if (arg == "--log-level" && i + 1 < argc) {
+            if (!Logger::parse_level(argv[++i], log_level)) {
+                std::cerr << "Unknown log level: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--help") {
+            std::cout << "HFT Journal Replay\n"
+                      << "Usage: " << argv[0] << " --journal <path> [options]\n\n"
+                      << "Replays the client orders and market data recorded in a journal\n"
+                      << "through the order and market data services, without sockets.\n\n"
+                      << "Options:\n"
+                      << "  --journal <path>       Journal directory, or a single segment file\n"
+                      << "  --timing <t>           fast|recorded (default: fast)\n"
+                      << "  --speed <x>            Multiplier for recorded timing (default: 1)\n"
+                      << "  --instruments <file>   Fixed instrument table the server used\n"
+                      << "  --max-symbols <n>      Symbols taken on first use without it (default: 1024)\n"
+                      << "  --log-level <l>        trace|debug|info|warn|error|off (default: warn)\n"
+                      << "  --help                 Show this help message\n\n"
+                      << "Examples:\n"
+                      << "  " << argv[0] << " --journal journal\n"
+                      << "  " << argv[0] << " --journal journal --timing recorded --speed 10\n";
+            return 0;
+        } else {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            return 1;
+        }
+    }
+    if (input.empty()) {
+        std::cerr << "No journal given; see --help" << std::endl;
+        return 1;
+    }
+
+    Logger::get_instance().set_level(log_level);
+    if (!instrument_file.empty() && !InstrumentRegistry::get_instance().load(instrument_file)) {
+        return 1;
+    }
+
+    struct stat st;
+    std::vector<std::string> segments;
+    if (stat(input.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+        segments = JournalReader::segments(input);
+    } else {
+        segments.push_back(input);
+    }
+    if (segments.empty()) {
+        std::cerr << "No journal segments in " << input << std::endl;
+        return 1;
+    }
+
+    // Map everything up front so the replay loop never touches the file system
+    std::vector<JournalReader> readers(segments.size());
+    for (size_t i = 0; i < segments.size(); ++i) {
+        if (!readers[i].open(segments[i])) {
+            std::cerr << "Cannot read journal segment " << segments[i] << std::endl;
+            return 1;
+        }
+    }
+
+    auto order_service = std::make_shared<OrderService>();
+    auto market_data_service = std::make_shared<MarketDataService>();
+    auto replay = std::make_unique<JournalReplay>(*order_service, *market_data_service);
+
+    std::cout << "=== HFT Journal Replay ===" << std::endl;
+    std::cout << "Journal: " << input << ", " << segments.size() << " segments" << std::endl;
+    std::cout << "Timing: " << (recorded_timing ? "recorded" : "as fast as possible");
+    if (recorded_timing) {
+        std::cout << " x" << speed;
+    }
+    std::cout << std::endl;
+    std::cout << "==========================" << std::endl;
+
+    uint64_t records = 0;
+    uint64_t first_sequence = 0;
+    uint64_t next_sequence = 0;
+    uint64_t gaps = 0;
+    uint64_t first_timestamp = 0;
+    auto start_time = std::chrono::steady_clock::now();
+
+    for (const JournalReader& reader : readers) {
+        reader.for_each([&](const JournalRecordHeader& record, const uint8_t* frame) {
+            if (records++ == 0) {
+                first_sequence = record.sequence;
+                first_timestamp = record.timestamp;
+            } else if (record.sequence != next_sequence) {
+                ++gaps;
+            }
+            next_sequence = record.sequence + 1;
+
+            if (recorded_timing && record.entry == JournalEntry::INBOUND && record.timestamp > first_timestamp) {
+                auto offset = std::chrono::nanoseconds(
+                    static_cast<int64_t>((record.timestamp - first_timestamp) / speed));
+                wait_until(start_time + offset);
+            }
+            replay->apply(record, frame);
+        });
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - start_time;
+    replay->finish();
+
+    double elapsed_s = std::chrono::duration<double>(elapsed).count();
+    HistogramSnapshot all;
+    for (size_t type = 0; type < HFTServer::STATS_TYPE_COUNT; ++type) {
+        all.merge(replay->histogram(type));
+    }
+    double engine_s = all.mean() * all.count() / 1e9;
+
+    std::cout << "\n=== Replay Results ===" << std::endl;
+    std::cout << "Records: " << records;
+    if (records) {
+        std::cout << " (sequence " << first_sequence << " to " << next_sequence - 1 << ")";
+    }
+    std::cout << std::endl;
+    std::cout << "Replayed: " << replay->inbound() << " messages from " << replay->sessions()
+              << " sessions, " << replay->disconnects() << " disconnects" << std::endl;
+    std::cout << "Skipped: " << replay->outbound() << " outbound, " << replay->undecodable()
+              << " undecodable, " << gaps << " sequence gaps" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Elapsed: " << elapsed_s * 1000.0 << " ms";
+    if (elapsed_s > 0.0) {
+        std::cout << ", " << replay->inbound() / elapsed_s << " msg/s";
+    }
+    std::cout << std::endl;
+    std::cout << "In services: " << engine_s * 1000.0 << " ms";
+    if (engine_s > 0.0) {
+        std::cout << ", " << replay->inbound() / engine_s << " msg/s";
+    }
+    std::cout << std::endl;
+
+    std::cout << std::left << std::setw(14) << "Latency (μs)" << std::right
+              << std::setw(10) << "count" << std::setw(9) << "p50"
+              << std::setw(9) << "p99" << std::setw(9) << "p99.9"
+              << std::setw(9) << "p99.99" << std::setw(9) << "max" << std::endl;
+    auto print_latency = [](const char* name, const HFTServer::LatencySummary& latency) {
+        std::cout << std::left << std::setw(13) << name << std::right
+                  << std::setw(10) << latency.count << std::setw(9) << latency.p50_us
+                  << std::setw(9) << latency.p99_us << std::setw(9) << latency.p999_us
+                  << std::setw(9) << latency.p9999_us << std::setw(9) << latency.max_us
+                  << std::endl;
+    };
+    print_latency("ALL", summarize(all));
+    for (size_t type = 0; type < HFTServer::STATS_TYPE_COUNT; ++type) {
+        HistogramSnapshot snapshot;
+        snapshot.merge(replay->histogram(type));
+        if (snapshot.count() > 0) {
+            print_latency(HFTServer::stats_type_name(type), summarize(snapshot));
+        }
+    }
+
+    return 0;
+}
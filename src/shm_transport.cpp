@@ -0,0 +1,312 @@
+#include "shm_transport.h"
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <new>
+
+namespace hft {
+
+namespace {
+
+constexpr char SEGMENT_MAGIC[8] = {'H', 'F', 'T', 'S', 'H', 'M', '0', '1'};
+constexpr uint32_t SEGMENT_VERSION = 1;
+
+size_t align_up(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+size_t header_bytes() {
+    return align_up(sizeof(ShmSegmentHeader), 4096);
+}
+
+} // namespace
+
+// ShmEvent implementation
+void ShmEvent::sleep(uint32_t seen, uint32_t timeout_us) {
+    timespec timeout{};
+    timeout.tv_sec = timeout_us / 1000000;
+    timeout.tv_nsec = static_cast<long>(timeout_us % 1000000) * 1000;
+    // Shared, not private: the other side is another process
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&sequence), FUTEX_WAIT, seen, &timeout, nullptr, 0);
+}
+
+void ShmEvent::wake() {
+    // A client's receive and send threads may both wait on its event
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&sequence), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+// ShmRing implementation
+size_t ShmRing::write(const iovec* iov, int count) {
+    uint64_t tail = control_->tail.load(std::memory_order_relaxed);
+    size_t written = 0;
+    for (int i = 0; i < count; ++i) {
+        const auto* bytes = static_cast<const uint8_t*>(iov[i].iov_base);
+        size_t length = iov[i].iov_len;
+        size_t done = 0;
+        while (done < length) {
+            size_t space = capacity_ - static_cast<size_t>(tail - cached_head_);
+            if (space == 0) {
+                cached_head_ = control_->head.load(std::memory_order_acquire);
+                space = capacity_ - static_cast<size_t>(tail - cached_head_);
+                if (space == 0) {
+                    // Ask the reader for a wake-up, then look once more in case it just drained
+                    control_->writer_blocked.store(1, std::memory_order_relaxed);
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    cached_head_ = control_->head.load(std::memory_order_acquire);
+                    space = capacity_ - static_cast<size_t>(tail - cached_head_);
+                    if (space == 0) {
+                        break;
+                    }
+                }
+            }
+            size_t offset = static_cast<size_t>(tail & (capacity_ - 1));
+            size_t chunk = std::min({length - done, space, capacity_ - offset});
+            std::memcpy(data_ + offset, bytes + done, chunk);
+            tail += chunk;
+            done += chunk;
+        }
+        written += done;
+        if (done < length) {
+            break;
+        }
+    }
+
+    if (written > 0) {
+        control_->tail.store(tail, std::memory_order_release);
+        reader_->notify();
+    }
+    return written;
+}
+
+size_t ShmRing::write(const void* data, size_t length) {
+    iovec iov{const_cast<void*>(data), length};
+    return write(&iov, 1);
+}
+
+size_t ShmRing::read(void* out, size_t length) {
+    uint64_t head = control_->head.load(std::memory_order_relaxed);
+    size_t available = static_cast<size_t>(control_->tail.load(std::memory_order_acquire) - head);
+    size_t total = std::min(available, length);
+    auto* bytes = static_cast<uint8_t*>(out);
+    size_t done = 0;
+    while (done < total) {
+        size_t offset = static_cast<size_t>((head + done) & (capacity_ - 1));
+        size_t chunk = std::min(total - done, capacity_ - offset);
+        std::memcpy(bytes + done, data_ + offset, chunk);
+        done += chunk;
+    }
+
+    if (total > 0) {
+        control_->head.store(head + total, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (control_->writer_blocked.load(std::memory_order_relaxed) &&
+            control_->writer_blocked.exchange(0, std::memory_order_relaxed)) {
+            writer_->notify();
+        }
+    }
+    return total;
+}
+
+// ShmSegment implementation
+std::string ShmSegment::object_name(const std::string& name) {
+    return name.empty() || name[0] != '/' ? "/" + name : name;
+}
+
+bool ShmSegment::process_gone(int32_t pid) {
+    if (pid <= 0) {
+        return false;
+    }
+    if (kill(pid, 0) == -1) {
+        return errno == ESRCH;
+    }
+
+    // A zombie still answers kill() but has let go of the mapping
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+    char stat[256] = {};
+    size_t length = fread(stat, 1, sizeof(stat) - 1, file);
+    fclose(file);
+    const char* end = static_cast<const char*>(memrchr(stat, ')', length));
+    return end && end + 2 < stat + length && (end[2] == 'Z' || end[2] == 'X');
+}
+
+bool ShmSegment::create(const std::string& name, size_t slots, size_t ring_bytes) {
+    close();
+    std::string object = object_name(name);
+    if (slots == 0) {
+        std::cerr << "Shared memory needs at least one session slot" << std::endl;
+        return false;
+    }
+    size_t capacity = 4096;
+    while (capacity < ring_bytes) {
+        capacity <<= 1;
+    }
+
+    // Refuse to take over a segment a running server still serves
+    ShmSegment existing;
+    if (existing.attach(name)) {
+        int32_t owner = existing.header().server_pid.load(std::memory_order_acquire);
+        if (owner != 0 && owner != getpid() && !process_gone(owner)) {
+            std::cerr << "Shared memory " << object << " is in use by process " << owner << std::endl;
+            return false;
+        }
+    }
+    existing.close();
+    shm_unlink(object.c_str());
+
+    int fd = shm_open(object.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        std::cerr << "Cannot create shared memory " << object << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    size_t slot_bytes = align_up(sizeof(ShmSlotHeader), 4096) + 2 * capacity;
+    size_t size = header_bytes() + slots * slot_bytes;
+    if (ftruncate(fd, static_cast<off_t>(size)) < 0) {
+        std::cerr << "Cannot size shared memory " << object << ": " << strerror(errno) << std::endl;
+        ::close(fd);
+        shm_unlink(object.c_str());
+        return false;
+    }
+    void* map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        std::cerr << "Cannot map shared memory " << object << ": " << strerror(errno) << std::endl;
+        shm_unlink(object.c_str());
+        return false;
+    }
+
+    header_ = new (map) ShmSegmentHeader();
+    size_ = size;
+    unlink_name_ = object;
+    header_->version = SEGMENT_VERSION;
+    header_->slot_count = static_cast<uint32_t>(slots);
+    header_->ring_bytes = capacity;
+    header_->slot_bytes = slot_bytes;
+    for (size_t i = 0; i < slots; ++i) {
+        new (&slot(i)) ShmSlotHeader();
+    }
+    header_->server_pid.store(getpid(), std::memory_order_relaxed);
+
+    // Magic last: a client never sees a half-built segment as valid
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(header_->magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC));
+    return true;
+}
+
+bool ShmSegment::attach(const std::string& name) {
+    close();
+    int fd = shm_open(object_name(name).c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < header_bytes()) {
+        ::close(fd);
+        return false;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    void* map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+
+    auto* header = static_cast<ShmSegmentHeader*>(map);
+    if (std::memcmp(header->magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC)) != 0 ||
+        header->version != SEGMENT_VERSION ||
+        header_bytes() + header->slot_count * header->slot_bytes > size) {
+        munmap(map, size);
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    header_ = header;
+    size_ = size;
+    return true;
+}
+
+void ShmSegment::close() {
+    if (!header_) {
+        return;
+    }
+    if (!unlink_name_.empty()) {
+        header_->server_pid.store(0, std::memory_order_release);
+        shm_unlink(unlink_name_.c_str());
+        unlink_name_.clear();
+    }
+    munmap(header_, size_);
+    header_ = nullptr;
+    size_ = 0;
+}
+
+ShmSlotHeader& ShmSegment::slot(size_t index) const {
+    auto* base = reinterpret_cast<uint8_t*>(header_) + header_bytes();
+    return *reinterpret_cast<ShmSlotHeader*>(base + index * header_->slot_bytes);
+}
+
+ShmRing ShmSegment::inbound(size_t index) const {
+    ShmSlotHeader& control = slot(index);
+    auto* data = reinterpret_cast<uint8_t*>(&control) + align_up(sizeof(ShmSlotHeader), 4096);
+    return ShmRing(&control.inbound, data, header_->ring_bytes, &header_->server_event, &control.client_event);
+}
+
+ShmRing ShmSegment::outbound(size_t index) const {
+    ShmSlotHeader& control = slot(index);
+    auto* data = reinterpret_cast<uint8_t*>(&control) + align_up(sizeof(ShmSlotHeader), 4096) +
+                 header_->ring_bytes;
+    return ShmRing(&control.outbound, data, header_->ring_bytes, &control.client_event, &header_->server_event);
+}
+
+int ShmSegment::claim() {
+    for (size_t i = 0; i < slot_count(); ++i) {
+        ShmSlotHeader& control = slot(i);
+        ShmSlotState expected = ShmSlotState::FREE;
+        if (!control.state.compare_exchange_strong(expected, ShmSlotState::CLAIMED, std::memory_order_acquire)) {
+            continue;
+        }
+        // Nobody else touches a CLAIMED slot
+        for (ShmRingControl* ring : {&control.inbound, &control.outbound}) {
+            ring->head.store(0, std::memory_order_relaxed);
+            ring->tail.store(0, std::memory_order_relaxed);
+            ring->writer_blocked.store(0, std::memory_order_relaxed);
+        }
+        control.client_pid.store(getpid(), std::memory_order_relaxed);
+        control.state.store(ShmSlotState::OPENING, std::memory_order_release);
+        header_->server_event.notify();
+        return static_cast<int>(i);
+    }
+    return -1;
+}
+
+void ShmSegment::release(size_t index) {
+    ShmSlotHeader& control = slot(index);
+    ShmSlotState state = control.state.load(std::memory_order_acquire);
+    if (state == ShmSlotState::SERVER_CLOSED) {
+        control.state.store(ShmSlotState::FREE, std::memory_order_release);
+        return;
+    }
+    // Still open, or not yet accepted: the server frees it after closing its side
+    if (control.state.compare_exchange_strong(state, ShmSlotState::CLIENT_CLOSED, std::memory_order_acq_rel)) {
+        header_->server_event.notify();
+    } else if (state == ShmSlotState::SERVER_CLOSED) {
+        control.state.store(ShmSlotState::FREE, std::memory_order_release);
+    }
+}
+
+} // namespace hft
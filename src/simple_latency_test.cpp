@@ -1,4 +1,5 @@
 #include "message.h"
+#include "wire_format.h"
 #include <iostream>
 #include <chrono>
 #include <thread>
@@ -45,7 +46,7 @@ public:
         std::vector<uint64_t> latencies;
         latencies.reserve(num_messages);
         
-        auto start_time = std::chrono::high_resolution_clock::now();
+        uint64_t start_ns = Clock::monotonic_ns();
         
         for (size_t i = 0; i < num_messages; ++i) {
             // Create test message
@@ -58,28 +59,28 @@ public:
             msg.destination_id = 0;
             msg.payload_size = 0;
             
-            auto send_time = std::chrono::high_resolution_clock::now();
+            uint64_t send_ns = Clock::monotonic_ns();
             
             // Send message
-            ssize_t sent = send(socket_fd_, &msg, sizeof(msg), MSG_NOSIGNAL);
-            if (sent != sizeof(msg)) {
+            wire::Frame frame = wire::make_frame(msg);
+            ssize_t sent = send(socket_fd_, frame.data.data(), frame.length, MSG_NOSIGNAL);
+            if (sent != frame.length) {
                 std::cerr << "Send failed" << std::endl;
                 continue;
             }
             
-            // Receive response
-            Message response;
-            ssize_t received = recv(socket_fd_, &response, sizeof(response), 0);
-            if (received != sizeof(response)) {
+            // Receive response (header-only frame of the same length)
+            wire::Frame response;
+            ssize_t received = recv(socket_fd_, response.data.data(), frame.length, MSG_WAITALL);
+            if (received != frame.length) {
                 std::cerr << "Receive failed" << std::endl;
                 continue;
             }
             
-            auto receive_time = std::chrono::high_resolution_clock::now();
+            uint64_t receive_ns = Clock::monotonic_ns();
             
             // Calculate latency
-            uint64_t latency_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
-                receive_time - send_time).count();
+            uint64_t latency_ns = receive_ns - send_ns;
             latencies.push_back(latency_ns);
             
             if (i % 1000 == 0 && i > 0) {
@@ -87,11 +88,10 @@ public:
             }
         }
         
-        auto end_time = std::chrono::high_resolution_clock::now();
-        auto total_duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+        uint64_t total_duration_ns = Clock::monotonic_ns() - start_ns;
         
-        std::cout << "\nAll " << num_messages << " messages processed in " << total_duration.count() << "ms" << std::endl;
-        std::cout << "Processing rate: " << (num_messages * 1000.0 / total_duration.count()) << " msg/sec" << std::endl;
+        std::cout << "\nAll " << num_messages << " messages processed in " << total_duration_ns / 1000000 << "ms" << std::endl;
+        std::cout << "Processing rate: " << (num_messages * 1e9 / total_duration_ns) << " msg/sec" << std::endl;
         
         // Calculate statistics
         calculate_statistics(latencies);
@@ -0,0 +1,262 @@
+#include "uring.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace hft {
+
+namespace {
+
+int sys_io_uring_setup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags,
+                       const void* arg, size_t arg_size) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, arg_size));
+}
+
+int sys_io_uring_register(int fd, unsigned opcode, const void* arg, unsigned nr_args) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+void* map_ring(int fd, size_t size, off_t offset) {
+    void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+    return ptr == MAP_FAILED ? nullptr : ptr;
+}
+
+} // namespace
+
+IoUring::~IoUring() {
+    unmap();
+}
+
+void IoUring::unmap() {
+    if (ring_fd_ != -1) {
+        close(ring_fd_);
+        ring_fd_ = -1;
+    }
+    // Buffers are mmap()ed so a late kernel write after teardown faults instead of corrupting the heap
+    if (buffers_) {
+        munmap(buffers_, buffers_size_);
+        buffers_ = nullptr;
+    }
+    if (buf_ring_) {
+        munmap(buf_ring_, buf_ring_size_);
+        buf_ring_ = nullptr;
+    }
+    if (sqes_) {
+        munmap(sqes_, sqes_size_);
+        sqes_ = nullptr;
+    }
+    if (cq_ptr_ && cq_ptr_ != sq_ptr_) {
+        munmap(cq_ptr_, cq_size_);
+    }
+    cq_ptr_ = nullptr;
+    if (sq_ptr_) {
+        munmap(sq_ptr_, sq_size_);
+        sq_ptr_ = nullptr;
+    }
+}
+
+bool IoUring::init(unsigned entries) {
+    io_uring_params params{};
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+    params.cq_entries = entries * 4;    // Multishot requests post many completions each
+    ring_fd_ = sys_io_uring_setup(entries, &params);
+    if (ring_fd_ < 0 && errno == EINVAL) {
+        // Older kernels: plain ring, completions run as task work on any entry
+        params = io_uring_params{};
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = entries * 4;
+        ring_fd_ = sys_io_uring_setup(entries, &params);
+    }
+    if (ring_fd_ < 0) {
+        ring_fd_ = -1;
+        return false;
+    }
+    features_ = params.features;
+
+    sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (features_ & IORING_FEAT_SINGLE_MMAP) {
+        sq_size_ = cq_size_ = sq_size_ > cq_size_ ? sq_size_ : cq_size_;
+    }
+
+    sq_ptr_ = map_ring(ring_fd_, sq_size_, IORING_OFF_SQ_RING);
+    if (!sq_ptr_) {
+        unmap();
+        return false;
+    }
+    cq_ptr_ = (features_ & IORING_FEAT_SINGLE_MMAP) ? sq_ptr_ : map_ring(ring_fd_, cq_size_, IORING_OFF_CQ_RING);
+    if (!cq_ptr_) {
+        unmap();
+        return false;
+    }
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe*>(map_ring(ring_fd_, sqes_size_, IORING_OFF_SQES));
+    if (!sqes_) {
+        unmap();
+        return false;
+    }
+
+    auto* sq = static_cast<uint8_t*>(sq_ptr_);
+    sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_entries_ = params.sq_entries;
+
+    // Identity-map the index array once; entries are always submitted in order
+    auto* array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    for (unsigned i = 0; i < sq_entries_; ++i) {
+        array[i] = i;
+    }
+    sqe_head_ = sqe_tail_ = *sq_tail_;
+
+    auto* cq = static_cast<uint8_t*>(cq_ptr_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    if (!(features_ & IORING_FEAT_EXT_ARG)) {
+        // Needed for the bounded wait in submit_and_wait()
+        unmap();
+        errno = ENOSYS;
+        return false;
+    }
+    return true;
+}
+
+bool IoUring::supported() {
+    IoUring probe;
+    if (!probe.init(4)) {
+        return false;
+    }
+    // Provided buffer rings (5.19) imply multishot accept and recv support
+    return probe.setup_buffer_ring(0, 1, 64);
+}
+
+io_uring_sqe* IoUring::get_sqe() {
+    unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    if (sqe_tail_ - head >= sq_entries_) {
+        return nullptr;
+    }
+    io_uring_sqe* sqe = &sqes_[sqe_tail_ & sq_mask_];
+    std::memset(sqe, 0, sizeof(*sqe));
+    ++sqe_tail_;
+    return sqe;
+}
+
+int IoUring::submit_and_wait(unsigned wait_nr, unsigned timeout_us) {
+    unsigned to_submit = sqe_tail_ - sqe_head_;
+    __atomic_store_n(sq_tail_, sqe_tail_, __ATOMIC_RELEASE);
+    sqe_head_ = sqe_tail_;
+
+    __kernel_timespec timeout{};
+    timeout.tv_sec = timeout_us / 1000000;
+    timeout.tv_nsec = static_cast<long long>(timeout_us % 1000000) * 1000;
+
+    io_uring_getevents_arg arg{};
+    arg.sigmask_sz = _NSIG / 8;
+    arg.ts = reinterpret_cast<uint64_t>(&timeout);
+
+    // GETEVENTS is always set so deferred task work (completions) runs here
+    unsigned flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+    int ret = sys_io_uring_enter(ring_fd_, to_submit, wait_nr, flags, &arg, sizeof(arg));
+    if (ret < 0) {
+        return (errno == ETIME || errno == EINTR) ? static_cast<int>(to_submit) : -errno;
+    }
+    return ret;
+}
+
+bool IoUring::setup_buffer_ring(uint16_t group, uint16_t count, uint32_t size) {
+    buf_ring_size_ = count * sizeof(io_uring_buf);
+    void* ring = mmap(nullptr, buf_ring_size_, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (ring == MAP_FAILED) {
+        return false;
+    }
+    buf_ring_ = static_cast<io_uring_buf_ring*>(ring);
+
+    buffers_size_ = static_cast<size_t>(count) * size;
+    void* buffers = mmap(nullptr, buffers_size_, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (buffers == MAP_FAILED) {
+        return false;
+    }
+    buffers_ = static_cast<uint8_t*>(buffers);
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring_);
+    reg.ring_entries = count;
+    reg.bgid = group;
+    if (sys_io_uring_register(ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        return false;
+    }
+
+    buffer_group_ = group;
+    buffer_count_ = count;
+    buffer_size_ = size;
+    buf_tail_ = 0;
+    for (uint16_t id = 0; id < count; ++id) {
+        recycle_buffer(id);
+    }
+    return true;
+}
+
+void IoUring::recycle_buffer(uint16_t id) {
+    // Index the ring directly: in C++ the header's empty struct shifts bufs[] by 8 bytes
+    io_uring_buf& buf = reinterpret_cast<io_uring_buf*>(buf_ring_)[buf_tail_ & (buffer_count_ - 1)];
+    buf.addr = reinterpret_cast<uint64_t>(buffer(id));
+    buf.len = buffer_size_;
+    buf.bid = id;
+    ++buf_tail_;
+    __atomic_store_n(&buf_ring_->tail, buf_tail_, __ATOMIC_RELEASE);
+}
+
+void IoUring::prep_multishot_accept(io_uring_sqe* sqe, int fd, uint64_t user_data) {
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = user_data;
+}
+
+void IoUring::prep_multishot_recv(io_uring_sqe* sqe, int fd, uint16_t group, uint64_t user_data) {
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = group;
+    sqe->user_data = user_data;
+}
+
+void IoUring::prep_sendmsg(io_uring_sqe* sqe, int fd, const msghdr* msg, unsigned flags, uint64_t user_data) {
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(msg);
+    sqe->len = 1;
+    sqe->msg_flags = flags;
+    sqe->user_data = user_data;
+}
+
+void IoUring::prep_poll(io_uring_sqe* sqe, int fd, uint32_t events, uint64_t user_data) {
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events;
+    sqe->user_data = user_data;
+}
+
+void IoUring::prep_cancel(io_uring_sqe* sqe, uint64_t target, uint64_t user_data) {
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = target;
+    sqe->user_data = user_data;
+}
+
+} // namespace hft